@@ -0,0 +1,267 @@
+# numpy bindings of the uwie shared library (capi/uwie.h). frames are height x width x 4 uint8 arrays, rows may be
+# padded (slices of a larger array) as long as the pixels of a row are contiguous, those are passed to the library
+# without a copy. the library is called through ctypes, which releases the gil for the duration of every call, so
+# enhancers on different threads run in parallel. an enhancer may be used by one thread at a time
+#
+#   import numpy as np, uwie
+#   enhancer = uwie.Enhancer(fixed_point=True)
+#   enhanced = enhancer.process(frame)
+#   enhancer.lab_contrast(frame, out=enhanced)
+#
+# the library is loaded from UWIE_LIBRARY, from the directory of this module or from the system search path
+
+import ctypes
+import ctypes.util
+import os
+import sys
+import threading
+
+import numpy as np
+
+__all__ = ["Enhancer", "UwieError", "process", "redefine", "attenuation_map", "detail_map", "lab_contrast"]
+
+_OK = 0
+_OUT_OF_MEMORY = 2
+_CANCELLED = 3
+
+CONTRAST_BLOCK = 0
+CONTRAST_INTERPOLATED = 1
+CONTRAST_SLIDING_WINDOW = 2
+
+
+class _parameters(ctypes.Structure):
+    _fields_ = [
+        ("block_size", ctypes.c_uint32),
+        ("sharp", ctypes.c_float),
+        ("enhance", ctypes.c_float),
+        ("k", ctypes.c_float),
+        ("v", ctypes.c_float),
+        ("guided_radius", ctypes.c_uint32),
+        ("gamma", ctypes.c_float),
+        ("contrast_mode", ctypes.c_int),
+        ("half_storage", ctypes.c_int),
+        ("fixed_point", ctypes.c_int),
+    ]
+
+
+_progress_callback = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_float, ctypes.c_void_p)
+_stages = ("uwie_process", "uwie_redefine", "uwie_attenuation_map", "uwie_detail_map", "uwie_lab_contrast")
+
+
+def _library_candidates():
+    if "UWIE_LIBRARY" in os.environ:
+        yield os.environ["UWIE_LIBRARY"]
+
+    names = {"win32": "uwie.dll", "darwin": "libuwie.dylib"}
+    yield os.path.join(os.path.dirname(os.path.abspath(__file__)), names.get(sys.platform, "libuwie.so"))
+
+    found = ctypes.util.find_library("uwie")
+    if found:
+        yield found
+
+
+def _load_library():
+    errors = []
+    for path in _library_candidates():
+        try:
+            library = ctypes.CDLL(path)
+            break
+        except OSError as e:
+            errors.append(str(e))
+    else:
+        raise ImportError("uwie library not found: " + "; ".join(errors))
+
+    library.uwie_version.restype = ctypes.c_int
+    library.uwie_version.argtypes = []
+    library.uwie_default_parameters.restype = None
+    library.uwie_default_parameters.argtypes = [ctypes.POINTER(_parameters)]
+    library.uwie_create.restype = ctypes.c_void_p
+    library.uwie_create.argtypes = []
+    library.uwie_destroy.restype = None
+    library.uwie_destroy.argtypes = [ctypes.c_void_p]
+    library.uwie_set_parameters.restype = ctypes.c_int
+    library.uwie_set_parameters.argtypes = [ctypes.c_void_p, ctypes.POINTER(_parameters)]
+    library.uwie_get_parameters.restype = ctypes.c_int
+    library.uwie_get_parameters.argtypes = [ctypes.c_void_p, ctypes.POINTER(_parameters)]
+    library.uwie_set_progress_callback.restype = None
+    library.uwie_set_progress_callback.argtypes = [ctypes.c_void_p, _progress_callback, ctypes.c_void_p]
+    library.uwie_last_error.restype = ctypes.c_char_p
+    library.uwie_last_error.argtypes = [ctypes.c_void_p]
+
+    for name in _stages:
+        function = getattr(library, name)
+        function.restype = ctypes.c_int
+        function.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_void_p, ctypes.c_size_t]
+
+    if library.uwie_version() < 2:
+        raise ImportError("uwie library is too old, version 2 or newer is needed")
+
+    return library
+
+
+_library = _load_library()
+
+
+class UwieError(RuntimeError):
+    pass
+
+
+def _check_rows(array, name, channels):
+    # pixels of a row must be contiguous, the rows themselves may be strided
+    if not isinstance(array, np.ndarray) or array.dtype != np.uint8:
+        raise TypeError(name + " must be a uint8 numpy array")
+
+    if channels == 1 and array.ndim == 3 and array.shape[2] == 1:
+        array = array[:, :, 0]
+
+    if channels == 1:
+        if array.ndim != 2 or array.strides[1] != 1:
+            raise ValueError(name + " must be a height x width array with contiguous rows")
+    elif array.ndim != 3 or array.shape[2] != channels or array.strides[2] != 1 or array.strides[1] != channels:
+        raise ValueError(name + " must be a height x width x %d array with contiguous rows" % channels)
+
+    if array.strides[0] < array.shape[1] * channels:
+        raise ValueError(name + " rows overlap")
+
+    return array
+
+
+class Enhancer:
+    """owns a context of the library, keyword arguments are the fields of uwie_parameters"""
+
+    def __init__(self, **params):
+        self._context = _library.uwie_create()
+        if not self._context:
+            raise MemoryError("uwie_create failed")
+
+        self._progress = None # the ctypes callback has to outlive the calls
+        self._lock = threading.Lock()
+        self.set_parameters(**params)
+
+    def close(self):
+        if self._context:
+            _library.uwie_destroy(self._context)
+            self._context = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def parameters(self):
+        params = _parameters()
+        _library.uwie_get_parameters(self._context, ctypes.byref(params))
+        return {name: getattr(params, name) for name, _ in _parameters._fields_}
+
+    def set_parameters(self, **params):
+        current = _parameters()
+        _library.uwie_get_parameters(self._context, ctypes.byref(current))
+        for name, value in params.items():
+            if name not in dict(_parameters._fields_):
+                raise TypeError("unknown parameter " + name)
+            setattr(current, name, int(value) if isinstance(value, bool) else value)
+
+        self._check(_library.uwie_set_parameters(self._context, ctypes.byref(current)))
+
+    def set_progress(self, function):
+        """function(progress) is called with values in [0, 1], returning False cancels the call"""
+        if function is None:
+            self._progress = _progress_callback()
+        else:
+            self._progress = _progress_callback(lambda value, data: 0 if function(value) is False else 1)
+
+        _library.uwie_set_progress_callback(self._context, self._progress, None)
+
+    def process(self, frame, out=None):
+        return self._run(_library.uwie_process, frame, out, 4)
+
+    def redefine(self, frame, out=None):
+        return self._run(_library.uwie_redefine, frame, out, 4)
+
+    def attenuation_map(self, frame, out=None):
+        return self._run(_library.uwie_attenuation_map, frame, out, 1)
+
+    def detail_map(self, frame, out=None):
+        return self._run(_library.uwie_detail_map, frame, out, 4)
+
+    def lab_contrast(self, frame, out=None):
+        return self._run(_library.uwie_lab_contrast, frame, out, 4)
+
+    def _run(self, function, frame, out, out_channels):
+        frame = _check_rows(frame, "frame", 4)
+        height, width = frame.shape[:2]
+
+        if out is None:
+            out = np.empty((height, width, out_channels) if out_channels > 1 else (height, width), dtype=np.uint8)
+
+        result = out
+        out = _check_rows(out, "out", out_channels)
+        if out.shape[:2] != (height, width):
+            raise ValueError("out must have the size of the frame")
+
+        if not out.flags.writeable:
+            raise ValueError("out is read only")
+
+        # the context is not reentrant, the lock only guards against sharing an enhancer by mistake
+        if not self._lock.acquire(blocking=False):
+            raise RuntimeError("enhancer is in use by another thread")
+
+        try:
+            status = function(self._context, frame.ctypes.data, frame.strides[0], width, height, out.ctypes.data, out.strides[0])
+        finally:
+            self._lock.release()
+
+        self._check(status)
+        return result
+
+    def _check(self, status):
+        if status == _OK:
+            return
+
+        message = _library.uwie_last_error(self._context).decode(errors="replace")
+        if status == _CANCELLED:
+            raise InterruptedError(message)
+
+        if status == _OUT_OF_MEMORY:
+            raise MemoryError(message)
+
+        raise UwieError(message or "uwie call failed with status %d" % status)
+
+
+_local = threading.local()
+
+
+def _enhancer(params):
+    # one enhancer per thread keeps the scratch memory warm between calls of the module functions
+    if not hasattr(_local, "enhancer"):
+        _local.enhancer = Enhancer()
+        _local.defaults = _local.enhancer.parameters()
+
+    settings = dict(_local.defaults)
+    settings.update(params)
+    _local.enhancer.set_parameters(**settings)
+    return _local.enhancer
+
+
+def process(frame, out=None, **params):
+    return _enhancer(params).process(frame, out)
+
+
+def redefine(frame, out=None, **params):
+    return _enhancer(params).redefine(frame, out)
+
+
+def attenuation_map(frame, out=None, **params):
+    return _enhancer(params).attenuation_map(frame, out)
+
+
+def detail_map(frame, out=None, **params):
+    return _enhancer(params).detail_map(frame, out)
+
+
+def lab_contrast(frame, out=None, **params):
+    return _enhancer(params).lab_contrast(frame, out)
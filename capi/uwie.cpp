@@ -0,0 +1,268 @@
+#include "uwie.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "pipeline/pipeline.h"
+
+namespace {
+  constexpr size_t bytes_per_pixel = 4;
+}
+
+struct uwie_context
+{
+  pipeline::parameters params;
+  uwie_progress_callback progress = nullptr;
+  void * progressData = nullptr;
+
+  // scratch kept between calls: packed input rows, the result (its image keeps the capacity for padded output rows)
+  // and the image of a single stage
+  std::vector<uint8_t> packedInput;
+  pipeline::result output;
+  std::vector<uint8_t> stageOutput;
+
+  std::string lastError;
+};
+
+namespace {
+
+  uwie_status fail(uwie_context * context, uwie_status status, const char * message)
+  {
+    context->lastError = message;
+    return status;
+  }
+
+  // checks the buffers, packs padded input rows and copies the image returned by the stage into the rows of out.
+  // when the rows of out are packed the stage gets them as packed_out and may write its image there directly, it
+  // returns the span it wrote then and nothing is copied. an empty span means it was cancelled
+  template <typename stage_function>
+  uwie_status run_stage(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride, size_t out_bytes_per_pixel, const stage_function & stage)
+  {
+    if (context == nullptr)
+    {
+      return UWIE_INVALID_ARGUMENT;
+    }
+
+    context->lastError.clear();
+
+    const size_t row_bytes = static_cast<size_t>(width) * bytes_per_pixel;
+    const size_t out_row_bytes = static_cast<size_t>(width) * out_bytes_per_pixel;
+    if ((rgba == nullptr) || (out == nullptr) || (width == 0) || (height == 0) || (stride < row_bytes) || (out_stride < out_row_bytes))
+    {
+      return fail(context, UWIE_INVALID_ARGUMENT, "invalid image buffers or size");
+    }
+
+    // exceptions (allocation failures) must not cross the c boundary
+    try
+    {
+      std::span<const uint8_t> input (rgba, row_bytes * height);
+      if (stride != row_bytes)
+      {
+        context->packedInput.resize(row_bytes * height);
+        for (size_t i=0; i<height; i++)
+        {
+          std::memcpy(context->packedInput.data() + (i * row_bytes), rgba + (i * stride), row_bytes);
+        }
+
+        input = context->packedInput;
+      }
+
+      pipeline::progress_callback progress;
+      if (context->progress != nullptr)
+      {
+        progress = [context](float value) -> bool {
+          return context->progress(value, context->progressData) != 0;
+        };
+      }
+
+      const std::span<uint8_t> packed_out = (out_stride == out_row_bytes) ? std::span<uint8_t>(out, out_row_bytes * height) : std::span<uint8_t>();
+      const std::span<const uint8_t> image = stage(input, packed_out, progress);
+      if (image.empty())
+      {
+        return fail(context, UWIE_CANCELLED, "processing was cancelled");
+      }
+
+      if (image.size() < (out_row_bytes * height))
+      {
+        return fail(context, UWIE_FAILED, "processing failed");
+      }
+
+      if (image.data() != out)
+      {
+        for (size_t i=0; i<height; i++)
+        {
+          std::memcpy(out + (i * out_stride), image.data() + (i * out_row_bytes), out_row_bytes);
+        }
+      }
+    }
+    catch (const std::bad_alloc &)
+    {
+      return fail(context, UWIE_OUT_OF_MEMORY, "out of memory");
+    }
+    catch (const std::exception & e)
+    {
+      return fail(context, UWIE_FAILED, e.what());
+    }
+
+    return UWIE_OK;
+  }
+}
+
+extern "C" {
+
+  int uwie_version(void)
+  {
+    return UWIE_VERSION;
+  }
+
+  void uwie_default_parameters(uwie_parameters * params)
+  {
+    if (params == nullptr)
+    {
+      return;
+    }
+
+    const pipeline::parameters defaults;
+    params->block_size = defaults.local_block_size;
+    params->sharp = defaults.sharp_const;
+    params->enhance = defaults.enhance_const;
+    params->k = defaults.k_const;
+    params->v = defaults.v_const;
+    params->guided_radius = defaults.guided_radius;
+    params->gamma = defaults.attenuation_gamma;
+    params->contrast_mode = static_cast<uwie_contrast_mode>(defaults.local_contrast_mode);
+    params->half_storage = defaults.half_storage ? 1 : 0;
+    params->fixed_point = (defaults.arithmetic == pipeline::arithmetic_mode::fixed_point) ? 1 : 0;
+  }
+
+  uwie_context * uwie_create(void)
+  {
+    return new (std::nothrow) uwie_context;
+  }
+
+  void uwie_destroy(uwie_context * context)
+  {
+    delete context;
+  }
+
+  uwie_status uwie_set_parameters(uwie_context * context, const uwie_parameters * params)
+  {
+    if (context == nullptr)
+    {
+      return UWIE_INVALID_ARGUMENT;
+    }
+
+    if ((params == nullptr) || (params->block_size == 0) || (params->contrast_mode < UWIE_CONTRAST_BLOCK) || (params->contrast_mode > UWIE_CONTRAST_SLIDING_WINDOW))
+    {
+      return fail(context, UWIE_INVALID_ARGUMENT, "invalid parameters");
+    }
+
+    context->params.local_block_size = params->block_size;
+    context->params.sharp_const = params->sharp;
+    context->params.enhance_const = params->enhance;
+    context->params.k_const = params->k;
+    context->params.v_const = params->v;
+    context->params.guided_radius = params->guided_radius;
+    context->params.attenuation_gamma = params->gamma;
+    context->params.local_contrast_mode = static_cast<pipeline::contrast_mode>(params->contrast_mode);
+    context->params.half_storage = (params->half_storage != 0);
+    context->params.arithmetic = (params->fixed_point != 0) ? pipeline::arithmetic_mode::fixed_point : pipeline::arithmetic_mode::floating_point;
+    return UWIE_OK;
+  }
+
+  uwie_status uwie_get_parameters(const uwie_context * context, uwie_parameters * params)
+  {
+    if ((context == nullptr) || (params == nullptr))
+    {
+      return UWIE_INVALID_ARGUMENT;
+    }
+
+    params->block_size = context->params.local_block_size;
+    params->sharp = context->params.sharp_const;
+    params->enhance = context->params.enhance_const;
+    params->k = context->params.k_const;
+    params->v = context->params.v_const;
+    params->guided_radius = context->params.guided_radius;
+    params->gamma = context->params.attenuation_gamma;
+    params->contrast_mode = static_cast<uwie_contrast_mode>(context->params.local_contrast_mode);
+    params->half_storage = context->params.half_storage ? 1 : 0;
+    params->fixed_point = (context->params.arithmetic == pipeline::arithmetic_mode::fixed_point) ? 1 : 0;
+    return UWIE_OK;
+  }
+
+  void uwie_set_progress_callback(uwie_context * context, uwie_progress_callback callback, void * user_data)
+  {
+    if (context != nullptr)
+    {
+      context->progress = callback;
+      context->progressData = user_data;
+    }
+  }
+
+  uwie_status uwie_process(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride)
+  {
+    return run_stage(context, rgba, stride, width, height, out, out_stride, bytes_per_pixel, [context, width, height](std::span<const uint8_t> input, std::span<uint8_t> packed_out, const pipeline::progress_callback & progress) -> std::span<const uint8_t> {
+      if (!packed_out.empty())
+      {
+        return pipeline::process(input, width, height, context->params, packed_out, progress) ? packed_out : std::span<uint8_t>();
+      }
+
+      if (!pipeline::process(input, width, height, context->params, context->output, false, progress))
+      {
+        return {};
+      }
+
+      return context->output.color_corrected_image;
+    });
+  }
+
+  uwie_status uwie_redefine(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride)
+  {
+    return run_stage(context, rgba, stride, width, height, out, out_stride, bytes_per_pixel, [context, width, height](std::span<const uint8_t> input, std::span<uint8_t>, const pipeline::progress_callback &) -> std::span<const uint8_t> {
+      context->stageOutput = pipeline::redefine(input, width, height, bytes_per_pixel, pipeline::redefine_loss_limit);
+      return context->stageOutput;
+    });
+  }
+
+  uwie_status uwie_attenuation_map(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride)
+  {
+    return run_stage(context, rgba, stride, width, height, out, out_stride, 1, [context, width, height](std::span<const uint8_t> input, std::span<uint8_t>, const pipeline::progress_callback &) -> std::span<const uint8_t> {
+      context->stageOutput = pipeline::attenuation_map_max(input, width, height, bytes_per_pixel, context->params.attenuation_gamma);
+      return context->stageOutput;
+    });
+  }
+
+  uwie_status uwie_detail_map(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride)
+  {
+    return run_stage(context, rgba, stride, width, height, out, out_stride, bytes_per_pixel, [context, width, height](std::span<const uint8_t> input, std::span<uint8_t>, const pipeline::progress_callback &) -> std::span<const uint8_t> {
+      context->stageOutput = pipeline::detail_map(input, width, height, context->params.sharp_const);
+      return context->stageOutput;
+    });
+  }
+
+  uwie_status uwie_lab_contrast(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride)
+  {
+    return run_stage(context, rgba, stride, width, height, out, out_stride, bytes_per_pixel, [context, width, height](std::span<const uint8_t> input, std::span<uint8_t> packed_out, const pipeline::progress_callback & progress) -> std::span<const uint8_t> {
+      if (!packed_out.empty())
+      {
+        return pipeline::lab_contrast(input, width, height, context->params, packed_out, progress) ? packed_out : std::span<uint8_t>();
+      }
+
+      if (!pipeline::lab_contrast(input, width, height, context->params, context->output, progress))
+      {
+        return {};
+      }
+
+      return context->output.color_corrected_image;
+    });
+  }
+
+  const char * uwie_last_error(const uwie_context * context)
+  {
+    return (context != nullptr) ? context->lastError.c_str() : "no context";
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/* c interface of the enhancement pipeline for other languages (shared library uwie). images are 8-bit rgba rows in
+   memory owned by the caller, rows may be padded (stride in bytes). a context keeps its parameters and scratch
+   memory between calls, it may be used by one thread at a time, different contexts run in parallel */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(UWIE_BUILD)
+#define UWIE_API __declspec(dllexport)
+#else
+#define UWIE_API __declspec(dllimport)
+#endif
+#else
+#define UWIE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UWIE_VERSION 2
+
+typedef struct uwie_context uwie_context;
+
+typedef enum uwie_status
+{
+  UWIE_OK = 0,
+  UWIE_INVALID_ARGUMENT,
+  UWIE_OUT_OF_MEMORY,
+  UWIE_CANCELLED,
+  UWIE_FAILED
+} uwie_status;
+
+typedef enum uwie_contrast_mode
+{
+  UWIE_CONTRAST_BLOCK = 0,
+  UWIE_CONTRAST_INTERPOLATED,
+  UWIE_CONTRAST_SLIDING_WINDOW
+} uwie_contrast_mode;
+
+/* same meaning and defaults as the command line options */
+typedef struct uwie_parameters
+{
+  uint32_t block_size;
+  float sharp;
+  float enhance;
+  float k;
+  float v;
+  uint32_t guided_radius;
+  float gamma;
+  uwie_contrast_mode contrast_mode;
+  int half_storage; /* non zero keeps intermediate planes in fp16 */
+  int fixed_point; /* non zero uses the 16-bit integer pipeline */
+} uwie_parameters;
+
+/* returning zero from the callback cancels the call, progress is in [0, 1] */
+typedef int (*uwie_progress_callback)(float progress, void * user_data);
+
+UWIE_API int uwie_version(void);
+UWIE_API void uwie_default_parameters(uwie_parameters * params);
+
+UWIE_API uwie_context * uwie_create(void);
+UWIE_API void uwie_destroy(uwie_context * context);
+
+UWIE_API uwie_status uwie_set_parameters(uwie_context * context, const uwie_parameters * params);
+UWIE_API uwie_status uwie_get_parameters(const uwie_context * context, uwie_parameters * params);
+UWIE_API void uwie_set_progress_callback(uwie_context * context, uwie_progress_callback callback, void * user_data);
+
+/* enhances width x height pixels of rgba into out, both with at least width * 4 bytes per row. when stride is
+   width * 4 the input is read in place, padded rows are packed into scratch memory of the context first. when
+   out_stride is width * 4 the result is written into out directly, padded rows are copied from the context */
+UWIE_API uwie_status uwie_process(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride);
+
+/* single stages of uwie_process with the same buffer rules, for looking at the intermediate images. redefine,
+   detail_map and lab_contrast write rgba, attenuation_map writes one gray byte per pixel (out_stride >= width).
+   lab_contrast takes rgba as the color transfer output and runs the local contrast, guided filter and color
+   balance stages on it */
+UWIE_API uwie_status uwie_redefine(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride);
+UWIE_API uwie_status uwie_attenuation_map(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride);
+UWIE_API uwie_status uwie_detail_map(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride);
+UWIE_API uwie_status uwie_lab_contrast(uwie_context * context, const uint8_t * rgba, size_t stride, uint32_t width, uint32_t height, uint8_t * out, size_t out_stride);
+
+/* message of the last failed call on the context, valid until the next call */
+UWIE_API const char * uwie_last_error(const uwie_context * context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,120 @@
+#include <cstring>
+#include <vector>
+
+#include "capi/uwie.h"
+#include "common/testcheck.h"
+#include "pipeline/pipeline.h"
+
+namespace {
+  constexpr uint32_t image_width = 131;
+  constexpr uint32_t image_height = 97;
+  constexpr size_t row_bytes = static_cast<size_t>(image_width) * 4;
+  constexpr size_t padding = 12;
+  constexpr uint8_t padding_value = 0xa5;
+
+  // rows of a frame at a larger stride, the padding is filled with padding_value
+  std::vector<uint8_t> padded(const std::vector<uint8_t> & pixels, size_t stride)
+  {
+    std::vector<uint8_t> rows (stride * image_height, padding_value);
+    for (size_t i=0; i<image_height; i++)
+    {
+      std::memcpy(rows.data() + (i * stride), pixels.data() + (i * row_bytes), row_bytes);
+    }
+
+    return rows;
+  }
+
+  std::vector<uint8_t> packed(const std::vector<uint8_t> & rows, size_t stride)
+  {
+    std::vector<uint8_t> pixels (row_bytes * image_height);
+    for (size_t i=0; i<image_height; i++)
+    {
+      std::memcpy(pixels.data() + (i * row_bytes), rows.data() + (i * stride), row_bytes);
+    }
+
+    return pixels;
+  }
+
+  bool padding_untouched(const std::vector<uint8_t> & rows, size_t stride)
+  {
+    for (size_t i=0; i<image_height; i++)
+    {
+      for (size_t j=row_bytes; j<stride; j++)
+      {
+        if (rows[(i * stride) + j] != padding_value)
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  using stage_function = uwie_status (*)(uwie_context *, const uint8_t *, size_t, uint32_t, uint32_t, uint8_t *, size_t);
+
+  // packed and padded input and output rows give the image of the pipeline, twice on the same context
+  void check_stage(uwie_context * context, stage_function stage, const std::vector<uint8_t> & expected, const std::string & name)
+  {
+    const auto input = testcheck::synthetic_frame(image_width, image_height);
+    const size_t stride = row_bytes + padding;
+    const auto padded_input = padded(input, stride);
+
+    for (size_t call=0; call<2; call++)
+    {
+      std::vector<uint8_t> out (row_bytes * image_height);
+      testcheck::check(stage(context, input.data(), row_bytes, image_width, image_height, out.data(), row_bytes) == UWIE_OK, name + ": packed rows succeed");
+      testcheck::check(out == expected, name + ": packed rows match the pipeline");
+
+      std::vector<uint8_t> padded_out (stride * image_height, padding_value);
+      testcheck::check(stage(context, padded_input.data(), stride, image_width, image_height, padded_out.data(), stride) == UWIE_OK, name + ": padded rows succeed");
+      testcheck::check(packed(padded_out, stride) == expected, name + ": padded rows match the pipeline");
+      testcheck::check(padding_untouched(padded_out, stride), name + ": padding of the output rows is not written");
+    }
+  }
+
+  void set_arithmetic(uwie_context * context, bool fixed_point)
+  {
+    uwie_parameters params;
+    uwie_default_parameters(&params);
+    params.fixed_point = fixed_point ? 1 : 0;
+    testcheck::check(uwie_set_parameters(context, &params) == UWIE_OK, "parameters are accepted");
+  }
+}
+
+int main()
+{
+  testcheck::check(uwie_version() == UWIE_VERSION, "version of the header and the library match");
+
+  uwie_context * context = uwie_create();
+  if (!testcheck::check(context != nullptr, "context is created"))
+  {
+    return testcheck::result();
+  }
+
+  const auto input = testcheck::synthetic_frame(image_width, image_height);
+  for (const bool fixed_point : {false, true})
+  {
+    set_arithmetic(context, fixed_point);
+    const std::string arithmetic = fixed_point ? "fixed point" : "floating point";
+
+    pipeline::parameters params;
+    params.arithmetic = fixed_point ? pipeline::arithmetic_mode::fixed_point : pipeline::arithmetic_mode::floating_point;
+
+    pipeline::result expected;
+    pipeline::process(input, image_width, image_height, params, expected, false);
+    check_stage(context, uwie_process, expected.color_corrected_image, "process, " + arithmetic);
+
+    pipeline::result expected_contrast;
+    pipeline::lab_contrast(input, image_width, image_height, params, expected_contrast);
+    check_stage(context, uwie_lab_contrast, expected_contrast.color_corrected_image, "lab_contrast, " + arithmetic);
+  }
+
+  std::vector<uint8_t> out (row_bytes * image_height);
+  testcheck::check(uwie_process(context, input.data(), row_bytes - 1, image_width, image_height, out.data(), row_bytes) == UWIE_INVALID_ARGUMENT, "rows shorter than the width are rejected");
+  testcheck::check(uwie_process(context, nullptr, row_bytes, image_width, image_height, out.data(), row_bytes) == UWIE_INVALID_ARGUMENT, "missing input is rejected");
+  testcheck::check(std::strlen(uwie_last_error(context)) > 0, "rejected calls set the last error");
+
+  uwie_destroy(context);
+  return testcheck::result();
+}
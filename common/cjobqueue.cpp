@@ -0,0 +1,104 @@
+#include "cjobqueue.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+cjobqueue::cjobqueue(size_t capacity)
+{
+  const size_t ring_size = std::bit_ceil(std::max(capacity, static_cast<size_t>(2)));
+  cells = std::make_unique<cell[]>(ring_size);
+  mask = ring_size - 1;
+
+  for (size_t i=0; i<ring_size; i++)
+  {
+    cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+void cjobqueue::push(ctask && task)
+{
+  if (trypushring(task))
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(overflowmutex);
+  overflow.push_back(std::move(task));
+  overflowCount.fetch_add(1, std::memory_order_release);
+}
+
+bool cjobqueue::trypushring(ctask & task)
+{
+  // a cell is free for position pos when its sequence is pos, and filled when it is pos + 1
+  size_t pos = tail.load(std::memory_order_relaxed);
+  while (true)
+  {
+    cell & c = cells[pos & mask];
+    const size_t sequence = c.sequence.load(std::memory_order_acquire);
+    const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+    if (diff == 0)
+    {
+      if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        c.task = std::move(task);
+        c.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      return false; // full
+    }
+    else
+    {
+      pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool cjobqueue::trypop(ctask & task)
+{
+  size_t pos = head.load(std::memory_order_relaxed);
+  while (true)
+  {
+    cell & c = cells[pos & mask];
+    const size_t sequence = c.sequence.load(std::memory_order_acquire);
+    const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+    if (diff == 0)
+    {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        task = std::move(c.task);
+        c.sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      break; // empty, or the producer of the next cell has not finished writing it
+    }
+    else
+    {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  if (overflowCount.load(std::memory_order_acquire) == 0)
+  {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(overflowmutex);
+  if (overflow.empty())
+  {
+    return false;
+  }
+
+  task = std::move(overflow.front());
+  overflow.pop_front();
+  overflowCount.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
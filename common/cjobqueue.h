@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "ctask.h"
+
+// multi producer multi consumer queue of tasks. a bounded ring where producers and consumers only claim cells with
+// a compare exchange of their index (no lock), cells carry a sequence number that tells whether they are free or
+// filled. when the ring is full the tasks go to an overflow list under a mutex, so pushing never fails
+class cjobqueue
+{
+  public:
+    explicit cjobqueue(size_t capacity = 256);
+
+    cjobqueue(const cjobqueue &) = delete;
+    cjobqueue & operator=(const cjobqueue &) = delete;
+
+    void push(ctask && task);
+    bool trypop(ctask & task);
+
+  private:
+    struct cell
+    {
+      std::atomic<size_t> sequence;
+      ctask task;
+    };
+
+    bool trypushring(ctask & task);
+
+    std::unique_ptr<cell[]> cells;
+    size_t mask = 0;
+
+    // producers and consumers on their own cache lines
+    alignas(64) std::atomic<size_t> tail = 0;
+    alignas(64) std::atomic<size_t> head = 0;
+
+    alignas(64) std::atomic<size_t> overflowCount = 0;
+    std::mutex overflowmutex;
+    std::deque<ctask> overflow;
+};
@@ -33,10 +33,17 @@ static EXCEPTION_DISPOSITION NTAPI ignore_handler(EXCEPTION_RECORD *rec,
 #include <pthread.h>
 #endif
 
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #if defined(_WIN32) || defined(WIN32)
 // set thread name for windows
 //https://gist.github.com/rossy/7faf0ab90a54d6b5a46f
-void cjthread::setname(std::string name)
+void cjthread::setcurrentname(std::string name)
 {
 
   static const DWORD MS_VC_EXCEPTION = 0x406D1388;
@@ -68,6 +75,12 @@ void cjthread::setname(std::string name)
   // Pop exception handler
   tib->ExceptionList = tib->ExceptionList->Next;
 }
+
+void cjthread::setname(std::string name)
+{
+  // the debugger event names the calling thread
+  setcurrentname(name);
+}
 #elif defined(linux) || defined(unix)
 void cjthread::setname(std::string name)
 {
@@ -78,6 +91,16 @@ void cjthread::setname(std::string name)
 
   pthread_setname_np(thread.native_handle(), name.c_str());
 }
+
+void cjthread::setcurrentname(std::string name)
+{
+  if (name.size() > 15)
+  {
+    name[15] = '\0';
+  }
+
+  pthread_setname_np(pthread_self(), name.c_str());
+}
 #endif
 
 void cjthread::setdescription(std::string description)
@@ -94,3 +117,59 @@ std::string cjthread::description()
 {
   return threadDesc;
 }
+
+#if defined(_WIN32) || defined(WIN32)
+bool cjthread::setcurrentaffinity(const std::vector<size_t> & cpus)
+{
+  // processor groups are not handled, only the first 64 cpus can be selected
+  DWORD_PTR mask = 0;
+  for (const size_t cpu : cpus)
+  {
+    if (cpu < (sizeof(DWORD_PTR) * CHAR_BIT))
+    {
+      mask |= (static_cast<DWORD_PTR>(1) << cpu);
+    }
+  }
+
+  return (mask != 0) && (SetThreadAffinityMask(GetCurrentThread(), mask) != 0);
+}
+
+bool cjthread::setcurrentpriority(priority thread_priority)
+{
+  const int levels[] = {THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL};
+  return SetThreadPriority(GetCurrentThread(), levels[static_cast<size_t>(thread_priority)]) != 0;
+}
+#elif defined(__linux__)
+bool cjthread::setcurrentaffinity(const std::vector<size_t> & cpus)
+{
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const size_t cpu : cpus)
+  {
+    if (cpu < CPU_SETSIZE)
+    {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+
+  return (CPU_COUNT(&cpu_set) > 0) && (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0);
+}
+
+bool cjthread::setcurrentpriority(priority thread_priority)
+{
+  // linux keeps a nice value per thread, the thread id selects it
+  const int nice_values[] = {10, 0, -5};
+  const auto thread_id = static_cast<id_t>(syscall(SYS_gettid));
+  return setpriority(PRIO_PROCESS, thread_id, nice_values[static_cast<size_t>(thread_priority)]) == 0;
+}
+#else
+bool cjthread::setcurrentaffinity(const std::vector<size_t> & cpus)
+{
+  return false;
+}
+
+bool cjthread::setcurrentpriority(priority thread_priority)
+{
+  return thread_priority == priority::normal;
+}
+#endif
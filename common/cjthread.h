@@ -2,11 +2,21 @@
 
 #include <thread>
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <functional>
+#include "ctask.h"
 
 class cjthread
 {
   public:
+    enum class priority : uint8_t
+    {
+      background,
+      normal,
+      interactive
+    };
+
     cjthread()
     {
     }
@@ -16,9 +26,9 @@ class cjthread
       : thread
       (&cjthread::cinit
       ,this
-      ,std::forward<std::string>(threadName)
+      ,std::string(threadName)
       ,std::forward<std::string>("No description")
-      ,std::bind(std::forward<callable>(func) ,std::forward<argslist>(args)...)
+      ,std::bind_front(std::forward<callable>(func), std::forward<argslist>(args)...)
       )
     {
     }
@@ -30,7 +40,7 @@ class cjthread
       ,this
       ,std::forward<std::string>(thread_name)
       ,std::forward<std::string>("No description")
-      ,std::bind(std::forward<callable>(func), std::forward<argslist>(args)...)
+      ,std::bind_front(std::forward<callable>(func), std::forward<argslist>(args)...)
       )
     {
     }
@@ -42,7 +52,7 @@ class cjthread
       ,this
       ,std::forward<std::string>(thread_name)
       ,std::forward<std::string>("No description")
-      ,std::bind(std::forward<callable>(func), std::forward<argslist>(args)...)
+      ,std::bind_front(std::forward<callable>(func), std::forward<argslist>(args)...)
       )
     {
     }
@@ -54,7 +64,7 @@ class cjthread
       ,this
       ,std::forward<std::string>(thread_name)
       ,std::forward<std::string>("No description")
-      ,std::bind(std::forward<callable>(func), std::forward<argslist>(args)...)
+      ,std::bind_front(std::forward<callable>(func), std::forward<argslist>(args)...)
       )
     {
     }
@@ -66,7 +76,7 @@ class cjthread
       ,this
       ,std::forward<std::string>(thread_name)
       ,std::forward<std::string>(thread_description)
-      ,std::bind(std::forward<callable>(func), std::forward<argslist>(args)...)
+      ,std::bind_front(std::forward<callable>(func), std::forward<argslist>(args)...)
       )
     {
     }
@@ -78,7 +88,7 @@ class cjthread
       ,this
       ,std::forward<std::string>(thread_name)
       ,std::forward<std::string>(thread_description)
-      ,std::bind(std::forward<callable>(func), std::forward<argslist>(args)...)
+      ,std::bind_front(std::forward<callable>(func), std::forward<argslist>(args)...)
       )
     {
     }
@@ -89,19 +99,26 @@ class cjthread
     std::string name();
     std::string description();
 
-  private:
-    std::jthread thread;
+    // these act on the calling thread so a thread can place itself before it starts its work. false when the
+    // platform does not support it or the call is not permitted, raising the priority usually needs privileges
+    static bool setcurrentaffinity(const std::vector<size_t> & cpus);
+    static bool setcurrentpriority(priority thread_priority);
+    static void setcurrentname(std::string name);
 
-    void cinit(std::string && name, std::string && description, std::function<void()> && task)
+  private:
+    void cinit(std::string && name, std::string && description, ctask && task)
     {
       threadName = name;
       threadDesc = description;
 
-      setname(name);
+      setcurrentname(name);
 
       task();
     }
 
     std::string threadName = "Unnamed";
     std::string threadDesc = "No description";
+
+    // declared last, the thread starts in its constructor and uses the members above
+    std::jthread thread;
 };
@@ -0,0 +1,131 @@
+#include "cputopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace {
+#if defined(__linux__)
+  // cpu and node lists of sysfs look like "0-7,16-23"
+  std::vector<size_t> parse_cpu_list(const std::string & list)
+  {
+    std::vector<size_t> cpus;
+    size_t position = 0;
+    while (position < list.size())
+    {
+      size_t range_end = list.find(',', position);
+      if (range_end == std::string::npos)
+      {
+        range_end = list.size();
+      }
+
+      const std::string range = list.substr(position, range_end - position);
+      const size_t dash = range.find('-');
+      try
+      {
+        const size_t first = std::stoul(range.substr(0, dash));
+        const size_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+        for (size_t cpu=first; cpu<=last; cpu++)
+        {
+          cpus.push_back(cpu);
+        }
+      }
+      catch (const std::exception &)
+      {
+        // empty lists (memory only nodes) or a line end
+      }
+
+      position = range_end + 1;
+    }
+
+    return cpus;
+  }
+#endif
+}
+
+cputopology::cputopology()
+{
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+  {
+    for (size_t cpu=0; cpu<CPU_SETSIZE; cpu++)
+    {
+      if (CPU_ISSET(cpu, &allowed))
+      {
+        allCpus.push_back(cpu);
+      }
+    }
+  }
+
+  // node numbers may have gaps, the online list has the ones in use
+  std::ifstream online_file("/sys/devices/system/node/online");
+  std::string online_list;
+  if (online_file && std::getline(online_file, online_list))
+  {
+    for (const size_t node : parse_cpu_list(online_list))
+    {
+      std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+      std::string list;
+      if (!file || !std::getline(file, list))
+      {
+        continue;
+      }
+
+      std::vector<size_t> cpus;
+      for (const size_t cpu : parse_cpu_list(list))
+      {
+        if (std::find(allCpus.begin(), allCpus.end(), cpu) != allCpus.end())
+        {
+          cpus.push_back(cpu);
+        }
+      }
+
+      if (!cpus.empty())
+      {
+        nodeCpus.push_back(std::move(cpus));
+      }
+    }
+  }
+#endif
+
+  if (allCpus.empty())
+  {
+    for (size_t cpu=0; cpu<std::max(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(1)); cpu++)
+    {
+      allCpus.push_back(cpu);
+    }
+  }
+
+  if (nodeCpus.empty())
+  {
+    nodeCpus.push_back(allCpus);
+  }
+}
+
+const cputopology & cputopology::current()
+{
+  static const cputopology topology;
+  return topology;
+}
+
+size_t cputopology::numberofnodes() const
+{
+  return nodeCpus.size();
+}
+
+const std::vector<size_t> & cputopology::cpusofnode(size_t node) const
+{
+  return nodeCpus[node % nodeCpus.size()];
+}
+
+const std::vector<size_t> & cputopology::cpus() const
+{
+  return allCpus;
+}
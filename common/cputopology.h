@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// cpus the process may run on, grouped by numa node. read once from sysfs on linux, other platforms and systems
+// without numa information are a single node with all cpus
+class cputopology
+{
+  public:
+    [[nodiscard]] static const cputopology & current();
+
+    [[nodiscard]] size_t numberofnodes() const;
+    [[nodiscard]] const std::vector<size_t> & cpusofnode(size_t node) const;
+    [[nodiscard]] const std::vector<size_t> & cpus() const;
+
+  private:
+    cputopology();
+
+    std::vector<std::vector<size_t>> nodeCpus;
+    std::vector<size_t> allCpus;
+};
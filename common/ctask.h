@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// move only void() callable for the thread pools. callables that fit in inline_size bytes (a lambda with a few
+// references and indices) are stored in place so submitting them does not allocate, larger ones go on the heap.
+// the whole task is one cache line
+class ctask
+{
+  public:
+    static constexpr size_t inline_size = 56;
+
+    ctask() noexcept = default;
+
+    ctask(std::nullptr_t) noexcept
+    {
+    }
+
+    template<typename callable, typename = std::enable_if_t<!std::is_same_v<std::decay_t<callable>, ctask> && std::is_invocable_v<std::decay_t<callable> &>>>
+    ctask(callable && func)
+    {
+      using stored = std::decay_t<callable>;
+      if constexpr ((sizeof(stored) <= inline_size) && (alignof(stored) <= alignof(std::max_align_t)) && std::is_nothrow_move_constructible_v<stored>)
+      {
+        new (storage) stored(std::forward<callable>(func));
+        ops = &inline_operations<stored>;
+      }
+      else
+      {
+        *reinterpret_cast<stored **>(storage) = new stored(std::forward<callable>(func));
+        ops = &heap_operations<stored>;
+      }
+    }
+
+    ctask(ctask && other) noexcept
+    {
+      take(other);
+    }
+
+    ctask & operator=(ctask && other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        take(other);
+      }
+
+      return *this;
+    }
+
+    ctask(const ctask &) = delete;
+    ctask & operator=(const ctask &) = delete;
+
+    ~ctask()
+    {
+      reset();
+    }
+
+    void operator()()
+    {
+      ops->invoke(storage);
+    }
+
+    explicit operator bool() const noexcept
+    {
+      return ops != nullptr;
+    }
+
+    void reset() noexcept
+    {
+      if (ops != nullptr)
+      {
+        ops->destroy(storage);
+        ops = nullptr;
+      }
+    }
+
+  private:
+    struct operations
+    {
+      void (*invoke)(void * storage);
+      void (*move)(void * destination, void * source) noexcept; // also destroys the source
+      void (*destroy)(void * storage) noexcept;
+    };
+
+    template<typename stored>
+    static constexpr operations inline_operations = {
+      [](void * storage) { (*std::launder(reinterpret_cast<stored *>(storage)))(); }
+     ,[](void * destination, void * source) noexcept {
+        auto * source_callable = std::launder(reinterpret_cast<stored *>(source));
+        new (destination) stored(std::move(*source_callable));
+        source_callable->~stored();
+      }
+     ,[](void * storage) noexcept { std::launder(reinterpret_cast<stored *>(storage))->~stored(); }
+    };
+
+    template<typename stored>
+    static constexpr operations heap_operations = {
+      [](void * storage) { (**reinterpret_cast<stored **>(storage))(); }
+     ,[](void * destination, void * source) noexcept { *reinterpret_cast<stored **>(destination) = *reinterpret_cast<stored **>(source); }
+     ,[](void * storage) noexcept { delete *reinterpret_cast<stored **>(storage); }
+    };
+
+    void take(ctask & other) noexcept
+    {
+      if (other.ops != nullptr)
+      {
+        other.ops->move(storage, other.storage);
+        ops = std::exchange(other.ops, nullptr);
+      }
+    }
+
+    alignas(std::max_align_t) std::byte storage[inline_size];
+    const operations * ops = nullptr;
+};
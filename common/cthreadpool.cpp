@@ -1,9 +1,12 @@
 #include "cthreadpool.h"
+#include "cputopology.h"
+#include <algorithm>
 #include <chrono>
 
 namespace {
-  const constexpr size_t wait_time_ms = 10;
   const constexpr char * default_thread_name = "tp";
+
+  thread_local size_t worker_node = cthreadpool::any_node;
 }
 
 cthreadpool::cthreadpool(size_t n_threads)
@@ -17,13 +20,34 @@ cthreadpool::cthreadpool(const size_t && n_threads, const std::string && t_pool_
 }
 
 cthreadpool::cthreadpool(size_t n_threads, const std::string & t_pool_name)
+  : cthreadpool(n_threads, t_pool_name, options())
+{
+}
+
+cthreadpool::cthreadpool(size_t n_threads, const std::string & t_pool_name, const options & pool_options)
 {
   nThreads = n_threads;
   name = t_pool_name;
+  poolOptions = pool_options;
+  nNodes = (pool_options.threadplacement == placement::numa) ? cputopology::current().numberofnodes() : 1;
+
+  for (auto & priority_queues : queuedJobs)
+  {
+    for (size_t q=0; q<=nNodes; q++)
+    {
+      priority_queues.push_back(std::make_unique<cjobqueue>());
+    }
+  }
+
+  threadNode.resize(n_threads);
+  for (size_t i=0; i<n_threads; i++)
+  {
+    threadNode[i] = i % nNodes;
+  }
+
   threads.reserve(n_threads);
   for (size_t i=0; i<n_threads; i++)
   {
-    threadInUse.emplace_back(false);
     const std::string thread_name = (t_pool_name + "_" + std::to_string(i));
     threads.emplace_back(thread_name, &cthreadpool::threadpooltask, this, i);
   }
@@ -32,27 +56,51 @@ cthreadpool::cthreadpool(size_t n_threads, const std::string & t_pool_name)
 cthreadpool::~cthreadpool()
 {
   running = false;
+  jobSignal.fetch_add(1);
+  jobSignal.notify_all();
+
+  // join the workers here, they use the queues and the signal which are destroyed after this body
+  threads.clear();
 }
 
-void cthreadpool::addjob(const std::function<void()>& job)
+cjobqueue & cthreadpool::jobqueue(jobpriority priority, size_t numa_node)
 {
-  std::lock_guard<std::recursive_mutex> lock(qrmutex);
-  queuedJobs.push(job);
-  cvJobAvailable.notify_all();
+  const size_t queue = ((numa_node == any_node) || (nNodes == 1)) ? 0 : ((numa_node % nNodes) + 1);
+  return *queuedJobs[static_cast<size_t>(priority)][queue];
 }
 
-void cthreadpool::addjob(std::function<void()>&& job) noexcept
+void cthreadpool::signaljobs(size_t count)
 {
-  std::lock_guard<std::recursive_mutex> lock(qrmutex);
-  queuedJobs.push(std::forward<std::function<void()>>(job));
-  cvJobAvailable.notify_all();
+  // the signal changes after the jobs are in the queue, a worker that found the queues empty before that does not
+  // go to sleep on the old value
+  nQueuedJobs.fetch_add(static_cast<std::ptrdiff_t>(count));
+  jobSignal.fetch_add(1);
+  if (nSleepingThreads == 0)
+  {
+    return;
+  }
+
+  if (count == 1)
+  {
+    jobSignal.notify_one();
+  }
+  else
+  {
+    jobSignal.notify_all();
+  }
+}
+
+void cthreadpool::addjob(ctask && job, jobpriority priority, size_t numa_node) noexcept
+{
+  jobqueue(priority, numa_node).push(std::move(job));
+  signaljobs(1);
 }
 
 void cthreadpool::waitforthread()
 {
   std::unique_lock<decltype(checkmutex)> lock_check (checkmutex);
   while (!forceCancelWait && cvCheckForFreeThread.wait_for(lock_check , std::chrono::milliseconds(100), [this]() -> bool {
-    return (!queuedJobs.empty());
+    return (nQueuedJobs > 0);
   }));
 
   forceCancelWait = false;
@@ -65,30 +113,12 @@ void cthreadpool::ForceCancelThreadWait()
 
 size_t cthreadpool::threadswaiting()
 {
-  size_t n_waiting = 0;
-  for (const auto & t : threadInUse)
-  {
-    if (!t)
-    {
-      n_waiting++;
-    }
-  }
-
-  return n_waiting;
+  return nThreads - std::min(nThreadsInUse.load(), nThreads);
 }
 
 size_t cthreadpool::threadsinuse()
 {
-  size_t n_used = 0;
-  for (const auto & t : threadInUse)
-  {
-    if (t)
-    {
-      n_used++;
-    }
-  }
-
-  return n_used;
+  return nThreadsInUse;
 }
 
 size_t cthreadpool::numberofthreads() const
@@ -98,40 +128,87 @@ size_t cthreadpool::numberofthreads() const
 
 [[nodiscard]] size_t cthreadpool::numberofjobs() const
 {
-  return queuedJobs.size();
+  return static_cast<size_t>(std::max(nQueuedJobs.load(), static_cast<std::ptrdiff_t>(0)));
 }
 
-void cthreadpool::threadpooltask(size_t thread_index)
+size_t cthreadpool::numberofnodes() const
 {
-  std::function<void()> job;
+  return nNodes;
+}
 
-  while(running)
+size_t cthreadpool::currentnode()
+{
+  return worker_node;
+}
+
+bool cthreadpool::takejob(size_t node, ctask & job)
+{
+  // jobs of the own node and for any node by priority, then the jobs left for the other nodes
+  for (size_t steal=0; steal<2; steal++)
   {
+    for (size_t p=n_priorities; p>0; p--)
     {
-      std::lock_guard<std::recursive_mutex> lock(qrmutex);
-      if (!queuedJobs.empty())
+      auto & priority_queues = queuedJobs[p - 1];
+      for (size_t q=0; q<priority_queues.size(); q++)
       {
-        job = queuedJobs.front();
-        queuedJobs.pop();
-        threadInUse[thread_index] = true;
-
-        if (!queuedJobs.empty())
+        const bool own_queue = (q == 0) || (q == (node + 1));
+        if ((own_queue == (steal == 0)) && priority_queues[q]->trypop(job))
         {
-          cvJobAvailable.notify_all();
+          nQueuedJobs.fetch_sub(1);
+          return true;
         }
       }
     }
+  }
+
+  return false;
+}
 
-    if (job)
+void cthreadpool::threadpooltask(size_t thread_index)
+{
+  ctask job;
+  const auto & topology = cputopology::current();
+
+  switch (poolOptions.threadplacement)
+  {
+    case placement::cores:
+      cjthread::setcurrentaffinity({topology.cpus()[thread_index % topology.cpus().size()]});
+      break;
+    case placement::numa:
+      worker_node = threadNode[thread_index];
+      cjthread::setcurrentaffinity(topology.cpusofnode(worker_node));
+      break;
+    default:
+      break;
+  }
+
+  if (poolOptions.threadpriority != cjthread::priority::normal)
+  {
+    cjthread::setcurrentpriority(poolOptions.threadpriority);
+  }
+
+  while (true)
+  {
+    // running is checked after the signal is read, the destructor clears it before it changes the signal so a
+    // worker never sleeps on a signal that changed for the last time
+    const uint32_t signal = jobSignal.load();
+    if (!running)
     {
+      break;
+    }
+
+    if (takejob(threadNode[thread_index], job))
+    {
+      nThreadsInUse++;
       cvCheckForFreeThread.notify_all();
       job();
-      job = nullptr;
-      threadInUse[thread_index] = false;
+      job.reset();
+      nThreadsInUse--;
+      continue;
     }
 
-    std::unique_lock<std::mutex> job_lock(jobmutex);
-    cvJobAvailable.wait_for(job_lock, std::chrono::milliseconds(wait_time_ms), [this]() {return !queuedJobs.empty();});
-
+    nSleepingThreads++;
+    jobSignal.wait(signal);
+    nSleepingThreads--;
   }
 }
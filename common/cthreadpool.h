@@ -2,23 +2,61 @@
 
 #include <vector>
 #include <string>
-#include <queue>
+#include <memory>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
 #include <condition_variable>
+#include "cjobqueue.h"
 #include "cjthread.h"
 #include "cthread.h"
+#include "ctask.h"
 
 class cthreadpool
 {
   public:
+    enum class placement : uint8_t
+    {
+      none, // left to the os scheduler
+      cores, // worker i is pinned to the i-th cpu the process may run on
+      numa // workers are spread round robin over the numa nodes and may run on any cpu of their node
+    };
+
+    struct options
+    {
+      placement threadplacement = placement::none;
+      cjthread::priority threadpriority = cjthread::priority::normal;
+    };
+
+    // queued jobs are taken interactive first, then normal, then background
+    using jobpriority = cjthread::priority;
+    static constexpr size_t any_node = static_cast<size_t>(-1);
+
     cthreadpool() = delete;
     explicit cthreadpool(size_t n_threads);
     explicit cthreadpool(const size_t && n_threads, const std::string && t_pool_name);
     explicit cthreadpool(size_t n_threads, const std::string & t_pool_name);
+    explicit cthreadpool(size_t n_threads, const std::string & t_pool_name, const options & pool_options);
     ~cthreadpool();
 
-    void addjob(const std::function<void()>& job);
-    void addjob(std::function<void()>&& job) noexcept;
+    // jobs are move only tasks, small lambdas are stored without an allocation. a job for a numa node is taken by the
+    // workers of that node first, the others only take it when they have nothing else to do. memory the job
+    // allocates and writes first is then placed on that node by the os
+    void addjob(ctask && job, jobpriority priority = jobpriority::normal, size_t numa_node = any_node) noexcept;
+
+    // queues count jobs made by make_job(i) and wakes the workers once
+    template<typename job_maker>
+    void addjobs(size_t count, const job_maker & make_job, jobpriority priority = jobpriority::normal, size_t numa_node = any_node)
+    {
+      auto & queue = jobqueue(priority, numa_node);
+      for (size_t i=0; i<count; i++)
+      {
+        queue.push(ctask(make_job(i)));
+      }
+
+      signaljobs(count);
+    }
+
     void waitforthread();
     void ForceCancelThreadWait();
 
@@ -26,20 +64,33 @@ class cthreadpool
     [[nodiscard]] size_t threadsinuse();
     [[nodiscard]] size_t numberofthreads() const;
     [[nodiscard]] size_t numberofjobs() const;
+    [[nodiscard]] size_t numberofnodes() const;
+
+    // numa node of the worker running the calling thread, any_node outside of a numa placed pool
+    [[nodiscard]] static size_t currentnode();
 
   private:
+    static constexpr size_t n_priorities = 3;
+
     void threadpooltask(size_t thread_index);
+    bool takejob(size_t node, ctask & job);
+    cjobqueue & jobqueue(jobpriority priority, size_t numa_node);
+    void signaljobs(size_t count);
 
     std::vector<cjthread> threads;
-    std::vector<bool> threadInUse;
-    std::queue<std::function<void()>> queuedJobs;
-    std::recursive_mutex qrmutex;
-    std::mutex jobmutex;
+    std::vector<size_t> threadNode;
+    // per priority: queue 0 has the jobs for any node, queue n + 1 the jobs for node n
+    std::vector<std::unique_ptr<cjobqueue>> queuedJobs[n_priorities];
+    std::atomic<std::ptrdiff_t> nQueuedJobs = 0; // may be off by the jobs being pushed or taken right now
+    std::atomic<size_t> nThreadsInUse = 0;
+    std::atomic<uint32_t> jobSignal = 0; // changed on every push so idle workers can wait on it (a futex word)
+    std::atomic<size_t> nSleepingThreads = 0; // pushes skip the wake up call while every worker is busy
+    options poolOptions;
+    size_t nNodes = 1;
     std::mutex checkmutex;
-    std::condition_variable cvJobAvailable;
     std::condition_variable cvCheckForFreeThread;
     std::string name = "tp";
     size_t nThreads = 0;
-    bool running = true;
+    std::atomic<bool> running = true;
     bool forceCancelWait = false;
 };
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cjobqueue.h"
+#include "cthreadpool.h"
+#include "testcheck.h"
+
+namespace {
+  constexpr size_t n_producers = 4;
+  constexpr size_t n_workers = 8;
+
+  bool wait_until(const std::atomic<size_t> & value, size_t expected)
+  {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (value.load() != expected)
+    {
+      if (std::chrono::steady_clock::now() > deadline)
+      {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+
+  void test_queue_multi_producer()
+  {
+    // a small ring so most of the pushes go to the overflow list, every value has to come out exactly once
+    constexpr size_t n_per_producer = 20000;
+    cjobqueue queue (16);
+    std::vector<std::atomic<uint8_t>> seen (n_producers * n_per_producer);
+    std::atomic<size_t> n_popped = 0;
+    std::atomic<bool> producing = true;
+
+    std::vector<std::jthread> consumers;
+    for (size_t c=0; c<2; c++)
+    {
+      consumers.emplace_back([&]() {
+        ctask task;
+        while (producing || (n_popped < seen.size()))
+        {
+          if (queue.trypop(task))
+          {
+            task();
+            task.reset();
+            n_popped++;
+          }
+        }
+      });
+    }
+
+    {
+      std::vector<std::jthread> producers;
+      for (size_t p=0; p<n_producers; p++)
+      {
+        producers.emplace_back([&queue, &seen, p]() {
+          for (size_t i=0; i<n_per_producer; i++)
+          {
+            queue.push([&seen, value = (p * n_per_producer) + i]() { seen[value]++; });
+          }
+        });
+      }
+    }
+
+    producing = false;
+    consumers.clear();
+
+    size_t n_once = 0;
+    for (const auto & count : seen)
+    {
+      n_once += (count == 1) ? 1 : 0;
+    }
+
+    testcheck::check(n_popped == seen.size(), "queue: every pushed task is popped");
+    testcheck::check(n_once == seen.size(), "queue: every task runs exactly once");
+  }
+
+  void test_pool_multi_producer()
+  {
+    constexpr size_t n_per_producer = 5000;
+    cthreadpool pool (n_workers, "test");
+    std::atomic<size_t> n_done = 0;
+    std::atomic<size_t> sum = 0;
+
+    {
+      std::vector<std::jthread> producers;
+      for (size_t p=0; p<n_producers; p++)
+      {
+        producers.emplace_back([&, p]() {
+          const auto priority = static_cast<cthreadpool::jobpriority>(p % 3);
+          for (size_t i=0; i<n_per_producer; i+=10)
+          {
+            pool.addjobs(10, [&, i](size_t j) {
+              return [&, value = i + j]() {
+                sum += value;
+                n_done++;
+              };
+            }, priority);
+          }
+        });
+      }
+    }
+
+    const size_t n_jobs = n_producers * n_per_producer;
+    testcheck::check(wait_until(n_done, n_jobs), "pool: every job of the producers runs");
+    testcheck::check(sum == (n_producers * ((n_per_producer * (n_per_producer - 1)) / 2)), "pool: every job runs once");
+  }
+
+  void test_pool_destroy_under_load()
+  {
+    // jobs still queued when the pool goes away are dropped, the running ones finish before the destructor returns
+    for (size_t round=0; round<50; round++)
+    {
+      auto n_running = std::make_shared<std::atomic<size_t>>(0);
+      auto pool = std::make_unique<cthreadpool>(n_workers, "test");
+
+      std::vector<std::jthread> producers;
+      for (size_t p=0; p<n_producers; p++)
+      {
+        producers.emplace_back([&pool, n_running]() {
+          for (size_t i=0; i<200; i++)
+          {
+            pool->addjob([n_running]() {
+              (*n_running)++;
+              std::this_thread::sleep_for(std::chrono::microseconds(20));
+              (*n_running)--;
+            });
+          }
+        });
+      }
+
+      producers.clear();
+      pool.reset();
+      testcheck::check(*n_running == 0, "pool: no job runs after the destructor");
+    }
+  }
+}
+
+int main()
+{
+  test_queue_multi_producer();
+  test_pool_multi_producer();
+  test_pool_destroy_under_load();
+  return testcheck::result();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+// checks of the behaviour tests (the *_test.cpp files next to the sources). a test is a program that runs its
+// checks and returns result(), ctest counts a non zero exit code as a failure
+namespace testcheck
+{
+  inline size_t n_checks = 0;
+  inline size_t n_failures = 0;
+
+  inline bool check(bool condition, const std::string & what)
+  {
+    n_checks++;
+    if (!condition)
+    {
+      n_failures++;
+      std::fprintf(stderr, "failed: %s\n", what.c_str());
+    }
+
+    return condition;
+  }
+
+  // rgba frame of smooth gradients with a blue green cast and some noise, close enough to an underwater image for
+  // every stage to do some work
+  inline std::vector<uint8_t> synthetic_frame(uint32_t image_width, uint32_t image_height, uint32_t seed = 1)
+  {
+    std::vector<uint8_t> pixels (static_cast<size_t>(image_width) * image_height * 4);
+    uint32_t state = seed;
+    for (size_t i=0; i<image_height; i++)
+    {
+      for (size_t j=0; j<image_width; j++)
+      {
+        state = (state * 1664525u) + 1013904223u;
+        const double noise = static_cast<double>(state >> 28);
+        uint8_t * pixel = pixels.data() + (((i * image_width) + j) * 4);
+        pixel[0] = static_cast<uint8_t>(std::clamp(40.0 + (60.0 * std::sin(static_cast<double>(j) * 0.05)) + noise, 0.0, 255.0));
+        pixel[1] = static_cast<uint8_t>(std::clamp(120.0 + (50.0 * std::cos(static_cast<double>(i) * 0.03)) + noise, 0.0, 255.0));
+        pixel[2] = static_cast<uint8_t>(std::clamp(150.0 + (40.0 * std::sin(static_cast<double>(i + j) * 0.02)) + noise, 0.0, 255.0));
+        pixel[3] = 255;
+      }
+    }
+
+    return pixels;
+  }
+
+  // largest difference of two 8-bit images, the largest size_t when their sizes differ
+  inline size_t max_difference(const uint8_t * a, size_t a_size, const uint8_t * b, size_t b_size)
+  {
+    if (a_size != b_size)
+    {
+      return std::numeric_limits<size_t>::max();
+    }
+
+    size_t difference = 0;
+    for (size_t i=0; i<a_size; i++)
+    {
+      difference = std::max(difference, static_cast<size_t>(std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i]))));
+    }
+
+    return difference;
+  }
+
+  inline size_t max_difference(const std::vector<uint8_t> & a, const std::vector<uint8_t> & b)
+  {
+    return max_difference(a.data(), a.size(), b.data(), b.size());
+  }
+
+  inline int result()
+  {
+    std::fprintf(stderr, "%zu of %zu checks failed\n", n_failures, n_checks);
+    return (n_failures == 0) ? 0 : 1;
+  }
+}
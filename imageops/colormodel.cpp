@@ -1,5 +1,8 @@
 #include "colormodel.h"
+#include "parallel.h"
 #include <cmath>
+#include <array>
+#include <limits>
 #include <algorithm>
 #include <numbers>
 
@@ -176,9 +179,10 @@ namespace colormodel
       var_b *= 12.92;
     }
 
-    auto r = static_cast<uint8_t>(var_r * 255.0);
-    auto g = static_cast<uint8_t>(var_g * 255.0);
-    auto b = static_cast<uint8_t>(var_b * 255.0);
+    // out of gamut colors are clamped, converting an out of range double to uint8_t wraps around
+    auto r = static_cast<uint8_t>(std::clamp(var_r * 255.0, 0.0, 255.0));
+    auto g = static_cast<uint8_t>(std::clamp(var_g * 255.0, 0.0, 255.0));
+    auto b = static_cast<uint8_t>(std::clamp(var_b * 255.0, 0.0, 255.0));
 
     return {r, g, b};
   }
@@ -395,7 +399,7 @@ namespace colormodel
     std::vector<float> cie_lab(image_width * image_height * 4, 100.0f);
     for(size_t i=0; i<image_height; i++)
     {
-      for (int j = 0; j < image_width; ++j)
+      for (uint32_t j = 0; j < image_width; ++j)
       {
         auto red_value = input_image[(j * 4) + (i * image_width * 4) + 0];
         auto green_value = input_image[(j * 4) + (i * image_width * 4) + 1];
@@ -411,25 +415,157 @@ namespace colormodel
     return cie_lab;
   }
 
+  void cielab_statistics::add(const cielab_statistics & other)
+  {
+    if (count == 0)
+    {
+      *this = other;
+      return;
+    }
+
+    if (other.count == 0)
+    {
+      return;
+    }
+
+    const double delta = (other.l_sum / static_cast<double>(other.count)) - (l_sum / static_cast<double>(count));
+    const auto n = static_cast<double>(count + other.count);
+    l_m2 += other.l_m2 + ((delta * delta) * ((static_cast<double>(count) * static_cast<double>(other.count)) / n));
+    count += other.count;
+    l_sum += other.l_sum;
+    l_min = std::min(l_min, other.l_min);
+    l_max = std::max(l_max, other.l_max);
+    a_sum += other.a_sum;
+    b_sum += other.b_sum;
+    a_max = std::max(a_max, other.a_max);
+    b_max = std::max(b_max, other.b_max);
+  }
+
+  float cielab_statistics::l_mean() const
+  {
+    return (count > 0) ? static_cast<float>(l_sum / static_cast<double>(count)) : 0.0f;
+  }
+
+  float cielab_statistics::l_variance() const
+  {
+    if (count == 0)
+    {
+      return 0.0f;
+    }
+
+    return static_cast<float>(l_m2 / static_cast<double>(count));
+  }
+
+  float cielab_statistics::a_mean() const
+  {
+    return (count > 0) ? static_cast<float>(a_sum / static_cast<double>(count)) : 0.0f;
+  }
+
+  float cielab_statistics::b_mean() const
+  {
+    return (count > 0) ? static_cast<float>(b_sum / static_cast<double>(count)) : 0.0f;
+  }
+
+  std::vector<std::vector<float>> convert_image_rgb_to_planar_cielab(const uint8_t * input_image, uint32_t image_width, uint32_t image_height, cielab_statistics & stats)
+  {
+    // the srgb linearisation only has 256 inputs, same arithmetic as rgb2xyz so the results are identical
+    std::array<double, 256> linear;
+    for (size_t v=0; v<linear.size(); v++)
+    {
+      double norm = static_cast<double>(v) / 255.0;
+      norm = (norm > 0.04045) ? std::pow((norm + 0.055) / 1.055, 2.4) : (norm / 12.92);
+      linear[v] = norm * 100.0;
+    }
+
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<std::vector<float>> cie_lab(3, std::vector<float>(image_size));
+
+    // statistics per row are reduced in row order afterwards so the result does not depend on the threads
+    std::vector<cielab_statistics> row_stats(image_height);
+
+    imageops::parallel_for(0, image_height, 8, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        cielab_statistics & row = row_stats[i];
+        row.l_min = std::numeric_limits<float>::max();
+        row.l_max = std::numeric_limits<float>::lowest();
+        row.a_max = std::numeric_limits<float>::lowest();
+        row.b_max = std::numeric_limits<float>::lowest();
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t index = j + (i * image_width);
+          const double r_norm = linear[input_image[(index * 4) + 0]];
+          const double g_norm = linear[input_image[(index * 4) + 1]];
+          const double b_norm = linear[input_image[(index * 4) + 2]];
+
+          double x = (r_norm * 0.4124) + (g_norm * 0.3576) + (b_norm * 0.1805);
+          double y = (r_norm * 0.2126) + (g_norm * 0.7152) + (b_norm * 0.0722);
+          double z = (r_norm * 0.0193) + (g_norm * 0.1192) + (b_norm * 0.9505);
+          auto [cie_l, cie_a, cie_b] = xyz2cielab(x, y, z);
+
+          const auto l_value = static_cast<float>(cie_l);
+          const auto a_value = static_cast<float>(cie_a);
+          const auto b_value = static_cast<float>(cie_b);
+          cie_lab[0][index] = l_value;
+          cie_lab[1][index] = a_value;
+          cie_lab[2][index] = b_value;
+
+          row.l_sum += l_value;
+          row.l_min = std::min(row.l_min, l_value);
+          row.l_max = std::max(row.l_max, l_value);
+          row.a_sum += a_value;
+          row.b_sum += b_value;
+          row.a_max = std::max(row.a_max, a_value);
+          row.b_max = std::max(row.b_max, b_value);
+        }
+
+        // second pass over the stored row, the deviations are taken from the row mean
+        const double row_mean = row.l_sum / static_cast<double>(image_width);
+        const float * row_l = cie_lab[0].data() + (i * image_width);
+        for (size_t j=0; j<image_width; j++)
+        {
+          const double deviation = row_l[j] - row_mean;
+          row.l_m2 += deviation * deviation;
+        }
+
+        row.count = image_width;
+      }
+    });
+
+    stats = {};
+    for (const auto & row : row_stats)
+    {
+      stats.add(row);
+    }
+
+    return cie_lab;
+  }
+
   std::vector<uint8_t> convert_image_cielab_to_rgb(std::vector<float> input_image, uint32_t image_width, uint32_t image_height)
   {
-    std::vector<uint8_t> rgba(image_width * image_height * 4, 255);
+    std::vector<uint8_t> rgba(image_width * image_height * 4);
+    convert_image_cielab_to_rgb(input_image, image_width, image_height, rgba);
+    return rgba;
+  }
+
+  void convert_image_cielab_to_rgb(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, std::span<uint8_t> output)
+  {
     for(size_t i=0; i<image_height; i++)
     {
-      for (int j = 0; j < image_width; ++j)
+      for (uint32_t j = 0; j < image_width; ++j)
       {
         auto cie_l_value = input_image[(j * 4) + (i * image_width * 4) + 0];
         auto cie_a_value = input_image[(j * 4) + (i * image_width * 4) + 1];
         auto cie_b_value = input_image[(j * 4) + (i * image_width * 4) + 2];
         auto [r, g, b] = cielab2rgb(cie_l_value, cie_a_value, cie_b_value);
 
-        rgba[(j * 4) + (i * image_width * 4) + 0] = r;
-        rgba[(j * 4) + (i * image_width * 4) + 1] = g;
-        rgba[(j * 4) + (i * image_width * 4) + 2] = b;
+        output[(j * 4) + (i * image_width * 4) + 0] = r;
+        output[(j * 4) + (i * image_width * 4) + 1] = g;
+        output[(j * 4) + (i * image_width * 4) + 2] = b;
+        output[(j * 4) + (i * image_width * 4) + 3] = 255;
       }
     }
-
-    return rgba;
   }
 
 }
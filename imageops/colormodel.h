@@ -1,11 +1,34 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <tuple>
 #include <vector>
 
 namespace colormodel
 {
+  // full frame statistics gathered while converting to cie-lab
+  struct cielab_statistics
+  {
+    size_t count = 0;
+    double l_sum = 0.0;
+    double l_m2 = 0.0; // sum of squared deviations from l_mean
+    float l_min = 0.0f;
+    float l_max = 0.0f;
+    double a_sum = 0.0;
+    double b_sum = 0.0;
+    float a_max = 0.0f;
+    float b_max = 0.0f;
+
+    void add(const cielab_statistics & other); // statistics of both parts, other follows this one (chan et al. update for l_m2)
+
+    [[nodiscard]] float l_mean() const;
+    [[nodiscard]] float l_variance() const;
+    [[nodiscard]] float a_mean() const;
+    [[nodiscard]] float b_mean() const;
+  };
+
   std::tuple<double , double, double> rgb2hsi(const uint8_t & r, const uint8_t & g, const uint8_t & b);
   std::tuple<double , double, double> rgb2hsl(const uint8_t & r, const uint8_t & g, const uint8_t & b);
   std::tuple<double , double, double> rgb2xyz(const uint8_t & r, const uint8_t & g, const uint8_t & b);
@@ -18,5 +41,9 @@ namespace colormodel
   std::tuple<uint8_t , uint8_t, uint8_t> hsl2rgb(const double & h, const double & s, const double & l);
 
   std::vector<float> convert_image_rgb_to_cielab(std::vector<uint8_t> input_image, uint32_t image_width, uint32_t image_height);
+  // rgba to planar L, a and b channels, the statistics are accumulated in the same pass
+  std::vector<std::vector<float>> convert_image_rgb_to_planar_cielab(const uint8_t * input_image, uint32_t image_width, uint32_t image_height, cielab_statistics & stats);
   std::vector<uint8_t> convert_image_cielab_to_rgb(std::vector<float> input_image, uint32_t image_width, uint32_t image_height);
+  // writes the rgba pixels into output, which holds image_width * image_height * 4 bytes
+  void convert_image_cielab_to_rgb(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, std::span<uint8_t> output);
 }
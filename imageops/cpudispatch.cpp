@@ -0,0 +1,242 @@
+#include "cpudispatch.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// every level has to give the same floats, so no level may fuse a multiply and an add (avx-512 implies fma)
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_DISPATCH_AVAILABLE 1
+#else
+#define CPU_DISPATCH_AVAILABLE 0
+#endif
+
+namespace {
+
+  struct kernel_table
+  {
+    void (*unsharp_mask)(const uint8_t *, uint32_t, uint32_t, float, float *);
+    void (*deinterleave)(const uint8_t *, size_t, uint32_t, uint8_t * const *);
+    void (*deinterleave_to_float)(const uint8_t *, size_t, uint32_t, float * const *);
+    void (*deinterleave_float)(const float *, size_t, uint32_t, float * const *);
+    void (*interleave)(const uint8_t * const *, size_t, uint32_t, uint8_t *);
+    void (*interleave_float)(const float * const *, size_t, uint32_t, float *);
+    void (*broadcast_gray)(const uint8_t *, size_t, uint32_t, uint8_t *);
+    uint8_t (*min_value)(const uint8_t *, size_t);
+    uint8_t (*max_value)(const uint8_t *, size_t);
+    void (*add)(const float *, const float *, float *, size_t);
+    void (*subtract)(const float *, const float *, float *, size_t);
+    void (*multiply)(const float *, const float *, float *, size_t);
+    void (*scale)(const float *, float, float *, size_t);
+  };
+}
+
+namespace generic_kernels {
+#define KERNEL_TARGET
+#include "simdkernels.h"
+#undef KERNEL_TARGET
+}
+
+#if CPU_DISPATCH_AVAILABLE
+namespace sse2_kernels {
+#define KERNEL_TARGET __attribute__((target("sse2")))
+#include "simdkernels.h"
+#undef KERNEL_TARGET
+}
+
+namespace avx2_kernels {
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#include "simdkernels.h"
+#undef KERNEL_TARGET
+}
+
+namespace avx512_kernels {
+#define KERNEL_TARGET __attribute__((target("avx512f,avx512bw")))
+#include "simdkernels.h"
+#undef KERNEL_TARGET
+}
+#endif
+
+namespace {
+
+  imageops::cpu_level detect_cpu_level()
+  {
+#if CPU_DISPATCH_AVAILABLE
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+      return imageops::cpu_level::avx512;
+    }
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return imageops::cpu_level::avx2;
+    }
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+      return imageops::cpu_level::sse2;
+    }
+#endif
+
+    return imageops::cpu_level::generic;
+  }
+
+  const kernel_table & level_table(imageops::cpu_level level)
+  {
+#if CPU_DISPATCH_AVAILABLE
+    switch (level)
+    {
+      case imageops::cpu_level::avx512:
+        return avx512_kernels::table;
+      case imageops::cpu_level::avx2:
+        return avx2_kernels::table;
+      case imageops::cpu_level::sse2:
+        return sse2_kernels::table;
+      default:
+        break;
+    }
+#endif
+
+    return generic_kernels::table;
+  }
+
+  std::atomic<imageops::cpu_level> & current_level()
+  {
+    static std::atomic<imageops::cpu_level> level = imageops::detected_cpu_level();
+    return level;
+  }
+
+  const kernel_table & active_table()
+  {
+    return level_table(current_level().load(std::memory_order_relaxed));
+  }
+}
+
+namespace imageops {
+
+  cpu_level detected_cpu_level()
+  {
+    static const cpu_level detected = detect_cpu_level();
+    return detected;
+  }
+
+  cpu_level active_cpu_level()
+  {
+    return current_level().load(std::memory_order_relaxed);
+  }
+
+  cpu_level set_cpu_level(cpu_level level)
+  {
+    const cpu_level used_level = std::min(level, detected_cpu_level());
+    current_level().store(used_level, std::memory_order_relaxed);
+    return used_level;
+  }
+
+  std::string_view cpu_level_name(cpu_level level)
+  {
+    switch (level)
+    {
+      case cpu_level::sse2:
+        return "sse2";
+      case cpu_level::avx2:
+        return "avx2";
+      case cpu_level::avx512:
+        return "avx512";
+      default:
+        return "generic";
+    }
+  }
+
+  bool cpu_level_from_name(std::string_view name, cpu_level & level)
+  {
+    for (const auto candidate : {cpu_level::generic, cpu_level::sse2, cpu_level::avx2, cpu_level::avx512})
+    {
+      if (name == cpu_level_name(candidate))
+      {
+        level = candidate;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  namespace kernels {
+
+    void unsharp_mask(const uint8_t * input, uint32_t image_width, uint32_t image_height, float unsharp_const, float * output)
+    {
+      active_table().unsharp_mask(input, image_width, image_height, unsharp_const, output);
+    }
+
+    void deinterleave(const uint8_t * image, size_t pixel_count, uint32_t bpp, uint8_t * const * channels)
+    {
+      active_table().deinterleave(image, pixel_count, bpp, channels);
+    }
+
+    void deinterleave_to_float(const uint8_t * image, size_t pixel_count, uint32_t bpp, float * const * channels)
+    {
+      active_table().deinterleave_to_float(image, pixel_count, bpp, channels);
+    }
+
+    void deinterleave_float(const float * image, size_t pixel_count, uint32_t bpp, float * const * channels)
+    {
+      active_table().deinterleave_float(image, pixel_count, bpp, channels);
+    }
+
+    void interleave(const uint8_t * const * channels, size_t pixel_count, uint32_t bpp, uint8_t * image)
+    {
+      active_table().interleave(channels, pixel_count, bpp, image);
+    }
+
+    void interleave_float(const float * const * channels, size_t pixel_count, uint32_t bpp, float * image)
+    {
+      active_table().interleave_float(channels, pixel_count, bpp, image);
+    }
+
+    void broadcast_gray(const uint8_t * gray, size_t pixel_count, uint32_t bpp, uint8_t * image)
+    {
+      active_table().broadcast_gray(gray, pixel_count, bpp, image);
+    }
+
+    uint8_t min_value(const uint8_t * values, size_t count)
+    {
+      return active_table().min_value(values, count);
+    }
+
+    uint8_t max_value(const uint8_t * values, size_t count)
+    {
+      return active_table().max_value(values, count);
+    }
+
+    void add(const float * a, const float * b, float * output, size_t count)
+    {
+      active_table().add(a, b, output, count);
+    }
+
+    void subtract(const float * a, const float * b, float * output, size_t count)
+    {
+      active_table().subtract(a, b, output, count);
+    }
+
+    void multiply(const float * a, const float * b, float * output, size_t count)
+    {
+      active_table().multiply(a, b, output, count);
+    }
+
+    void scale(const float * a, float scalar, float * output, size_t count)
+    {
+      active_table().scale(a, scalar, output, count);
+    }
+  }
+}
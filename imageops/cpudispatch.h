@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace imageops {
+
+  // instruction sets the hot kernels are compiled for. the best one the cpu supports is picked at startup, every
+  // level gives bit identical results (no fused multiply-add, same operation order)
+  enum class cpu_level : uint8_t
+  {
+    generic = 0, // plain c++, the only level on non-x86 or non gcc/clang builds
+    sse2,
+    avx2,
+    avx512 // avx-512 f and bw
+  };
+
+  [[nodiscard]] cpu_level detected_cpu_level();
+  [[nodiscard]] cpu_level active_cpu_level();
+  // forces a level for testing, levels the cpu does not support are lowered to the detected one. returns the level
+  // that is used from now on
+  cpu_level set_cpu_level(cpu_level level);
+
+  [[nodiscard]] std::string_view cpu_level_name(cpu_level level);
+  bool cpu_level_from_name(std::string_view name, cpu_level & level);
+
+  // kernels that run on the active level
+  namespace kernels {
+    // c * (input - 3x3 gaussian sum) with the edge handling of imageops::image_convolution
+    void unsharp_mask(const uint8_t * input, uint32_t image_width, uint32_t image_height, float unsharp_const, float * output);
+    // rgba <-> planar for 1 to 4 channels (bpp), the _to_float variant converts the bytes while splitting
+    void deinterleave(const uint8_t * image, size_t pixel_count, uint32_t bpp, uint8_t * const * channels);
+    void deinterleave_to_float(const uint8_t * image, size_t pixel_count, uint32_t bpp, float * const * channels);
+    void deinterleave_float(const float * image, size_t pixel_count, uint32_t bpp, float * const * channels);
+    void interleave(const uint8_t * const * channels, size_t pixel_count, uint32_t bpp, uint8_t * image);
+    void interleave_float(const float * const * channels, size_t pixel_count, uint32_t bpp, float * image);
+    // gray copied to the first bpp - 1 channels (2 to 4), the last channel is set to 255
+    void broadcast_gray(const uint8_t * gray, size_t pixel_count, uint32_t bpp, uint8_t * image);
+    uint8_t min_value(const uint8_t * values, size_t count);
+    uint8_t max_value(const uint8_t * values, size_t count);
+    void add(const float * a, const float * b, float * output, size_t count);
+    void subtract(const float * a, const float * b, float * output, size_t count);
+    void multiply(const float * a, const float * b, float * output, size_t count);
+    void scale(const float * a, float scalar, float * output, size_t count);
+  }
+}
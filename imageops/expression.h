@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// lazy element-wise plane arithmetic. planes, scalars and the operators below build an expression type and nothing
+// is computed until the expression is evaluated into a destination plane, so a chain such as
+//   evaluate<uint8_t>(clamp((plane(j) * t) + ((1.0f - t) * plane(i)) + plane(d), 0.0f, 255.0f), size)
+// is one loop and one allocation. every value is a float and the operators are applied in the order they are
+// written, the result is the same as the chain of element_* calls it replaces
+namespace imageops {
+
+  template <typename expression_type>
+  concept plane_expression = requires(const expression_type & e, size_t i)
+  {
+    typename expression_type::plane_expression_tag;
+    { e[i] } -> std::convertible_to<float>;
+  };
+
+  template <typename value_type>
+  struct plane_view
+  {
+    using plane_expression_tag = void;
+    const value_type * values;
+
+    float operator[](size_t i) const { return static_cast<float>(values[i]); }
+  };
+
+  struct scalar_value
+  {
+    using plane_expression_tag = void;
+    float value;
+
+    float operator[](size_t) const { return value; }
+  };
+
+  template <typename left_type, typename right_type, typename operation_type>
+  struct binary_expression
+  {
+    using plane_expression_tag = void;
+    left_type left;
+    right_type right;
+
+    float operator[](size_t i) const { return operation_type{}(left[i], right[i]); }
+  };
+
+  template <typename input_type>
+  struct clamp_expression
+  {
+    using plane_expression_tag = void;
+    input_type input;
+    float low;
+    float high;
+
+    float operator[](size_t i) const { return std::clamp(input[i], low, high); }
+  };
+
+  template <typename value_type>
+  plane_view<value_type> plane(const value_type * values) { return {values}; }
+
+  template <typename value_type>
+  plane_view<value_type> plane(const std::vector<value_type> & values) { return {values.data()}; }
+
+  // scalars on either side of an operator are wrapped so they can take part in the expression
+  template <typename operand_type>
+  auto as_expression(const operand_type & operand)
+  {
+    if constexpr (plane_expression<operand_type>)
+    {
+      return operand;
+    }
+    else
+    {
+      return scalar_value{static_cast<float>(operand)};
+    }
+  }
+
+  template <typename left_type, typename right_type>
+  concept expression_operands = (plane_expression<left_type> && (plane_expression<right_type> || std::is_arithmetic_v<right_type>))
+                             || (std::is_arithmetic_v<left_type> && plane_expression<right_type>);
+
+  template <typename operation_type, typename left_type, typename right_type>
+  auto make_binary(const left_type & left, const right_type & right)
+  {
+    using left_expression = decltype(as_expression(left));
+    using right_expression = decltype(as_expression(right));
+    return binary_expression<left_expression, right_expression, operation_type>{as_expression(left), as_expression(right)};
+  }
+
+  template <typename left_type, typename right_type> requires expression_operands<left_type, right_type>
+  auto operator+(const left_type & left, const right_type & right) { return make_binary<std::plus<float>>(left, right); }
+
+  template <typename left_type, typename right_type> requires expression_operands<left_type, right_type>
+  auto operator-(const left_type & left, const right_type & right) { return make_binary<std::minus<float>>(left, right); }
+
+  template <typename left_type, typename right_type> requires expression_operands<left_type, right_type>
+  auto operator*(const left_type & left, const right_type & right) { return make_binary<std::multiplies<float>>(left, right); }
+
+  template <typename left_type, typename right_type> requires expression_operands<left_type, right_type>
+  auto operator/(const left_type & left, const right_type & right) { return make_binary<std::divides<float>>(left, right); }
+
+  template <plane_expression input_type>
+  clamp_expression<input_type> clamp(const input_type & input, float low, float high) { return {input, low, high}; }
+
+  // the only place an expression is computed. the float result is converted with a plain cast, integer
+  // destinations should be clamped to their range first
+  template <typename value_type, plane_expression expression_type>
+  void assign(value_type * destination, const expression_type & e, size_t count)
+  {
+    for (size_t i=0; i<count; i++)
+    {
+      destination[i] = static_cast<value_type>(e[i]);
+    }
+  }
+
+  template <typename value_type, plane_expression expression_type>
+  std::vector<value_type> evaluate(const expression_type & e, size_t count)
+  {
+    std::vector<value_type> destination (count);
+    assign(destination.data(), e, count);
+    return destination;
+  }
+}
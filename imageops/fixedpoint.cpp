@@ -0,0 +1,538 @@
+#include "fixedpoint.h"
+
+#include "imagefilters.h"
+#include "imageops.h"
+#include "parallel.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+namespace {
+  constexpr int32_t linear_bits = 15; // linear rgb and the xyz ratios to the white point
+  constexpr int32_t linear_one = 1 << linear_bits;
+  constexpr int32_t matrix_bits = 16;
+  constexpr int32_t cube_root_size = linear_one + (linear_one / 16); // x of the white point ratio goes slightly above 1
+
+  int32_t to_fixed(double value, int32_t bits)
+  {
+    return static_cast<int32_t>(std::lround(value * static_cast<double>(1 << bits)));
+  }
+
+  // lookup tables and matrices of the integer cie-lab conversion, built once from the same formulas as colormodel
+  struct lab_tables
+  {
+    std::array<uint16_t, 256> linear; // srgb to linear, Q15
+    std::vector<uint16_t> cube_root; // lab f(t) of a Q15 t, Q15
+    std::vector<uint8_t> encode; // Q15 linear to srgb, truncated like colormodel::xyz2rgb
+    std::array<uint32_t, 9> rgb_to_xyz; // Q16, rows divided by the white point
+    std::array<int32_t, 9> xyz_to_rgb; // Q16, columns multiplied by the white point
+  };
+
+  const lab_tables & tables()
+  {
+    static const lab_tables lab = []() {
+      lab_tables t;
+
+      for (size_t v=0; v<t.linear.size(); v++)
+      {
+        double norm = static_cast<double>(v) / 255.0;
+        norm = (norm > 0.04045) ? std::pow((norm + 0.055) / 1.055, 2.4) : (norm / 12.92);
+        t.linear[v] = static_cast<uint16_t>(to_fixed(norm, linear_bits));
+      }
+
+      t.cube_root.resize(cube_root_size);
+      for (size_t v=0; v<t.cube_root.size(); v++)
+      {
+        const double ratio = static_cast<double>(v) / linear_one;
+        const double f = (ratio > 0.008856) ? std::cbrt(ratio) : ((ratio * 7.787) + (16.0 / 116.0));
+        t.cube_root[v] = static_cast<uint16_t>(to_fixed(f, linear_bits));
+      }
+
+      t.encode.resize(linear_one + 1);
+      for (size_t v=0; v<t.encode.size(); v++)
+      {
+        double value = static_cast<double>(v) / linear_one;
+        value = (value > 0.0031308) ? ((1.055 * std::pow(value, 1.0 / 2.4)) - 0.055) : (value * 12.92);
+        t.encode[v] = static_cast<uint8_t>(std::clamp(value * 255.0, 0.0, 255.0));
+      }
+
+      constexpr std::array<double, 3> white = {0.94416, 1.0, 1.20641};
+      constexpr std::array<double, 9> rgb_to_xyz = {0.4124, 0.3576, 0.1805, 0.2126, 0.7152, 0.0722, 0.0193, 0.1192, 0.9505};
+      constexpr std::array<double, 9> xyz_to_rgb = {3.2406, -1.5372, -0.4986, -0.9689, 1.8758, 0.0415, 0.0557, -0.2040, 1.0570};
+      for (size_t i=0; i<9; i++)
+      {
+        t.rgb_to_xyz[i] = static_cast<uint32_t>(to_fixed(rgb_to_xyz[i] / white[i / 3], matrix_bits));
+        t.xyz_to_rgb[i] = to_fixed(xyz_to_rgb[i] * white[i % 3], matrix_bits);
+      }
+
+      return t;
+    }();
+
+    return lab;
+  }
+
+  // lab f^-1 of a Q15 value, the cube is compared against the same threshold as colormodel::cielab2xyz
+  int64_t inverse_cube_root(int64_t f)
+  {
+    constexpr auto knee = static_cast<int64_t>(0.008856 * static_cast<double>(int64_t(1) << (3 * linear_bits)));
+    const int64_t cube = f * f * f;
+    if (cube > knee)
+    {
+      return cube >> (2 * linear_bits);
+    }
+
+    constexpr int64_t offset = (16 * linear_one + 58) / 116; // 16 / 116 rounded
+    constexpr int64_t inverse_slope = static_cast<int64_t>((65536.0 / 7.787) + 0.5);
+    return (((f - offset) * inverse_slope) + 32768) >> 16;
+  }
+
+  // number of pixels of the (2 * radius + 1) window around p, clipped to [0, size)
+  uint32_t window_length(size_t p, uint32_t radius, uint32_t size)
+  {
+    const size_t begin = (p > radius) ? (p - radius) : 0;
+    const size_t end = std::min(p + radius + 1, static_cast<size_t>(size));
+    return static_cast<uint32_t>(end - begin);
+  }
+
+  // exact sums of value(pixel) over the (2 * radius + 1) square window around every pixel, clipped to the image.
+  // separable running sums like imagefilters::box_mean_variance, integers do not drift so no double is needed
+  template <typename input_type, typename value_function>
+  std::vector<uint64_t> box_sum(const input_type * input_image, uint32_t image_width, uint32_t image_height, uint32_t radius, value_function && value)
+  {
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<uint64_t> row_sum(image_size);
+    std::vector<uint64_t> sum(image_size);
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const input_type * row = input_image + (i * image_width);
+        uint64_t s = 0;
+
+        for (size_t j=0; j<std::min(static_cast<size_t>(radius), static_cast<size_t>(image_width)); j++)
+        {
+          s += value(row[j]);
+        }
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          if ((j + radius) < image_width)
+          {
+            s += value(row[j + radius]);
+          }
+
+          if (j > radius)
+          {
+            s -= value(row[j - radius - 1]);
+          }
+
+          row_sum[j + (i * image_width)] = s;
+        }
+      }
+    });
+
+    imageops::parallel_for(0, image_width, 64, [&](size_t column_begin, size_t column_end) {
+      const size_t columns = column_end - column_begin;
+      std::vector<uint64_t> s(columns, 0);
+
+      for (size_t i=0; i<std::min(static_cast<size_t>(radius), static_cast<size_t>(image_height)); i++)
+      {
+        const uint64_t * add = row_sum.data() + (i * image_width) + column_begin;
+        for (size_t c=0; c<columns; c++)
+        {
+          s[c] += add[c];
+        }
+      }
+
+      for (size_t i=0; i<image_height; i++)
+      {
+        if ((i + radius) < image_height)
+        {
+          const uint64_t * add = row_sum.data() + ((i + radius) * image_width) + column_begin;
+          for (size_t c=0; c<columns; c++)
+          {
+            s[c] += add[c];
+          }
+        }
+
+        if (i > radius)
+        {
+          const uint64_t * remove = row_sum.data() + ((i - radius - 1) * image_width) + column_begin;
+          for (size_t c=0; c<columns; c++)
+          {
+            s[c] -= remove[c];
+          }
+        }
+
+        std::copy(s.begin(), s.end(), sum.begin() + (i * image_width) + column_begin);
+      }
+    });
+
+    return sum;
+  }
+
+  // gain of the local contrast stage with 12 fraction bits, the ratio is taken in double like the float path takes it
+  // in float (a zero variance gives beta)
+  int32_t contrast_gain(double variance, double global_variance, float beta)
+  {
+    const double ratio = global_variance / variance;
+    return to_fixed(std::min(ratio, static_cast<double>(beta)), 12);
+  }
+
+  // mean + gain * (value - mean) with the mean in Q4 and the gain in Q12, clamped to L = [0, 100]
+  uint16_t contrast_value(int32_t value, int32_t mean_q4, int32_t gain_q12)
+  {
+    const int64_t output = (static_cast<int64_t>(mean_q4) << 12) + (static_cast<int64_t>(gain_q12) * ((value << 4) - mean_q4));
+    return static_cast<uint16_t>(std::clamp<int64_t>((output + (1 << 15)) >> 16, 0, fixedpoint::lab_l_max));
+  }
+}
+
+namespace fixedpoint {
+
+  std::vector<uint8_t> compose_jaffe_mcglamey(const uint8_t * input_image, const uint8_t * redefined_image, const uint8_t * attenuation, uint32_t image_width, uint32_t image_height, float sharp_const, std::vector<std::vector<uint8_t>> & detail_maps)
+  {
+    // the 3x3 blur (1 2 1 / 2 4 2 / 1 2 1) is the exact integer sum, the float path divides it by 16. its window
+    // repeats the first row and column and drops the pixels past the last ones, same as imageops::image_convolution
+
+    constexpr size_t bpp = 4;
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    const int32_t sharp_q8 = to_fixed(sharp_const, 8);
+
+    std::vector<uint8_t> jm_model_image(image_size * bpp);
+    detail_maps.assign(3, std::vector<uint8_t>(image_size));
+
+    imageops::parallel_for(0, image_height, 8, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const uint8_t * above = input_image + ((i > 0 ? i - 1 : 0) * image_width * bpp);
+        const uint8_t * row = input_image + (i * image_width * bpp);
+        const uint8_t * below = ((i + 1) < image_height) ? (input_image + ((i + 1) * image_width * bpp)) : nullptr;
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t left = ((j > 0) ? (j - 1) : 0) * bpp;
+          const size_t centre = j * bpp;
+          const bool has_right = ((j + 1) < image_width);
+          const size_t right = (j + 1) * bpp;
+          const size_t index = j + (i * image_width);
+          const int32_t t = attenuation[index];
+
+          for (size_t c=0; c<3; c++)
+          {
+            auto horizontal = [&](const uint8_t * r) -> int32_t {
+              return r[left + c] + (2 * r[centre + c]) + (has_right ? r[right + c] : 0);
+            };
+
+            const int32_t blur_sum = horizontal(above) + (2 * horizontal(row)) + ((below != nullptr) ? horizontal(below) : 0);
+            const int32_t detail_q12 = sharp_q8 * ((16 * row[centre + c]) - blur_sum);
+            const int32_t model = (redefined_image[(index * bpp) + c] * t) + (row[centre + c] * (255 - t)); // times 255
+            const int32_t model_q12 = (model * 4096) / 255;
+
+            detail_maps[c][index] = static_cast<uint8_t>(std::clamp(detail_q12 >> 12, 0, 255));
+            jm_model_image[(index * bpp) + c] = static_cast<uint8_t>(std::clamp((model_q12 + detail_q12) >> 12, 0, 255));
+          }
+
+          jm_model_image[(index * bpp) + 3] = row[centre + 3];
+        }
+      }
+    });
+
+    return jm_model_image;
+  }
+
+  std::vector<std::vector<uint16_t>> convert_image_rgb_to_planar_lab(const uint8_t * input_image, uint32_t image_width, uint32_t image_height, colormodel::cielab_statistics & stats)
+  {
+    const lab_tables & lab = tables();
+    const auto & m = lab.rgb_to_xyz;
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<std::vector<uint16_t>> lab_planes(3, std::vector<uint16_t>(image_size));
+
+    // integer sums per row, reduced in row order afterwards
+    struct row_statistics
+    {
+      uint64_t l_sum = 0;
+      uint64_t l_squared_sum = 0;
+      int64_t a_sum = 0;
+      int64_t b_sum = 0;
+      int32_t l_min = std::numeric_limits<int32_t>::max();
+      int32_t l_max = std::numeric_limits<int32_t>::lowest();
+      int32_t a_max = std::numeric_limits<int32_t>::lowest();
+      int32_t b_max = std::numeric_limits<int32_t>::lowest();
+    };
+
+    std::vector<row_statistics> row_stats(image_height);
+
+    imageops::parallel_for(0, image_height, 8, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        row_statistics & row = row_stats[i];
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t index = j + (i * image_width);
+          const uint32_t r = lab.linear[input_image[(index * 4) + 0]];
+          const uint32_t g = lab.linear[input_image[(index * 4) + 1]];
+          const uint32_t b = lab.linear[input_image[(index * 4) + 2]];
+
+          // the coefficients are positive and every row sums to about one, so the Q31 products fit 32 unsigned bits
+          auto f = [&](size_t k) -> int32_t {
+            const uint32_t ratio = ((m[k] * r) + (m[k + 1] * g) + (m[k + 2] * b) + (1u << (matrix_bits - 1))) >> matrix_bits;
+            return lab.cube_root[std::min<uint32_t>(ratio, cube_root_size - 1)];
+          };
+
+          const int32_t fx = f(0);
+          const int32_t fy = f(3);
+          const int32_t fz = f(6);
+
+          // L = 116 * fy - 16, a = 500 * (fx - fy), b = 200 * (fy - fz) in plane units
+          constexpr auto l_gain = static_cast<int64_t>((116.0 * lab_l_scale * 65536.0 / linear_one) + 0.5);
+          constexpr auto l_offset = static_cast<int64_t>((16.0 * lab_l_scale * 65536.0) + 0.5);
+          const int32_t l_value = static_cast<int32_t>(std::clamp<int64_t>(((fy * l_gain) - l_offset + 32768) >> 16, 0, lab_l_max));
+          const int32_t a_value = std::clamp(((((fx - fy) * 125) + 64) >> 7) + lab_ab_zero, 0, 65535);
+          const int32_t b_value = std::clamp(((((fy - fz) * 25) + 32) >> 6) + lab_ab_zero, 0, 65535);
+
+          lab_planes[0][index] = static_cast<uint16_t>(l_value);
+          lab_planes[1][index] = static_cast<uint16_t>(a_value);
+          lab_planes[2][index] = static_cast<uint16_t>(b_value);
+
+          row.l_sum += l_value;
+          row.l_squared_sum += static_cast<uint64_t>(l_value) * l_value;
+          row.l_min = std::min(row.l_min, l_value);
+          row.l_max = std::max(row.l_max, l_value);
+          row.a_sum += a_value - lab_ab_zero;
+          row.b_sum += b_value - lab_ab_zero;
+          row.a_max = std::max(row.a_max, a_value);
+          row.b_max = std::max(row.b_max, b_value);
+        }
+      }
+    });
+
+    row_statistics total;
+    for (const auto & row : row_stats)
+    {
+      total.l_sum += row.l_sum;
+      total.l_squared_sum += row.l_squared_sum;
+      total.a_sum += row.a_sum;
+      total.b_sum += row.b_sum;
+      total.l_min = std::min(total.l_min, row.l_min);
+      total.l_max = std::max(total.l_max, row.l_max);
+      total.a_max = std::max(total.a_max, row.a_max);
+      total.b_max = std::max(total.b_max, row.b_max);
+    }
+
+    const double l_scale = lab_l_scale;
+    stats = {};
+    stats.count = image_size;
+    stats.l_sum = static_cast<double>(total.l_sum) / l_scale;
+    stats.l_m2 = imageops::squared_deviation_sum(image_size, total.l_sum, total.l_squared_sum) / (l_scale * l_scale);
+    stats.l_min = static_cast<float>(total.l_min / l_scale);
+    stats.l_max = static_cast<float>(total.l_max / l_scale);
+    stats.a_sum = static_cast<double>(total.a_sum) / lab_one;
+    stats.b_sum = static_cast<double>(total.b_sum) / lab_one;
+    stats.a_max = static_cast<float>(total.a_max - lab_ab_zero) / lab_one;
+    stats.b_max = static_cast<float>(total.b_max - lab_ab_zero) / lab_one;
+
+    return lab_planes;
+  }
+
+  std::vector<uint8_t> convert_planar_lab_to_rgb(const uint16_t * l_channel, const uint16_t * a_channel, const uint16_t * b_channel, uint32_t image_width, uint32_t image_height, float a_balance, float b_balance)
+  {
+    std::vector<uint8_t> rgba(static_cast<size_t>(image_width) * image_height * 4);
+    convert_planar_lab_to_rgb(l_channel, a_channel, b_channel, image_width, image_height, a_balance, b_balance, rgba);
+    return rgba;
+  }
+
+  void convert_planar_lab_to_rgb(const uint16_t * l_channel, const uint16_t * a_channel, const uint16_t * b_channel, uint32_t image_width, uint32_t image_height, float a_balance, float b_balance, std::span<uint8_t> output)
+  {
+    const lab_tables & lab = tables();
+    const auto & m = lab.xyz_to_rgb;
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+
+    // fy = (L + 16) / 116, fx = fy + a / 500 and fz = fy - b / 200 in Q15. the balance is part of the a and b gains
+    // so the balanced values are not limited to the range of the planes
+    constexpr auto fy_gain = static_cast<int64_t>((linear_one * 65536.0 / (116.0 * lab_l_scale)) + 0.5);
+    constexpr auto fy_offset = static_cast<int64_t>((16.0 * linear_one * 65536.0 / 116.0) + 0.5);
+    const int64_t fx_gain = std::llround((linear_one * 65536.0 / (500.0 * lab_one)) * (1.0 + a_balance));
+    const int64_t fz_gain = std::llround((linear_one * 65536.0 / (200.0 * lab_one)) * (1.0 + b_balance));
+
+    imageops::parallel_for(0, image_size, 4096, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i<end; i++)
+      {
+        const int64_t fy = ((l_channel[i] * fy_gain) + fy_offset + 32768) >> 16;
+        const int64_t fx = fy + ((((a_channel[i] - lab_ab_zero) * fx_gain) + 32768) >> 16);
+        const int64_t fz = fy - ((((b_channel[i] - lab_ab_zero) * fz_gain) + 32768) >> 16);
+
+        const int64_t x = inverse_cube_root(fx);
+        const int64_t y = inverse_cube_root(fy);
+        const int64_t z = inverse_cube_root(fz);
+
+        for (size_t c=0; c<3; c++)
+        {
+          const int64_t linear = ((m[(c * 3) + 0] * x) + (m[(c * 3) + 1] * y) + (m[(c * 3) + 2] * z) + (1 << (matrix_bits - 1))) >> matrix_bits;
+          output[(i * 4) + c] = lab.encode[std::clamp<int64_t>(linear, 0, linear_one)];
+        }
+
+        output[(i * 4) + 3] = 255;
+      }
+    });
+  }
+
+  std::vector<float> l_channel_to_float(const std::vector<uint16_t> & channel)
+  {
+    std::vector<float> l_channel(channel.size());
+    std::transform(channel.begin(), channel.end(), l_channel.begin(), [](uint16_t value) {
+      return static_cast<float>(value) / lab_l_scale;
+    });
+
+    return l_channel;
+  }
+
+  std::vector<uint16_t> l_channel_from_float(const std::vector<float> & channel)
+  {
+    std::vector<uint16_t> l_channel(channel.size());
+    std::transform(channel.begin(), channel.end(), l_channel.begin(), [](float value) {
+      return static_cast<uint16_t>(std::clamp(std::lround(value * lab_l_scale), 0l, static_cast<long>(lab_l_max)));
+    });
+
+    return l_channel;
+  }
+
+  std::vector<uint16_t> local_contrast_blocks(const std::vector<uint16_t> & l_channel, uint32_t image_width, uint32_t image_height, uint32_t block_size, float global_variance, float beta)
+  {
+    block_size = std::max(block_size, 1u);
+    const uint32_t blocks_x = (image_width + block_size - 1) / block_size;
+    const uint32_t blocks_y = (image_height + block_size - 1) / block_size;
+    const double global_variance_q = static_cast<double>(global_variance) * lab_l_scale * lab_l_scale;
+    std::vector<uint16_t> enhance_l(l_channel.size());
+
+    imageops::parallel_for(0, blocks_y, 1, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const auto [y0, window_height] = imagefilters::block_window(i, block_size, image_height);
+
+        for (size_t j=0; j<blocks_x; j++)
+        {
+          const auto [x0, window_width] = imagefilters::block_window(j, block_size, image_width);
+
+          uint64_t sum = 0;
+          uint64_t squared_sum = 0;
+          for (size_t y=y0; y<(y0 + window_height); y++)
+          {
+            const uint16_t * row = l_channel.data() + (y * image_width);
+            for (size_t x=x0; x<(x0 + window_width); x++)
+            {
+              sum += row[x];
+              squared_sum += static_cast<uint32_t>(row[x]) * row[x];
+            }
+          }
+
+          // n^2 * variance is exact in 64 bits for blocks up to 65536 pixels of 14 bits
+          const uint64_t n = window_width * window_height;
+          const uint64_t spread = (squared_sum * n) - (sum * sum);
+          const auto mean_q4 = static_cast<int32_t>(((sum << 4) + (n / 2)) / n);
+          const int32_t gain_q12 = contrast_gain(static_cast<double>(spread) / static_cast<double>(n * n), global_variance_q, beta);
+
+          // the statistics window of the last block is moved back, the block it maps is clipped like block_filter
+          const size_t out_x0 = j * block_size;
+          const size_t out_y0 = i * block_size;
+          for (size_t y=out_y0; y<std::min(out_y0 + block_size, static_cast<size_t>(image_height)); y++)
+          {
+            for (size_t x=out_x0; x<std::min(out_x0 + block_size, static_cast<size_t>(image_width)); x++)
+            {
+              enhance_l[x + (y * image_width)] = contrast_value(l_channel[x + (y * image_width)], mean_q4, gain_q12);
+            }
+          }
+        }
+      }
+    });
+
+    return enhance_l;
+  }
+
+  std::vector<uint16_t> local_contrast_window(const std::vector<uint16_t> & l_channel, uint32_t image_width, uint32_t image_height, uint32_t radius, float global_variance, float beta)
+  {
+    const auto sum = box_sum(l_channel.data(), image_width, image_height, radius, [](uint64_t value) { return value; });
+    const auto squared_sum = box_sum(l_channel.data(), image_width, image_height, radius, [](uint64_t value) { return value * value; });
+    const double global_variance_q = static_cast<double>(global_variance) * lab_l_scale * lab_l_scale;
+    std::vector<uint16_t> enhance_l(l_channel.size());
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const uint32_t window_height = window_length(i, radius, image_height);
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t index = j + (i * image_width);
+          const uint64_t n = static_cast<uint64_t>(window_height) * window_length(j, radius, image_width);
+          const uint64_t spread = (squared_sum[index] * n) - (sum[index] * sum[index]);
+          const auto mean_q4 = static_cast<int32_t>(((sum[index] << 4) + (n / 2)) / n);
+          const int32_t gain_q12 = contrast_gain(static_cast<double>(spread) / static_cast<double>(n * n), global_variance_q, beta);
+          enhance_l[index] = contrast_value(l_channel[index], mean_q4, gain_q12);
+        }
+      }
+    });
+
+    return enhance_l;
+  }
+
+  std::vector<uint16_t> guided_detail_enhance(const std::vector<uint16_t> & l_channel, uint32_t image_width, uint32_t image_height, uint32_t radius, float eps, float k)
+  {
+    // q = mean(a) * I + mean(b) with a = var / (var + eps) in Q15 and b = (1 - a) * mean in Q2. the window sums are
+    // exact, the ratio a is taken in fp32 from them
+
+    const size_t image_size = l_channel.size();
+    const auto sum = box_sum(l_channel.data(), image_width, image_height, radius, [](uint64_t value) { return value; });
+    const auto squared_sum = box_sum(l_channel.data(), image_width, image_height, radius, [](uint64_t value) { return value * value; });
+    const float eps_q = eps * lab_l_scale * lab_l_scale;
+
+    std::vector<uint16_t> a(image_size);
+    std::vector<uint16_t> b(image_size);
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const uint32_t window_height = window_length(i, radius, image_height);
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t index = j + (i * image_width);
+          const uint64_t n = static_cast<uint64_t>(window_height) * window_length(j, radius, image_width);
+          const uint64_t spread = (squared_sum[index] * n) - (sum[index] * sum[index]);
+          const float variance = static_cast<float>(spread) / static_cast<float>(n * n);
+          const auto a_value = static_cast<uint32_t>(std::lround((variance / (variance + eps_q)) * linear_one));
+          const uint64_t mean_q2 = ((sum[index] << 2) + (n / 2)) / n;
+
+          a[index] = static_cast<uint16_t>(a_value);
+          b[index] = static_cast<uint16_t>((((linear_one - a_value) * mean_q2) + (linear_one / 2)) >> linear_bits);
+        }
+      }
+    });
+
+    const auto a_sum = box_sum(a.data(), image_width, image_height, radius, [](uint64_t value) { return value; });
+    const auto b_sum = box_sum(b.data(), image_width, image_height, radius, [](uint64_t value) { return value; });
+    const int32_t k_q8 = to_fixed(k, 8);
+    std::vector<uint16_t> enhance_l(image_size);
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const uint32_t window_height = window_length(i, radius, image_height);
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t index = j + (i * image_width);
+          const uint64_t n = static_cast<uint64_t>(window_height) * window_length(j, radius, image_width);
+          const auto mean_a = static_cast<int64_t>((a_sum[index] + (n / 2)) / n);
+          const auto mean_b = static_cast<int64_t>((b_sum[index] + (n / 2)) / n);
+
+          // base and output in Q2: base + k * (I - base)
+          const int64_t value_q2 = static_cast<int64_t>(l_channel[index]) << 2;
+          const int64_t base_q2 = ((mean_a * value_q2 + (linear_one / 2)) >> linear_bits) + mean_b;
+          const int64_t output_q2 = base_q2 + ((k_q8 * (value_q2 - base_q2) + 128) >> 8);
+          enhance_l[index] = static_cast<uint16_t>(std::clamp<int64_t>((output_q2 + 2) >> 2, 0, lab_l_max));
+        }
+      }
+    });
+
+    return enhance_l;
+  }
+}
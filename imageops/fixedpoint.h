@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "colormodel.h"
+
+// integer versions of the per pixel stages with 16-bit fixed-point intermediates. the cie-lab planes use the 8-bit
+// scaling of opencv (L * 255 / 100, a + 128, b + 128) with 6 fraction bits, so a plane holds 0..16320 for L and
+// 0..16383 for a and b. the stages themselves stay within 1 level of the float path, the output within 2 levels per
+// 8-bit channel for values from 64 up. below that the srgb curve is steep and the color balance gain multiplies the
+// a and b error, dark values of the lifted channel were seen up to 8 levels off (about 0.1% of the values)
+namespace fixedpoint {
+
+  constexpr int32_t lab_fraction_bits = 6;
+  constexpr int32_t lab_one = 1 << lab_fraction_bits;
+  constexpr int32_t lab_l_max = 255 * lab_one; // L = 100
+  constexpr int32_t lab_ab_zero = 128 * lab_one; // a = 0 and b = 0
+  constexpr float lab_l_scale = (255.0f * lab_one) / 100.0f; // L units to plane units
+
+  // unsharp mask and jaffe-mcglamey model in one pass: I_fc = D_c + J_c*t + I_c*(1 - t). the attenuation is the 8-bit
+  // map (t * 255), the sharp constant is applied with 8 fraction bits. the detail maps are the clamped masks per channel
+  std::vector<uint8_t> compose_jaffe_mcglamey(const uint8_t * input_image, const uint8_t * redefined_image, const uint8_t * attenuation, uint32_t image_width, uint32_t image_height, float sharp_const, std::vector<std::vector<uint8_t>> & detail_maps);
+
+  // rgba to planar L, a and b, the statistics are exact integer sums converted to cie-lab units at the end
+  std::vector<std::vector<uint16_t>> convert_image_rgb_to_planar_lab(const uint8_t * input_image, uint32_t image_width, uint32_t image_height, colormodel::cielab_statistics & stats);
+  // a and b are color balanced on the way: a + a_balance * a and b + b_balance * b
+  std::vector<uint8_t> convert_planar_lab_to_rgb(const uint16_t * l_channel, const uint16_t * a_channel, const uint16_t * b_channel, uint32_t image_width, uint32_t image_height, float a_balance = 0.0f, float b_balance = 0.0f);
+  void convert_planar_lab_to_rgb(const uint16_t * l_channel, const uint16_t * a_channel, const uint16_t * b_channel, uint32_t image_width, uint32_t image_height, float a_balance, float b_balance, std::span<uint8_t> output);
+
+  std::vector<float> l_channel_to_float(const std::vector<uint16_t> & channel);
+  std::vector<uint16_t> l_channel_from_float(const std::vector<float> & channel);
+
+  // mean + min(global variance / block variance, beta) * (L - mean) with the block statistics from integer sums, same
+  // blocks as imagefilters::compute_block_stats_grid. the variance is in L units
+  std::vector<uint16_t> local_contrast_blocks(const std::vector<uint16_t> & l_channel, uint32_t image_width, uint32_t image_height, uint32_t block_size, float global_variance, float beta);
+  // same as above with the statistics of the (2 * radius + 1) window around every pixel
+  std::vector<uint16_t> local_contrast_window(const std::vector<uint16_t> & l_channel, uint32_t image_width, uint32_t image_height, uint32_t radius, float global_variance, float beta);
+
+  // self guided filter base plus k times the detail, eps is in L units squared
+  std::vector<uint16_t> guided_detail_enhance(const std::vector<uint16_t> & l_channel, uint32_t image_width, uint32_t image_height, uint32_t radius, float eps, float k);
+}
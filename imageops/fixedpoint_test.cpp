@@ -0,0 +1,77 @@
+#include <string>
+#include <vector>
+
+#include "common/testcheck.h"
+#include "imageops/fixedpoint.h"
+#include "pipeline/pipeline.h"
+
+namespace {
+  // the deviation from the float path documented in fixedpoint.h
+  constexpr int max_levels = 2;
+  constexpr int max_dark_levels = 8;
+  constexpr uint8_t dark_below = 64;
+  constexpr double max_dark_share = 0.0025;
+}
+
+int main()
+{
+  for (uint32_t seed=1; seed<=4; seed++)
+  {
+    const uint32_t image_width = 96 + (seed * 7);
+    const uint32_t image_height = 64 + (seed * 5);
+    const auto input = testcheck::synthetic_frame(image_width, image_height, seed);
+
+    for (const auto mode : {pipeline::contrast_mode::block, pipeline::contrast_mode::interpolated, pipeline::contrast_mode::sliding_window})
+    {
+      pipeline::parameters params;
+      params.local_contrast_mode = mode;
+
+      pipeline::result expected;
+      pipeline::process(input, image_width, image_height, params, expected, false);
+
+      params.arithmetic = pipeline::arithmetic_mode::fixed_point;
+      pipeline::result output;
+      pipeline::process(input, image_width, image_height, params, output, false);
+
+      const std::string name = "seed " + std::to_string(seed) + ", contrast mode " + std::to_string(static_cast<int>(mode));
+      if (!testcheck::check(output.color_corrected_image.size() == expected.color_corrected_image.size(), name + ": fixed point output has the size of the float output"))
+      {
+        continue;
+      }
+
+      int bright_difference = 0;
+      size_t dark_outside = 0;
+      for (size_t i=0; i<expected.color_corrected_image.size(); i++)
+      {
+        const uint8_t a = expected.color_corrected_image[i];
+        const uint8_t b = output.color_corrected_image[i];
+        const int difference = std::abs(static_cast<int>(a) - static_cast<int>(b));
+        if ((a >= dark_below) && (b >= dark_below))
+        {
+          bright_difference = std::max(bright_difference, difference);
+        }
+        else if (difference > max_levels)
+        {
+          dark_outside++;
+        }
+      }
+
+      testcheck::check(bright_difference <= max_levels, name + ": values from 64 up are within 2 levels");
+      testcheck::check(testcheck::max_difference(output.color_corrected_image, expected.color_corrected_image) <= max_dark_levels, name + ": dark values are within 8 levels");
+      testcheck::check(static_cast<double>(dark_outside) <= (static_cast<double>(expected.color_corrected_image.size()) * max_dark_share), name + ": few dark values are more than 2 levels off");
+    }
+  }
+
+  // the lab planes round trip within the 6 fraction bits of the 8-bit scaling
+  const std::vector<float> l_channel = {0.0f, 0.37f, 12.5f, 50.0f, 99.99f, 100.0f};
+  const auto l_back = fixedpoint::l_channel_to_float(fixedpoint::l_channel_from_float(l_channel));
+  bool round_trip = (l_back.size() == l_channel.size());
+  for (size_t i=0; round_trip && (i<l_channel.size()); i++)
+  {
+    round_trip = (std::abs(l_back[i] - l_channel[i]) <= (0.5f / (2.55f * 64.0f)));
+  }
+
+  testcheck::check(round_trip, "L planes round trip within half a fixed point step");
+
+  return testcheck::result();
+}
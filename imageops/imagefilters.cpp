@@ -1,12 +1,61 @@
 #include "imagefilters.h"
 
 #include "imageops.h"
+#include "parallel.h"
+#include "cpudispatch.h"
 #include <algorithm>
 #include <limits>
 #include <cmath>
 
+namespace {
+  // index of the block centre left of every position and the weight of the next centre
+  void interpolation_table(uint32_t image_size, uint32_t block_size, uint32_t blocks, std::vector<uint32_t> & index, std::vector<float> & weight)
+  {
+    index.resize(image_size);
+    weight.resize(image_size);
+
+    std::vector<float> centres(blocks);
+    for (size_t b=0; b<blocks; b++)
+    {
+      const auto [start, length] = imagefilters::block_window(b, block_size, image_size);
+      centres[b] = static_cast<float>(start) + (static_cast<float>(length) / 2.0f) - 0.5f;
+    }
+
+    uint32_t b = 0;
+    for (size_t p=0; p<image_size; p++)
+    {
+      const auto position = static_cast<float>(p);
+      while (((b + 2) < blocks) && (position >= centres[b + 1]))
+      {
+        b++;
+      }
+
+      index[p] = b;
+      if ((blocks < 2) || (position <= centres[b]))
+      {
+        weight[p] = 0.0f;
+      }
+      else if (position >= centres[b + 1])
+      {
+        weight[p] = 1.0f;
+      }
+      else
+      {
+        weight[p] = (position - centres[b]) / (centres[b + 1] - centres[b]);
+      }
+    }
+  }
+}
+
 namespace imagefilters {
 
+  std::pair<size_t, size_t> block_window(size_t index, uint32_t block_size, uint32_t image_size)
+  {
+    size_t length = std::min(static_cast<size_t>(block_size), static_cast<size_t>(image_size));
+    size_t start = std::min(index * block_size, static_cast<size_t>(image_size) - length);
+    return {start, length};
+  }
+
   std::vector<float> guassian_blur_channel(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height)
   {
     std::vector<float> guassian_kernel = {1.0f, 2.0f, 1.0f, 2.0f, 4.0f, 2.0f , 1.0f, 2.0f, 1.0f};
@@ -48,16 +97,9 @@ namespace imagefilters {
 
   std::vector<float> unsharpen_channel(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, const float & unsharp_const)
   {
-    auto guassian_blur = guassian_blur_channel(input_image, image_width, image_height);
-
-    std::vector<float> unsharp_mask_image (image_width * image_height);
-    for (size_t i=0; i<image_height; i++)
-    {
-      for (size_t j=0; j<image_width; j++)
-      {
-        unsharp_mask_image[j + (i * image_width)] = unsharp_const * (static_cast<float>(input_image[j + (i * image_width)]) - guassian_blur[j + (i * image_width)]);
-      }
-    }
+    // same values as subtracting guassian_blur_channel, in one pass
+    std::vector<float> unsharp_mask_image (static_cast<size_t>(image_width) * image_height);
+    imageops::kernels::unsharp_mask(input_image.data(), image_width, image_height, unsharp_const, unsharp_mask_image.data());
 
     return unsharp_mask_image;
   }
@@ -199,6 +241,322 @@ namespace imagefilters {
     return variance;
   }
 
+  block_stats_grid compute_block_stats_grid(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t block_size)
+  {
+    block_stats_grid grid;
+    grid.block_size = std::max(block_size, 1u);
+    grid.blocks_x = (image_width + grid.block_size - 1) / grid.block_size;
+    grid.blocks_y = (image_height + grid.block_size - 1) / grid.block_size;
+    grid.blocks.resize(static_cast<size_t>(grid.blocks_x) * grid.blocks_y);
+
+    imageops::parallel_for(0, grid.blocks_y, 1, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const auto [y0, window_height] = block_window(i, grid.block_size, image_height);
+
+        for (size_t j=0; j<grid.blocks_x; j++)
+        {
+          const auto [x0, window_width] = block_window(j, grid.block_size, image_width);
+          block_stats & stats = grid.blocks[j + (i * grid.blocks_x)];
+
+          // sum in the first pass, the variance around the mean in the second (block is still in cache)
+
+          double sum = 0.0;
+
+          for (size_t y=y0; y<(y0 + window_height); y++)
+          {
+            const float * row = input_image.data() + (y * image_width);
+            for (size_t x=x0; x<(x0 + window_width); x++)
+            {
+              sum += row[x];
+            }
+          }
+
+          const auto n = static_cast<double>(window_width * window_height);
+          const double mean = sum / n;
+          double squared_sum = 0.0;
+
+          for (size_t y=y0; y<(y0 + window_height); y++)
+          {
+            const float * row = input_image.data() + (y * image_width);
+            for (size_t x=x0; x<(x0 + window_width); x++)
+            {
+              const double d = static_cast<double>(row[x]) - mean;
+              squared_sum += d * d;
+            }
+          }
+
+          stats.mean = static_cast<float>(mean);
+          stats.variance = static_cast<float>(squared_sum / n);
+        }
+      }
+    });
+
+    return grid;
+  }
+
+  void interpolated_block_linear_map(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, const block_stats_grid & grid, const std::vector<float> & block_offset, const std::vector<float> & block_gain, float min_value, float max_value, std::vector<float> & output_image)
+  {
+    output_image.resize(static_cast<size_t>(image_width) * image_height);
+
+    if (grid.blocks.empty())
+    {
+      return;
+    }
+
+    std::vector<uint32_t> column_block;
+    std::vector<float> column_weight;
+    std::vector<uint32_t> row_block;
+    std::vector<float> row_weight;
+    interpolation_table(image_width, grid.block_size, grid.blocks_x, column_block, column_weight);
+    interpolation_table(image_height, grid.block_size, grid.blocks_y, row_block, row_weight);
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      std::vector<float> row_offset(grid.blocks_x);
+      std::vector<float> row_gain(grid.blocks_x);
+
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        // blend the two block rows first, then each pixel only blends two neighbouring columns
+
+        const size_t b0 = row_block[i];
+        const size_t b1 = std::min(b0 + 1, static_cast<size_t>(grid.blocks_y - 1));
+        const float wy = row_weight[i];
+
+        for (size_t j=0; j<grid.blocks_x; j++)
+        {
+          row_offset[j] = block_offset[j + (b0 * grid.blocks_x)] + (wy * (block_offset[j + (b1 * grid.blocks_x)] - block_offset[j + (b0 * grid.blocks_x)]));
+          row_gain[j] = block_gain[j + (b0 * grid.blocks_x)] + (wy * (block_gain[j + (b1 * grid.blocks_x)] - block_gain[j + (b0 * grid.blocks_x)]));
+        }
+
+        const float * input_row = input_image.data() + (i * image_width);
+        float * output_row = output_image.data() + (i * image_width);
+        const size_t last_block = grid.blocks_x - 1;
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          const size_t a0 = column_block[j];
+          const size_t a1 = std::min(a0 + 1, last_block);
+          const float wx = column_weight[j];
+          const float offset = row_offset[a0] + (wx * (row_offset[a1] - row_offset[a0]));
+          const float gain = row_gain[a0] + (wx * (row_gain[a1] - row_gain[a0]));
+
+          output_row[j] = std::clamp(offset + (gain * input_row[j]), min_value, max_value);
+        }
+      }
+    });
+  }
+
+  void box_mean_variance(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t radius, std::vector<float> & mean, std::vector<float> & variance)
+  {
+    // separable running sums: window sums of every row first, then a running sum of those down every column. the
+    // column sums are kept in double so adding and removing rows does not drift
+
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<float> row_sum(image_size);
+    std::vector<float> row_squared_sum(image_size);
+    mean.resize(image_size);
+    variance.resize(image_size);
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const float * row = input_image.data() + (i * image_width);
+        double sum = 0.0;
+        double squared_sum = 0.0;
+
+        for (size_t j=0; j<std::min(static_cast<size_t>(radius), static_cast<size_t>(image_width)); j++)
+        {
+          sum += row[j];
+          squared_sum += static_cast<double>(row[j]) * row[j];
+        }
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          if ((j + radius) < image_width)
+          {
+            const double value = row[j + radius];
+            sum += value;
+            squared_sum += value * value;
+          }
+
+          if (j > radius)
+          {
+            const double value = row[j - radius - 1];
+            sum -= value;
+            squared_sum -= value * value;
+          }
+
+          row_sum[j + (i * image_width)] = static_cast<float>(sum);
+          row_squared_sum[j + (i * image_width)] = static_cast<float>(squared_sum);
+        }
+      }
+    });
+
+    imageops::parallel_for(0, image_width, 64, [&](size_t column_begin, size_t column_end) {
+      const size_t columns = column_end - column_begin;
+      std::vector<double> sum(columns, 0.0);
+      std::vector<double> squared_sum(columns, 0.0);
+
+      auto add_row = [&](size_t y, double sign) {
+        const float * s = row_sum.data() + (y * image_width) + column_begin;
+        const float * q = row_squared_sum.data() + (y * image_width) + column_begin;
+        for (size_t c=0; c<columns; c++)
+        {
+          sum[c] += sign * s[c];
+          squared_sum[c] += sign * q[c];
+        }
+      };
+
+      for (size_t i=0; i<std::min(static_cast<size_t>(radius), static_cast<size_t>(image_height)); i++)
+      {
+        add_row(i, 1.0);
+      }
+
+      for (size_t i=0; i<image_height; i++)
+      {
+        if ((i + radius) < image_height)
+        {
+          add_row(i + radius, 1.0);
+        }
+
+        if (i > radius)
+        {
+          add_row(i - radius - 1, -1.0);
+        }
+
+        const size_t y0 = (i > radius) ? (i - radius) : 0;
+        const size_t y1 = std::min(i + radius + 1, static_cast<size_t>(image_height));
+        const double window_height = static_cast<double>(y1 - y0);
+
+        for (size_t c=0; c<columns; c++)
+        {
+          const size_t j = column_begin + c;
+          const size_t x0 = (j > radius) ? (j - radius) : 0;
+          const size_t x1 = std::min(j + radius + 1, static_cast<size_t>(image_width));
+          const double n = window_height * static_cast<double>(x1 - x0);
+          const double m = sum[c] / n;
+
+          mean[j + (i * image_width)] = static_cast<float>(m);
+          variance[j + (i * image_width)] = static_cast<float>(std::max((squared_sum[c] / n) - (m * m), 0.0));
+        }
+      }
+    });
+  }
+
+  std::vector<float> box_mean(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t radius)
+  {
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<float> row_sum(image_size);
+    std::vector<float> mean(image_size);
+
+    imageops::parallel_for(0, image_height, 16, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        const float * row = input_image.data() + (i * image_width);
+        double sum = 0.0;
+
+        for (size_t j=0; j<std::min(static_cast<size_t>(radius), static_cast<size_t>(image_width)); j++)
+        {
+          sum += row[j];
+        }
+
+        for (size_t j=0; j<image_width; j++)
+        {
+          if ((j + radius) < image_width)
+          {
+            sum += row[j + radius];
+          }
+
+          if (j > radius)
+          {
+            sum -= row[j - radius - 1];
+          }
+
+          row_sum[j + (i * image_width)] = static_cast<float>(sum);
+        }
+      }
+    });
+
+    imageops::parallel_for(0, image_width, 64, [&](size_t column_begin, size_t column_end) {
+      const size_t columns = column_end - column_begin;
+      std::vector<double> sum(columns, 0.0);
+
+      auto add_row = [&](size_t y, double sign) {
+        const float * s = row_sum.data() + (y * image_width) + column_begin;
+        for (size_t c=0; c<columns; c++)
+        {
+          sum[c] += sign * s[c];
+        }
+      };
+
+      for (size_t i=0; i<std::min(static_cast<size_t>(radius), static_cast<size_t>(image_height)); i++)
+      {
+        add_row(i, 1.0);
+      }
+
+      for (size_t i=0; i<image_height; i++)
+      {
+        if ((i + radius) < image_height)
+        {
+          add_row(i + radius, 1.0);
+        }
+
+        if (i > radius)
+        {
+          add_row(i - radius - 1, -1.0);
+        }
+
+        const size_t y0 = (i > radius) ? (i - radius) : 0;
+        const size_t y1 = std::min(i + radius + 1, static_cast<size_t>(image_height));
+        const double window_height = static_cast<double>(y1 - y0);
+
+        for (size_t c=0; c<columns; c++)
+        {
+          const size_t j = column_begin + c;
+          const size_t x0 = (j > radius) ? (j - radius) : 0;
+          const size_t x1 = std::min(j + radius + 1, static_cast<size_t>(image_width));
+
+          mean[j + (i * image_width)] = static_cast<float>(sum[c] / (window_height * static_cast<double>(x1 - x0)));
+        }
+      }
+    });
+
+    return mean;
+  }
+
+  void guided_filter(std::vector<float> & image, uint32_t image_width, uint32_t image_height, uint32_t radius, float eps)
+  {
+    // the image is its own guide: q = mean(a) * I + mean(b) with a = var / (var + eps) and b = (1 - a) * mean per
+    // window. a goes to 1 on edges (var >> eps) and to 0 in flat areas
+
+    std::vector<float> mean;
+    std::vector<float> variance;
+    box_mean_variance(image, image_width, image_height, radius, mean, variance);
+
+    std::vector<float> & a = variance;
+    std::vector<float> & b = mean;
+
+    imageops::parallel_for(0, image.size(), 4096, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i<end; i++)
+      {
+        const float a_value = variance[i] / (variance[i] + eps);
+        b[i] = (1.0f - a_value) * mean[i];
+        a[i] = a_value;
+      }
+    });
+
+    const auto mean_a = box_mean(a, image_width, image_height, radius);
+    const auto mean_b = box_mean(b, image_width, image_height, radius);
+
+    imageops::parallel_for(0, image.size(), 4096, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i<end; i++)
+      {
+        image[i] = (mean_a[i] * image[i]) + mean_b[i];
+      }
+    });
+  }
+
   std::vector<uint8_t> constrain_filter_to_byte_map(const std::vector<float> & filter)
   {
     std::vector<uint8_t> constraint_result (filter.size());
@@ -1,10 +1,33 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace imagefilters {
 
+  struct block_stats
+  {
+    float mean = 0.0f;
+    float variance = 0.0f;
+  };
+
+  // statistics of every block_size x block_size block of a channel. the last block of a row or column is moved back
+  // so it ends at the image edge, the same window the integral image block functions use
+  struct block_stats_grid
+  {
+    uint32_t block_size = 0;
+    uint32_t blocks_x = 0;
+    uint32_t blocks_y = 0;
+    std::vector<block_stats> blocks;
+
+    [[nodiscard]] const block_stats & at(size_t x, size_t y) const { return blocks[x + (y * blocks_x)]; }
+  };
+
+  // start and length of block index of a grid, the last block is moved back so it ends at the image edge
+  std::pair<size_t, size_t> block_window(size_t index, uint32_t block_size, uint32_t image_size);
+
   std::vector<float> guassian_blur_channel(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height);
   std::vector<float> unsharpen_channel(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, const float & unsharp_const);
 
@@ -13,6 +36,19 @@ namespace imagefilters {
   float integral_image_map_local_block_mean(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t x, uint32_t y, uint32_t local_width, uint32_t local_height);
   float integral_image_map_local_block_variance(const std::vector<float> & input_image_sum_var_table, const std::vector<float> & input_image_sum_mean_table, uint32_t image_width, uint32_t image_height, uint32_t x, uint32_t y, uint32_t local_width, uint32_t local_height);
 
+  block_stats_grid compute_block_stats_grid(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t block_size);
+
+  // output = clamp(offset + gain * input) with the per block offset and gain bilinearly interpolated between the block
+  // centres of the grid, pixels outside of the outer centres use the nearest block
+  void interpolated_block_linear_map(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, const block_stats_grid & grid, const std::vector<float> & block_offset, const std::vector<float> & block_gain, float min_value, float max_value, std::vector<float> & output_image);
+
+  // statistics of the (2 * radius + 1) square window around every pixel, clipped to the image
+  void box_mean_variance(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t radius, std::vector<float> & mean, std::vector<float> & variance);
+  std::vector<float> box_mean(const std::vector<float> & input_image, uint32_t image_width, uint32_t image_height, uint32_t radius);
+
+  // self guided edge preserving smoothing (He et al.), the cost does not depend on the radius
+  void guided_filter(std::vector<float> & image, uint32_t image_width, uint32_t image_height, uint32_t radius, float eps);
+
   std::vector<uint8_t> constrain_filter_to_byte_map(const std::vector<float> & filter);
 };
 
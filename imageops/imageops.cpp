@@ -1,99 +1,275 @@
 #include "imageops.h"
+#include "expression.h"
+#include "cpudispatch.h"
+#include "parallel.h"
 
+#include <array>
+#include <bit>
 #include <limits>
+#include <algorithm>
+#include <cmath>
 #include <spdlog/spdlog.h>
 
-namespace imageops {
-  float mean (const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HALF_F16C_AVAILABLE 1
+#else
+#define HALF_F16C_AVAILABLE 0
+#endif
+
+namespace {
+#if HALF_F16C_AVAILABLE
+  bool has_f16c()
   {
-    float avg = 0.0f;
+    static const bool supported = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+    return supported;
+  }
 
-    for (size_t i=0; i<image_height; i++)
+  // converts blocks of 8 values, returns how many were converted. the rest is left for the software conversion
+  __attribute__((target("avx,f16c"))) size_t convert_float_to_half_f16c(const float * input, uint16_t * output, size_t count)
+  {
+    size_t i = 0;
+    for (; (i + 8) <= count; i+=8)
     {
-      for (size_t j=0; j<image_width; j++)
-      {
-        avg += static_cast<float>(image_data_channel[j + (i*image_width)]);
-      }
+      const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i), half);
     }
 
-    avg /= static_cast<float>(image_width * image_height);
+    return i;
+  }
+
+  __attribute__((target("avx,f16c"))) size_t convert_half_to_float_f16c(const uint16_t * input, float * output, size_t count)
+  {
+    size_t i = 0;
+    for (; (i + 8) <= count; i+=8)
+    {
+      const __m256 full = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i)));
+      _mm256_storeu_ps(output + i, full);
+    }
 
-    return avg;
+    return i;
   }
+#endif
 
-  float mean (const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  constexpr size_t max_kernel_channels = 4; // more channels are split and combined without the dispatched kernels
+
+  // the vector and span overloads share these, channels is any indexable list of planes
+  // plane pointers for the dispatched kernels, at most max_kernel_channels planes
+  template <typename value_type>
+  std::array<value_type *, max_kernel_channels> plane_pointers(std::span<const std::span<value_type>> planes)
   {
-    float avg = 0.0f;
+    std::array<value_type *, max_kernel_channels> pointers {};
+    for (size_t k=0; k<planes.size(); k++)
+    {
+      pointers[k] = planes[k].data();
+    }
 
-    for (size_t i=0; i<image_height; i++)
+    return pointers;
+  }
+
+  template <typename input_type, typename channel_list>
+  void split_channels(const input_type * image_data, uint32_t image_width, uint32_t image_height, uint8_t bpp, channel_list & channels)
+  {
+    for (size_t i=0; i<(static_cast<size_t>(image_width) * image_height); i++)
     {
-      for (size_t j=0; j<image_width; j++)
+      for (size_t k=0; k<bpp; k++)
       {
-        avg += image_data_channel[j + (i*image_width)];
+        channels[k][i] = image_data[(i * bpp) + k];
       }
     }
-
-    avg /= static_cast<float>(image_width * image_height);
-
-    return avg;
   }
 
-  float variance (const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  template <typename value_type, typename channel_list>
+  void combine_channels(const channel_list & image_channels, uint32_t image_width, uint32_t image_height, value_type * combined_channels)
   {
-    float avg = 0.0f;
-
-    float mean_value = mean(image_data_channel, image_width, image_height);
-    mean_value *= mean_value;
+    const size_t n_channels = image_channels.size();
 
     for (size_t i=0; i<image_height; i++)
     {
-      for (size_t j=0; j<image_width; j++)
+      for(size_t j=0; j<image_width; j++)
       {
-        avg += (static_cast<float>(image_data_channel[j + (i*image_width)]) * static_cast<float>(image_data_channel[j + (i*image_width)]));
+        for (size_t k=0; k<n_channels; k++)
+        {
+          combined_channels[(j * n_channels + k) + (i * image_width * n_channels)] = image_channels[k][j + (i * image_width)];
+        }
       }
     }
+  }
 
-    avg /= static_cast<float>(image_width * image_height);
+  template <typename value_type>
+  void copy_rows(const value_type * image_data, uint32_t image_width, uint8_t bpp, uint32_t x, uint32_t y, uint32_t section_width, uint32_t section_height, value_type * section)
+  {
+    for (size_t i=0; i<section_height; i++)
+    {
+      const value_type * row = image_data + (((y + i) * image_width) + x) * bpp;
+      std::copy(row, row + (section_width * bpp), section + (i * section_width * bpp));
+    }
+  }
 
-    avg -= mean_value;
+  // reductions run over fixed blocks of reduction_block values in parallel and the block results are merged in block
+  // order, so the result does not depend on the number of threads
+  constexpr size_t reduction_block = 16384;
 
-    return avg;
-  }
+  struct integer_moments
+  {
+    uint64_t sum = 0;
+    uint64_t squared_sum = 0;
+  };
 
-  float variance (const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  // count, sum and sum of squared deviations from the mean. blocks are combined with the pairwise update of Chan et
+  // al., which does not lose the variance to cancellation like sum(x^2) / n - mean^2 does
+  struct moments
   {
-    float avg = 0.0f;
+    size_t count = 0;
+    double sum = 0.0;
+    double m2 = 0.0;
 
-    float mean_value = mean(image_data_channel, image_width, image_height);
-    mean_value *= mean_value;
+    [[nodiscard]] double mean() const { return (count > 0) ? (sum / static_cast<double>(count)) : 0.0; }
 
-    for (size_t i=0; i<image_height; i++)
+    void merge(const moments & other)
     {
-      for (size_t j=0; j<image_width; j++)
+      if (other.count == 0)
       {
-        avg += (image_data_channel[j + (i*image_width)] * image_data_channel[j + (i*image_width)]);
+        return;
       }
+
+      const double delta = other.mean() - mean();
+      const auto n = static_cast<double>(count + other.count);
+      m2 += other.m2 + ((delta * delta) * ((static_cast<double>(count) * static_cast<double>(other.count)) / n));
+      sum += other.sum;
+      count += other.count;
     }
+  };
 
-    avg /= static_cast<float>(image_width * image_height);
+  // uint8 sums are exact integers, the squared sum fits 64 bits up to 2^48 values
+  integer_moments reduce_integer_moments(const uint8_t * values, size_t count)
+  {
+    const size_t blocks = (count + reduction_block - 1) / reduction_block;
+    std::vector<integer_moments> block_moments (blocks);
 
-    avg -= mean_value;
+    imageops::parallel_for(0, blocks, 4, [&](size_t block_begin, size_t block_end) {
+      for (size_t b=block_begin; b<block_end; b++)
+      {
+        const size_t end = std::min(count, (b + 1) * reduction_block);
+        uint32_t sum = 0;
+        uint64_t squared_sum = 0;
+        for (size_t i=(b * reduction_block); i<end; i++)
+        {
+          const uint32_t value = values[i];
+          sum += value;
+          squared_sum += value * value;
+        }
 
-    return avg;
+        block_moments[b] = {sum, squared_sum};
+      }
+    });
+
+    integer_moments total;
+    for (const auto & block : block_moments)
+    {
+      total.sum += block.sum;
+      total.squared_sum += block.squared_sum;
+    }
+
+    return total;
   }
 
-  float min_channel_value(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  // every block is reduced in two passes (mean, then squared deviations) in double
+  moments reduce_moments(const float * values, size_t count)
   {
-    auto value = static_cast<float>(std::numeric_limits<uint8_t>::max());
-    for (size_t i=0; i<image_height; i++)
-    {
-      for (size_t j=0; j<image_width; j++)
+    const size_t blocks = (count + reduction_block - 1) / reduction_block;
+    std::vector<moments> block_moments (blocks);
+
+    imageops::parallel_for(0, blocks, 4, [&](size_t block_begin, size_t block_end) {
+      for (size_t b=block_begin; b<block_end; b++)
       {
-        value = std::min(value, static_cast<float>(image_data_channel[j + (i*image_width)]));
+        const size_t begin = b * reduction_block;
+        const size_t end = std::min(count, begin + reduction_block);
+        double sum = 0.0;
+        for (size_t i=begin; i<end; i++)
+        {
+          sum += values[i];
+        }
+
+        const double block_mean = sum / static_cast<double>(end - begin);
+        double m2 = 0.0;
+        for (size_t i=begin; i<end; i++)
+        {
+          const double deviation = values[i] - block_mean;
+          m2 += deviation * deviation;
+        }
+
+        block_moments[b] = {end - begin, sum, m2};
       }
+    });
+
+    moments total;
+    for (const auto & block : block_moments)
+    {
+      total.merge(block);
     }
 
-    return value;
+    return total;
+  }
+}
+
+
+namespace imageops {
+  double squared_deviation_sum(uint64_t count, uint64_t sum, uint64_t squared_sum)
+  {
+    if (count == 0)
+    {
+      return 0.0;
+    }
+
+    // with sum = q * n + r, sum(x^2) - sum(x)^2 / n is sum(x^2) - q * (sum + r) - r^2 / n. the first part is an exact
+    // integer no larger than sum(x^2) and at least r^2 / n, so only the small fraction is rounded and nothing cancels
+    const uint64_t q = sum / count;
+    const uint64_t r = sum % count;
+    const uint64_t whole = squared_sum - (q * (sum + r));
+    const double fraction = (static_cast<double>(r) * static_cast<double>(r)) / static_cast<double>(count);
+    return std::max(0.0, static_cast<double>(whole) - fraction);
+  }
+
+  float mean (const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    const size_t count = static_cast<size_t>(image_width) * image_height;
+    if (count == 0)
+    {
+      return 0.0f;
+    }
+
+    const integer_moments moments = reduce_integer_moments(image_data_channel, count);
+    return static_cast<float>(static_cast<double>(moments.sum) / static_cast<double>(count));
+  }
+
+  float mean (const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    const size_t count = static_cast<size_t>(image_width) * image_height;
+    return (count > 0) ? static_cast<float>(reduce_moments(image_data_channel, count).mean()) : 0.0f;
+  }
+
+  float variance (const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    const size_t count = static_cast<size_t>(image_width) * image_height;
+    if (count == 0)
+    {
+      return 0.0f;
+    }
+
+    const integer_moments moments = reduce_integer_moments(image_data_channel, count);
+    return static_cast<float>(squared_deviation_sum(count, moments.sum, moments.squared_sum) / static_cast<double>(count));
+  }
+
+  float variance (const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    const size_t count = static_cast<size_t>(image_width) * image_height;
+    return (count > 0) ? static_cast<float>(reduce_moments(image_data_channel, count).m2 / static_cast<double>(count)) : 0.0f;
+  }
+
+  float min_channel_value(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    return static_cast<float>(kernels::min_value(image_data_channel, static_cast<size_t>(image_width) * image_height));
   }
 
   float min_channel_value(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
@@ -117,9 +293,9 @@ namespace imageops {
     {
       for (size_t j=(x*local_width); j<((x*local_width) + local_width); j++)
       {
-        if (((x + j) < image_width) && ((y + i) < image_height))
+        if ((j < image_width) && (i < image_height))
         {
-          value = std::min(value, image_data_channel[(x + j) + ((y + i) * image_width)]);
+          value = std::min(value, image_data_channel[j + (i * image_width)]);
         }
       }
     }
@@ -129,16 +305,7 @@ namespace imageops {
 
   float max_channel_value(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    auto value = static_cast<float>(std::numeric_limits<uint8_t>::min());
-    for (size_t i=0; i<image_height; i++)
-    {
-      for (size_t j=0; j<image_width; j++)
-      {
-        value = std::max(value, static_cast<float>(image_data_channel[j + (i*image_width)]));
-      }
-    }
-
-    return value;
+    return static_cast<float>(kernels::max_value(image_data_channel, static_cast<size_t>(image_width) * image_height));
   }
 
   float max_channel_value(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
@@ -162,9 +329,9 @@ namespace imageops {
     {
       for (size_t j=(x*local_width); j<((x*local_width) + local_width); j++)
       {
-        if (((x + j) < image_width) && ((y + i) < image_height))
+        if ((j < image_width) && (i < image_height))
         {
-          value = std::max(value, image_data_channel[(x + j) + ((y + i) * image_width)]);
+          value = std::max(value, image_data_channel[j + (i * image_width)]);
         }
       }
     }
@@ -174,252 +341,473 @@ namespace imageops {
 
   float channel_sum(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    float sum = 0.0f;
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      sum += static_cast<float>(image_data_channel[i]);
-    }
-
-    return sum;
+    const size_t count = static_cast<size_t>(image_width) * image_height;
+    return static_cast<float>(reduce_integer_moments(image_data_channel, count).sum);
   }
 
   float channel_sum(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    float sum = 0.0f;
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      sum += image_data_channel[i];
-    }
-
-    return sum;
+    const size_t count = static_cast<size_t>(image_width) * image_height;
+    return static_cast<float>(reduce_moments(image_data_channel, count).sum);
   }
 
   std::vector<float> element_add(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> image_element_sum(image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      image_element_sum[i] = static_cast<float>(image_data_channel_0[i]) + static_cast<float>(image_data_channel_1[i]);
-    }
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_add(image_data_channel_0, image_data_channel_1, image_width, image_height, result);
+    return result;
+  }
 
-    return image_element_sum;
+  void element_add(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    assign(output.data(), plane(image_data_channel_0) + plane(image_data_channel_1), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> element_add(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> image_element_sum(image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      image_element_sum[i] = image_data_channel_0[i] + image_data_channel_1[i];
-    }
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_add(image_data_channel_0, image_data_channel_1, image_width, image_height, result);
+    return result;
+  }
 
-    return image_element_sum;
+  void element_add(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    kernels::add(image_data_channel_0, image_data_channel_1, output.data(), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> element_subtract(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> image_element_sum(image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      image_element_sum[i] = static_cast<float>(image_data_channel_0[i]) - static_cast<float>(image_data_channel_1[i]);
-    }
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_subtract(image_data_channel_0, image_data_channel_1, image_width, image_height, result);
+    return result;
+  }
 
-    return image_element_sum;
+  void element_subtract(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    assign(output.data(), plane(image_data_channel_0) - plane(image_data_channel_1), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> element_subtract(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> image_element_sum(image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      image_element_sum[i] = image_data_channel_0[i] - image_data_channel_1[i];
-    }
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_subtract(image_data_channel_0, image_data_channel_1, image_width, image_height, result);
+    return result;
+  }
 
-    return image_element_sum;
+  void element_subtract(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    kernels::subtract(image_data_channel_0, image_data_channel_1, output.data(), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> element_multi(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> image_element_sum(image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      image_element_sum[i] = static_cast<float>(image_data_channel_0[i]) * static_cast<float>(image_data_channel_1[i]);
-    }
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_multi(image_data_channel_0, image_data_channel_1, image_width, image_height, result);
+    return result;
+  }
 
-    return image_element_sum;
+  void element_multi(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    assign(output.data(), plane(image_data_channel_0) * plane(image_data_channel_1), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> element_multi(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> image_element_sum(image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      image_element_sum[i] = image_data_channel_0[i] * image_data_channel_1[i];
-    }
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_multi(image_data_channel_0, image_data_channel_1, image_width, image_height, result);
+    return result;
+  }
 
-    return image_element_sum;
+  void element_multi(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    kernels::multiply(image_data_channel_0, image_data_channel_1, output.data(), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> element_multi(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> result (image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      result[i] = image_data_channel[i] * scalar;
-    }
-
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_multi(scalar, image_data_channel, image_width, image_height, result);
     return result;
   }
 
-  std::vector<float> element_divide(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  void element_multi(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
   {
-    std::vector<float> result (image_width * image_height);
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      result[i] = image_data_channel[i] / scalar;
-    }
+    kernels::scale(image_data_channel, scalar, output.data(), static_cast<size_t>(image_width) * image_height);
+  }
 
+  std::vector<float> element_divide(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    std::vector<float> result (static_cast<size_t>(image_width) * image_height);
+    element_divide(scalar, image_data_channel, image_width, image_height, result);
     return result;
   }
 
+  void element_divide(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    assign(output.data(), plane(image_data_channel) / scalar, static_cast<size_t>(image_width) * image_height);
+  }
+
   std::vector<float> normalize_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> normalized_channel (image_width * image_height);
-    for (size_t i=0; i< (image_width * image_height); i++)
-    {
-      normalized_channel[i] = static_cast<float>(image_data_channel[i]) / static_cast<float>(std::numeric_limits<uint8_t>::max());
-    }
+    std::vector<float> normalized_channel (static_cast<size_t>(image_width) * image_height);
+    normalize_channel(image_data_channel, image_width, image_height, normalized_channel);
+    return normalized_channel;
+  }
 
-    return  normalized_channel;
+  void normalize_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    assign(output.data(), plane(image_data_channel) / static_cast<float>(std::numeric_limits<uint8_t>::max()), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> constrained_normalize_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
+  {
+    std::vector<float> constrained_normals (static_cast<size_t>(image_width) * image_height);
+    constrained_normalize_channel(image_data_channel, image_width, image_height, constrained_normals);
+    return constrained_normals;
+  }
+
+  void constrained_normalize_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
   {
     float max_value = max_channel_value(image_data_channel, image_width, image_height);
     float min_value = min_channel_value(image_data_channel, image_width, image_height);
 
-    std::vector<float> constrained_normals(image_width * image_height);
-
-    for (size_t i=0; i<(image_width * image_height); i++)
-    {
-      constrained_normals[i] = (image_data_channel[i] - min_value) / (max_value - min_value);
-    }
-
-    return constrained_normals;
+    assign(output.data(), (plane(image_data_channel) - min_value) / (max_value - min_value), static_cast<size_t>(image_width) * image_height);
   }
 
   std::vector<float> convert_int_to_float_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<float> float_channel (image_data_channel, image_data_channel + (image_width * image_height));
+    std::vector<float> float_channel (image_data_channel, image_data_channel + (static_cast<size_t>(image_width) * image_height));
     return float_channel;
   }
 
+  void convert_int_to_float_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    std::copy(image_data_channel, image_data_channel + (static_cast<size_t>(image_width) * image_height), output.begin());
+  }
+
   std::vector<uint8_t> convert_float_to_int_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height)
   {
-    std::vector<uint8_t> int_channel (image_data_channel, image_data_channel + (image_width * image_height));
+    std::vector<uint8_t> int_channel (image_data_channel, image_data_channel + (static_cast<size_t>(image_width) * image_height));
     return int_channel;
   }
 
+  void convert_float_to_int_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<uint8_t> output)
+  {
+    std::copy(image_data_channel, image_data_channel + (static_cast<size_t>(image_width) * image_height), output.begin());
+  }
+
+  uint16_t float_to_half(float value)
+  {
+    // ieee 754 binary16 with round to nearest even, the same rounding the f16c instructions use
+    const auto bits = std::bit_cast<uint32_t>(value);
+    const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    const uint32_t exponent = (bits >> 23) & 0xffu;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xffu)
+    {
+      return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? (0x200u | (mantissa >> 13)) : 0u)); // inf or nan
+    }
+
+    const int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+
+    if (half_exponent >= 0x1f)
+    {
+      return static_cast<uint16_t>(sign | 0x7c00u); // overflow to inf
+    }
+
+    if (half_exponent <= 0)
+    {
+      // subnormal half or zero
+      if (half_exponent < -10)
+      {
+        return sign;
+      }
+
+      mantissa |= 0x800000u;
+      const auto shift = static_cast<uint32_t>(14 - half_exponent);
+      uint32_t half_mantissa = mantissa >> shift;
+      const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+      const uint32_t halfway = 1u << (shift - 1u);
+
+      if ((remainder > halfway) || ((remainder == halfway) && (half_mantissa & 1u)))
+      {
+        half_mantissa++;
+      }
+
+      return static_cast<uint16_t>(sign | half_mantissa);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fffu;
+
+    if ((remainder > 0x1000u) || ((remainder == 0x1000u) && (half & 1u)))
+    {
+      half++; // may carry into the exponent, which is still correct (up to inf)
+    }
+
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  float half_to_float(uint16_t value)
+  {
+    const uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x3ffu;
+
+    if (exponent == 0)
+    {
+      if (mantissa == 0)
+      {
+        return std::bit_cast<float>(sign);
+      }
+
+      // subnormal, normalise it
+      int32_t e = -1;
+      do
+      {
+        e++;
+        mantissa <<= 1u;
+      } while ((mantissa & 0x400u) == 0);
+
+      return std::bit_cast<float>(sign | (static_cast<uint32_t>(127 - 15 - e) << 23) | ((mantissa & 0x3ffu) << 13));
+    }
+
+    if (exponent == 0x1f)
+    {
+      return std::bit_cast<float>(sign | 0x7f800000u | (mantissa << 13));
+    }
+
+    return std::bit_cast<float>(sign | ((exponent - 15 + 127) << 23) | (mantissa << 13));
+  }
+
+  void convert_float_to_half(const float * input, uint16_t * output, size_t count)
+  {
+    size_t i = 0;
+
+#if HALF_F16C_AVAILABLE
+    if (has_f16c())
+    {
+      i = convert_float_to_half_f16c(input, output, count);
+    }
+#endif
+
+    for (; i<count; i++)
+    {
+      output[i] = float_to_half(input[i]);
+    }
+  }
+
+  void convert_half_to_float(const uint16_t * input, float * output, size_t count)
+  {
+    size_t i = 0;
+
+#if HALF_F16C_AVAILABLE
+    if (has_f16c())
+    {
+      i = convert_half_to_float_f16c(input, output, count);
+    }
+#endif
+
+    for (; i<count; i++)
+    {
+      output[i] = half_to_float(input[i]);
+    }
+  }
+
   std::vector<std::vector<uint8_t>> channel_split(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp)
   {
     std::vector<std::vector<uint8_t>> channels;
+    std::vector<std::span<uint8_t>> channel_spans;
     for (size_t i=0; i<bpp; i++)
     {
-      channels.emplace_back(image_width*image_height);
+      channel_spans.emplace_back(channels.emplace_back(static_cast<size_t>(image_width) * image_height));
+    }
+
+    channel_split(image_data, image_width, image_height, bpp, channel_spans);
+    return channels;
+  }
+
+  void channel_split(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<const std::span<uint8_t>> image_channels)
+  {
+    if ((bpp == 0) || (bpp > max_kernel_channels))
+    {
+      split_channels(image_data, image_width, image_height, bpp, image_channels);
+      return;
     }
 
-    for (size_t i=0; i<(image_width * image_height * bpp); i++)
+    kernels::deinterleave(image_data, static_cast<size_t>(image_width) * image_height, bpp, plane_pointers(image_channels).data());
+  }
+
+  void channel_split(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<const std::span<float>> image_channels)
+  {
+    if ((bpp == 0) || (bpp > max_kernel_channels))
     {
-      channels[(i % bpp)][(i / bpp)] = image_data[i];
+      split_channels(image_data, image_width, image_height, bpp, image_channels);
+      return;
     }
 
-    return channels;
+    kernels::deinterleave_to_float(image_data, static_cast<size_t>(image_width) * image_height, bpp, plane_pointers(image_channels).data());
   }
 
   std::vector<std::vector<float>> channel_split(const float * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp)
   {
     std::vector<std::vector<float>> channels;
+    std::vector<std::span<float>> channel_spans;
     for (size_t i=0; i<bpp; i++)
     {
-      channels.emplace_back(image_width*image_height);
+      channel_spans.emplace_back(channels.emplace_back(static_cast<size_t>(image_width) * image_height));
     }
 
-    for (size_t i=0; i<(image_width * image_height * bpp); i++)
+    channel_split(image_data, image_width, image_height, bpp, channel_spans);
+    return channels;
+  }
+
+  void channel_split(const float * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<const std::span<float>> image_channels)
+  {
+    if ((bpp == 0) || (bpp > max_kernel_channels))
     {
-      channels[(i % bpp)][(i / bpp)] = image_data[i];
+      split_channels(image_data, image_width, image_height, bpp, image_channels);
+      return;
     }
 
-    return channels;
+    kernels::deinterleave_float(image_data, static_cast<size_t>(image_width) * image_height, bpp, plane_pointers(image_channels).data());
   }
 
   std::vector<uint8_t> channel_combine(const std::vector<std::vector<uint8_t>> & image_channels, const uint32_t & image_width, const uint32_t & image_height)
   {
-    const size_t n_channels = image_channels.size();
-    std::vector<uint8_t> combined_channels (image_width * image_height * n_channels);
+    std::vector<uint8_t> combined_channels (static_cast<size_t>(image_width) * image_height * image_channels.size());
+    std::vector<std::span<const uint8_t>> channel_spans (image_channels.begin(), image_channels.end());
+    channel_combine(channel_spans, image_width, image_height, combined_channels);
+    return combined_channels;
+  }
 
-    for (size_t i=0; i<image_height; i++)
+  void channel_combine(std::span<const std::span<const uint8_t>> image_channels, const uint32_t & image_width, const uint32_t & image_height, std::span<uint8_t> output)
+  {
+    if ((image_channels.size() == 0) || (image_channels.size() > max_kernel_channels))
     {
-      for(size_t j=0; j<image_width; j++)
-      {
-        for (size_t k=0; k<image_channels.size(); k++)
-        {
-          combined_channels[(j * n_channels + k) + (i * image_width * n_channels)] = image_channels[k][j + (i * image_width)];
-        }
-      }
+      combine_channels(image_channels, image_width, image_height, output.data());
+      return;
     }
 
-    return combined_channels;
+    kernels::interleave(plane_pointers(image_channels).data(), static_cast<size_t>(image_width) * image_height, static_cast<uint32_t>(image_channels.size()), output.data());
   }
 
   std::vector<float> channel_combine(const std::vector<std::vector<float>> & image_channels, const uint32_t & image_width, const uint32_t & image_height)
   {
-    const size_t n_channels = image_channels.size();
-    std::vector<float> combined_channels (image_width * image_height * n_channels);
+    std::vector<float> combined_channels (static_cast<size_t>(image_width) * image_height * image_channels.size());
+    std::vector<std::span<const float>> channel_spans (image_channels.begin(), image_channels.end());
+    channel_combine(channel_spans, image_width, image_height, combined_channels);
+    return combined_channels;
+  }
 
-    for (size_t i=0; i<image_height; i++)
+  void channel_combine(std::span<const std::span<const float>> image_channels, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output)
+  {
+    if ((image_channels.size() == 0) || (image_channels.size() > max_kernel_channels))
     {
-      for(size_t j=0; j<image_width; j++)
-      {
-        for (size_t k=0; k<image_channels.size(); k++)
-        {
-          combined_channels[(j * n_channels + k) + (i * image_width * n_channels)] = image_channels[k][j + (i * image_width)];
-        }
-      }
+      combine_channels(image_channels, image_width, image_height, output.data());
+      return;
     }
 
-    return combined_channels;
+    kernels::interleave_float(plane_pointers(image_channels).data(), static_cast<size_t>(image_width) * image_height, static_cast<uint32_t>(image_channels.size()), output.data());
   }
 
   std::vector<uint8_t> expand_to_n_channels(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & input_bpp, const uint8_t & output_bpp)
   {
-    std::vector<uint8_t> channel (image_width * image_height * output_bpp, std::numeric_limits<uint8_t>::max());
+    std::vector<uint8_t> channel (static_cast<size_t>(image_width) * image_height * output_bpp);
+    expand_to_n_channels(image_data_channel, image_width, image_height, input_bpp, output_bpp, channel);
+    return channel;
+  }
 
-    for (size_t i=0; i<(image_width * image_height); i++)
+  void expand_to_n_channels(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & input_bpp, const uint8_t & output_bpp, std::span<uint8_t> output)
+  {
+    const size_t pixel_count = static_cast<size_t>(image_width) * image_height;
+    if ((input_bpp == 1) && (output_bpp > 1) && (output_bpp <= max_kernel_channels))
     {
-      for (size_t j=0; j<(output_bpp - input_bpp); j++)
+      kernels::broadcast_gray(image_data_channel, pixel_count, output_bpp, output.data());
+      return;
+    }
+
+    std::fill(output.begin(), output.begin() + static_cast<std::ptrdiff_t>(pixel_count * output_bpp), std::numeric_limits<uint8_t>::max());
+
+    const size_t copies = output_bpp - input_bpp;
+    for (size_t i=0; i<pixel_count; i++)
+    {
+      for (size_t j=0; j<copies; j++)
       {
-        channel[(i * output_bpp) + j] = image_data_channel[(i * input_bpp) + (j / (output_bpp - input_bpp))];
+        output[(i * output_bpp) + j] = image_data_channel[(i * input_bpp) + (j / copies)];
       }
     }
+  }
 
-    return channel;
+  std::vector<uint8_t> copy_section(const uint8_t * image_data, const uint32_t & image_width, [[maybe_unused]] const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height)
+  {
+    std::vector<uint8_t> section (static_cast<size_t>(section_width) * section_height * bpp);
+    copy_rows(image_data, image_width, bpp, x, y, section_width, section_height, section.data());
+    return section;
+  }
+
+  void copy_section(const uint8_t * image_data, const uint32_t & image_width, [[maybe_unused]] const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height, std::span<uint8_t> output)
+  {
+    copy_rows(image_data, image_width, bpp, x, y, section_width, section_height, output.data());
+  }
+
+  std::vector<float> copy_section(const float * image_data, const uint32_t & image_width, [[maybe_unused]] const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height)
+  {
+    std::vector<float> section (static_cast<size_t>(section_width) * section_height * bpp);
+    copy_rows(image_data, image_width, bpp, x, y, section_width, section_height, section.data());
+    return section;
+  }
+
+  void copy_section(const float * image_data, const uint32_t & image_width, [[maybe_unused]] const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height, std::span<float> output)
+  {
+    copy_rows(image_data, image_width, bpp, x, y, section_width, section_height, output.data());
+  }
+
+  std::vector<uint16_t> copy_section(const uint16_t * image_data, const uint32_t & image_width, [[maybe_unused]] const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height)
+  {
+    std::vector<uint16_t> section (static_cast<size_t>(section_width) * section_height * bpp);
+    copy_rows(image_data, image_width, bpp, x, y, section_width, section_height, section.data());
+    return section;
   }
 
-  void inplace_filter(const std::vector<float> & input_image, std::vector<float> & output_image, uint32_t x, uint32_t y, uint32_t local_width, uint32_t local_height, uint32_t image_width, uint32_t image_height, const std::function<float(const float &, const uint32_t &x, const uint32_t &y, void*)>& f, void* data)
+  void copy_section(const uint16_t * image_data, const uint32_t & image_width, [[maybe_unused]] const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height, std::span<uint16_t> output)
   {
-    for (size_t i=0; i<local_height; i++)
+    copy_rows(image_data, image_width, bpp, x, y, section_width, section_height, output.data());
+  }
+
+  std::vector<uint8_t> downsample_half(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp)
+  {
+    std::vector<uint8_t> downsampled (static_cast<size_t>((image_width + 1) / 2) * ((image_height + 1) / 2) * bpp);
+    downsample_half(image_data, image_width, image_height, bpp, downsampled);
+    return downsampled;
+  }
+
+  void downsample_half(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<uint8_t> output)
+  {
+    // 2x2 box filter, the last row/column is repeated for odd sizes
+    const uint32_t half_width = (image_width + 1) / 2;
+    const uint32_t half_height = (image_height + 1) / 2;
+
+    for (size_t i=0; i<half_height; i++)
     {
-      for (size_t j=0; j<local_width; j++)
+      const size_t y0 = (i * 2);
+      const size_t y1 = std::min(y0 + 1, static_cast<size_t>(image_height - 1));
+
+      for (size_t j=0; j<half_width; j++)
       {
-        auto x_limit = static_cast<int32_t>(static_cast<int32_t>(image_width - 1) - static_cast<int32_t>((x * local_width) + j));
-        auto y_limit = static_cast<int32_t>(static_cast<int32_t>(image_height - 1) - static_cast<int32_t>((y * local_height) + i));
-        uint32_t index = (j + (x * local_width)) + ((i + (y * local_height)) * image_width);
+        const size_t x0 = (j * 2);
+        const size_t x1 = std::min(x0 + 1, static_cast<size_t>(image_width - 1));
 
-        if (f && (x_limit >= 0) && (x_limit < static_cast<int32_t>(image_width)) && (y_limit >= 0) && (y_limit < static_cast<int32_t>(image_height)))
+        for (size_t k=0; k<bpp; k++)
         {
-          output_image[index] = f(input_image[index], (j + (x * local_width)), ((i + (y * local_height)) * image_width), data);
+          uint32_t sum = static_cast<uint32_t>(image_data[((x0 + (y0 * image_width)) * bpp) + k])
+                       + static_cast<uint32_t>(image_data[((x1 + (y0 * image_width)) * bpp) + k])
+                       + static_cast<uint32_t>(image_data[((x0 + (y1 * image_width)) * bpp) + k])
+                       + static_cast<uint32_t>(image_data[((x1 + (y1 * image_width)) * bpp) + k]);
+
+          output[((j + (i * half_width)) * bpp) + k] = static_cast<uint8_t>((sum + 2) / 4);
         }
-        int32_t hold = 0;
       }
     }
   }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include <vector>
-#include <functional>
+#include <algorithm>
 
+// functions that return a new plane have an overload that writes into a caller provided one instead, so planes can
+// be allocated once and reused. the output has to hold the full result, element-wise functions may write in place
 namespace imageops {
   float mean (const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
   float mean (const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
@@ -17,25 +20,88 @@ namespace imageops {
   float max_channel_section_value(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, const uint32_t& x, const uint32_t& y, const uint32_t& local_width, const uint32_t& local_height);
   float channel_sum(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
   float channel_sum(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  // sum of squared deviations from the mean of integer values given their exact count, sum and sum of squares
+  double squared_deviation_sum(uint64_t count, uint64_t sum, uint64_t squared_sum);
   std::vector<float> element_add(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height);
+  void element_add(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_add(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height);
+  void element_add(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_subtract(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height);
+  void element_subtract(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_subtract(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height);
+  void element_subtract(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_multi(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height);
+  void element_multi(const uint8_t * image_data_channel_0, const uint8_t * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_multi(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height);
+  void element_multi(const float * image_data_channel_0, const float * image_data_channel_1, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_multi(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  void element_multi(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> element_divide(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  void element_divide(const float & scalar, const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> normalize_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  void normalize_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> constrained_normalize_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  void constrained_normalize_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<float> convert_int_to_float_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  void convert_int_to_float_channel(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<uint8_t> convert_float_to_int_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height);
+  void convert_float_to_int_channel(const float * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, std::span<uint8_t> output);
+  uint16_t float_to_half(float value);
+  float half_to_float(uint16_t value);
+  void convert_float_to_half(const float * input, uint16_t * output, size_t count);
+  void convert_half_to_float(const uint16_t * input, float * output, size_t count);
   std::vector<std::vector<uint8_t>> channel_split(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp);
+  void channel_split(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<const std::span<uint8_t>> image_channels);
+  void channel_split(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<const std::span<float>> image_channels); // bytes to float planes in one pass
   std::vector<std::vector<float>> channel_split(const float * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp);
+  void channel_split(const float * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<const std::span<float>> image_channels);
   std::vector<uint8_t> channel_combine(const std::vector<std::vector<uint8_t>> & image_channels, const uint32_t & image_width, const uint32_t & image_height);
+  void channel_combine(std::span<const std::span<const uint8_t>> image_channels, const uint32_t & image_width, const uint32_t & image_height, std::span<uint8_t> output);
   std::vector<float> channel_combine(const std::vector<std::vector<float>> & image_channels, const uint32_t & image_width, const uint32_t & image_height);
+  void channel_combine(std::span<const std::span<const float>> image_channels, const uint32_t & image_width, const uint32_t & image_height, std::span<float> output);
   std::vector<uint8_t> expand_to_n_channels(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & input_bpp, const uint8_t & output_bpp);
+  void expand_to_n_channels(const uint8_t * image_data_channel, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & input_bpp, const uint8_t & output_bpp, std::span<uint8_t> output);
+  std::vector<uint8_t> copy_section(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height);
+  void copy_section(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height, std::span<uint8_t> output);
+  std::vector<float> copy_section(const float * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height);
+  void copy_section(const float * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height, std::span<float> output);
+  std::vector<uint16_t> copy_section(const uint16_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height);
+  void copy_section(const uint16_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, const uint32_t & x, const uint32_t & y, const uint32_t & section_width, const uint32_t & section_height, std::span<uint16_t> output);
+  std::vector<uint8_t> downsample_half(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp);
+  void downsample_half(const uint8_t * image_data, const uint32_t & image_width, const uint32_t & image_height, const uint8_t & bpp, std::span<uint8_t> output);
 
-  void inplace_filter(const std::vector<float> & input_image, std::vector<float> & output_image, uint32_t x, uint32_t y, uint32_t local_width, uint32_t local_height, uint32_t image_width, uint32_t image_height, const std::function<float(const float &, const uint32_t &x, const uint32_t &y, void*)> &f, void* data);
+  // output[i] = f(input[i], state) for a contiguous row of count pixels
+  template <typename state_type, typename filter_function>
+  inline void row_filter(const float * input_row, float * output_row, size_t count, const state_type & state, filter_function && f)
+  {
+    for (size_t j=0; j<count; j++)
+    {
+      output_row[j] = f(input_row[j], state);
+    }
+  }
+
+  // applies f(value, state) to block (x, y) of a grid of local_width x local_height blocks. the block is clipped to
+  // the image once and then processed row by row
+  template <typename state_type, typename filter_function>
+  inline void block_filter(const float * input_image, float * output_image, uint32_t image_width, uint32_t image_height, uint32_t x, uint32_t y, uint32_t local_width, uint32_t local_height, const state_type & state, filter_function && f)
+  {
+    const size_t x0 = static_cast<size_t>(x) * local_width;
+    const size_t y0 = static_cast<size_t>(y) * local_height;
+
+    if ((x0 >= image_width) || (y0 >= image_height))
+    {
+      return;
+    }
+
+    const size_t x1 = std::min(x0 + local_width, static_cast<size_t>(image_width));
+    const size_t y1 = std::min(y0 + local_height, static_cast<size_t>(image_height));
+
+    for (size_t i=y0; i<y1; i++)
+    {
+      const size_t row_offset = (i * image_width) + x0;
+      row_filter(input_image + row_offset, output_image + row_offset, x1 - x0, state, f);
+    }
+  }
 
   enum class CONV_TYPE : uint16_t {SUM=0, MULT, MIN, MAX, FRAC, POW};
   float image_convolution(const std::vector<uint8_t> & source
@@ -0,0 +1,128 @@
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/testcheck.h"
+#include "imageops/colormodel.h"
+#include "imageops/imageops.h"
+#include "imageops/parallel.h"
+
+namespace {
+  // several reduction blocks with a partial last one
+  constexpr uint32_t image_width = 1000;
+  constexpr uint32_t image_height = 77;
+  constexpr size_t image_size = static_cast<size_t>(image_width) * image_height;
+
+  struct reductions
+  {
+    float mean_u8 = 0.0f;
+    float variance_u8 = 0.0f;
+    float sum_u8 = 0.0f;
+    float mean_f32 = 0.0f;
+    float variance_f32 = 0.0f;
+    float sum_f32 = 0.0f;
+    colormodel::cielab_statistics cielab_stats;
+
+    [[nodiscard]] bool same(const reductions & other) const
+    {
+      const auto & a = cielab_stats;
+      const auto & b = other.cielab_stats;
+      return (std::memcmp(&mean_u8, &other.mean_u8, sizeof(float)) == 0) && (std::memcmp(&variance_u8, &other.variance_u8, sizeof(float)) == 0)
+          && (std::memcmp(&sum_u8, &other.sum_u8, sizeof(float)) == 0) && (std::memcmp(&mean_f32, &other.mean_f32, sizeof(float)) == 0)
+          && (std::memcmp(&variance_f32, &other.variance_f32, sizeof(float)) == 0) && (std::memcmp(&sum_f32, &other.sum_f32, sizeof(float)) == 0)
+          && (a.count == b.count) && (std::memcmp(&a.l_sum, &b.l_sum, sizeof(double)) == 0) && (std::memcmp(&a.l_m2, &b.l_m2, sizeof(double)) == 0)
+          && (std::memcmp(&a.a_sum, &b.a_sum, sizeof(double)) == 0) && (std::memcmp(&a.b_sum, &b.b_sum, sizeof(double)) == 0);
+    }
+  };
+
+  reductions reduce(const std::vector<uint8_t> & channel, const std::vector<float> & plane, const std::vector<uint8_t> & rgba, size_t n_threads)
+  {
+    imageops::set_parallel_width(n_threads);
+
+    reductions r;
+    r.mean_u8 = imageops::mean(channel.data(), image_width, image_height);
+    r.variance_u8 = imageops::variance(channel.data(), image_width, image_height);
+    r.sum_u8 = imageops::channel_sum(channel.data(), image_width, image_height);
+    r.mean_f32 = imageops::mean(plane.data(), image_width, image_height);
+    r.variance_f32 = imageops::variance(plane.data(), image_width, image_height);
+    r.sum_f32 = imageops::channel_sum(plane.data(), image_width, image_height);
+    colormodel::convert_image_rgb_to_planar_cielab(rgba.data(), image_width, image_height, r.cielab_stats);
+
+    imageops::set_parallel_width(0);
+    return r;
+  }
+}
+
+int main()
+{
+  const auto rgba = testcheck::synthetic_frame(image_width, image_height);
+
+  std::vector<uint8_t> channel (image_size);
+  std::vector<float> plane (image_size);
+  for (size_t i=0; i<image_size; i++)
+  {
+    channel[i] = rgba[(i * 4) + 1];
+    plane[i] = static_cast<float>(rgba[(i * 4) + 2]) * 0.37f;
+  }
+
+  // the results do not depend on how many threads share the blocks
+  const reductions reference = reduce(channel, plane, rgba, 1);
+  for (const size_t n_threads : {2, 3, 5, 0})
+  {
+    testcheck::check(reduce(channel, plane, rgba, n_threads).same(reference), "reductions are bitwise equal with a parallel width of " + std::to_string(n_threads));
+  }
+
+  // nor on other threads reducing at the same time
+  std::vector<reductions> concurrent (4);
+  {
+    std::vector<std::jthread> threads;
+    for (size_t t=0; t<concurrent.size(); t++)
+    {
+      threads.emplace_back([&, t]() { concurrent[t] = reduce(channel, plane, rgba, t + 1); });
+    }
+  }
+
+  for (size_t t=0; t<concurrent.size(); t++)
+  {
+    testcheck::check(concurrent[t].same(reference), "reductions are bitwise equal from concurrent thread " + std::to_string(t));
+  }
+
+  // 8-bit sums are exact
+  uint64_t sum = 0;
+  uint64_t squares = 0;
+  for (const uint8_t value : channel)
+  {
+    sum += value;
+    squares += static_cast<uint64_t>(value) * value;
+  }
+
+  const double exact_mean = static_cast<double>(sum) / static_cast<double>(image_size);
+  const double exact_variance = (static_cast<double>(squares) / static_cast<double>(image_size)) - (exact_mean * exact_mean);
+  testcheck::check(reference.sum_u8 == static_cast<float>(sum), "8-bit channel sum is exact");
+  testcheck::check(reference.mean_u8 == static_cast<float>(exact_mean), "8-bit mean is exact");
+  testcheck::check(std::abs(reference.variance_u8 - exact_variance) <= (exact_variance * 1e-6), "8-bit variance matches the integer sums");
+
+  // a small spread on a large offset, the sum of squares minus the squared sum would cancel
+  std::vector<float> offset_plane (image_size);
+  double offset_sum = 0.0;
+  for (size_t i=0; i<image_size; i++)
+  {
+    offset_plane[i] = 4096.0f + (static_cast<float>(channel[i] % 8) * 0.0625f);
+    offset_sum += offset_plane[i];
+  }
+
+  const double offset_mean = offset_sum / static_cast<double>(image_size);
+  double offset_m2 = 0.0;
+  for (const float value : offset_plane)
+  {
+    offset_m2 += (value - offset_mean) * (value - offset_mean);
+  }
+
+  const double offset_variance = offset_m2 / static_cast<double>(image_size);
+  const float variance = imageops::variance(offset_plane.data(), image_width, image_height);
+  testcheck::check(variance >= 0.0f, "variance of a large offset is not negative");
+  testcheck::check(std::abs(variance - offset_variance) <= (offset_variance * 1e-4), "variance of a large offset matches the two pass reference");
+
+  return testcheck::result();
+}
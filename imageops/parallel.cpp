@@ -0,0 +1,110 @@
+#include "parallel.h"
+
+#include <atomic>
+#include <latch>
+#include <thread>
+#include <string>
+#include <algorithm>
+
+namespace {
+  const std::string pool_name = "imageops";
+  thread_local bool pool_thread = false;
+  thread_local size_t width_limit = 0;
+  thread_local cthreadpool::jobpriority job_priority = cthreadpool::jobpriority::normal;
+
+  cthreadpool::options pool_options;
+  std::atomic<bool> pool_created = false;
+
+  cthreadpool & worker_pool()
+  {
+    // intentionally never destroyed, the pool threads may still be waiting for jobs at exit
+    static auto * pool = []() {
+      pool_created = true;
+      return new cthreadpool(std::max(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(1)), pool_name, pool_options);
+    }();
+    return *pool;
+  }
+}
+
+namespace imageops {
+
+  size_t parallel_threads()
+  {
+    return worker_pool().numberofthreads();
+  }
+
+  void set_parallel_width(size_t n_threads)
+  {
+    width_limit = n_threads;
+  }
+
+  size_t parallel_width()
+  {
+    return (width_limit > 0) ? std::min(width_limit, parallel_threads()) : parallel_threads();
+  }
+
+  bool configure_parallel_pool(const cthreadpool::options & options)
+  {
+    if (pool_created)
+    {
+      return false;
+    }
+
+    pool_options = options;
+    return true;
+  }
+
+  void set_parallel_priority(cthreadpool::jobpriority priority)
+  {
+    job_priority = priority;
+  }
+
+  void parallel_for(size_t begin, size_t end, size_t min_chunk, const std::function<void(size_t, size_t)> & f)
+  {
+    if (end <= begin)
+    {
+      return;
+    }
+
+    const size_t count = end - begin;
+    const size_t max_chunks = (count + std::max(min_chunk, static_cast<size_t>(1)) - 1) / std::max(min_chunk, static_cast<size_t>(1));
+    const size_t n_chunks = pool_thread ? 1 : std::min(parallel_width(), max_chunks);
+
+    if (n_chunks <= 1)
+    {
+      f(begin, end);
+      return;
+    }
+
+    // the calling thread runs the last chunk itself
+    const size_t chunk_size = (count + n_chunks - 1) / n_chunks;
+    const size_t n_jobs = ((count + chunk_size - 1) / chunk_size) - 1;
+    std::latch done(static_cast<std::ptrdiff_t>(n_jobs));
+
+    auto make_chunk = [&f, &done, begin, chunk_size](size_t c) {
+      const size_t chunk_begin = begin + (c * chunk_size);
+      return [&f, &done, chunk_begin, chunk_end = chunk_begin + chunk_size]() {
+        pool_thread = true;
+        f(chunk_begin, chunk_end);
+        done.count_down();
+      };
+    };
+
+    // one batch per numa node (or one for the whole loop), the workers are woken once per batch
+    auto & pool = worker_pool();
+    const size_t n_nodes = pool.numberofnodes();
+    for (size_t first=0; first<n_jobs;)
+    {
+      const size_t node = (n_nodes > 1) ? ((first * n_nodes) / n_jobs) : cthreadpool::any_node;
+      const size_t last = (n_nodes > 1) ? std::min((((node + 1) * n_jobs) + n_nodes - 1) / n_nodes, n_jobs) : n_jobs;
+
+      pool.addjobs(last - first, [&make_chunk, first](size_t i) {
+        return make_chunk(first + i);
+      }, job_priority, node);
+      first = last;
+    }
+
+    f(begin + (n_jobs * chunk_size), end);
+    done.wait();
+  }
+}
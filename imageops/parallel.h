@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include "common/cthreadpool.h"
+
+namespace imageops {
+
+  // splits [begin, end) into at most one chunk per pool thread, each at least min_chunk items, and runs
+  // f(chunk_begin, chunk_end) for every chunk. returns once all chunks are done. calls made from a pool thread run
+  // inline so nested parallel loops can not deadlock the pool
+  void parallel_for(size_t begin, size_t end, size_t min_chunk, const std::function<void(size_t, size_t)> & f);
+  [[nodiscard]] size_t parallel_threads();
+
+  // limits the chunks of the parallel loops started by the calling thread, 0 lifts the limit. threads that process
+  // images side by side use it to share the pool instead of each splitting its loops over all of it
+  void set_parallel_width(size_t n_threads);
+  [[nodiscard]] size_t parallel_width();
+
+  // placement and priority of the pool threads, returns false once the first parallel loop has created the pool.
+  // with numa placement the chunks of a loop are handed to the nodes in order, so the same rows of a plane go to
+  // the same node in every loop
+  bool configure_parallel_pool(const cthreadpool::options & pool_options);
+
+  // queue priority of the chunks of the parallel loops started by the calling thread, interactive previews are
+  // taken by the pool before background full resolution work
+  void set_parallel_priority(cthreadpool::jobpriority priority);
+}
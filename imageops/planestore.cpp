@@ -0,0 +1,64 @@
+#include "planestore.h"
+
+#include <algorithm>
+
+#include "imageops.h"
+
+namespace imageops {
+
+  planestore::planestore(std::vector<float> && channel, bool half_precision)
+    : halfPrecision(half_precision)
+  {
+    if (halfPrecision)
+    {
+      halfValues.resize(channel.size());
+      convert_float_to_half(channel.data(), halfValues.data(), channel.size());
+    }
+    else
+    {
+      fullValues = std::move(channel);
+    }
+  }
+
+  bool planestore::halfprecision() const
+  {
+    return halfPrecision;
+  }
+
+  size_t planestore::size() const
+  {
+    return halfPrecision ? halfValues.size() : fullValues.size();
+  }
+
+  std::vector<float> planestore::channel() const
+  {
+    if (!halfPrecision)
+    {
+      return fullValues;
+    }
+
+    std::vector<float> values(halfValues.size());
+    convert_half_to_float(halfValues.data(), values.data(), halfValues.size());
+    return values;
+  }
+
+  std::vector<float> planestore::section(uint32_t image_width, uint32_t x, uint32_t y, uint32_t section_width, uint32_t section_height) const
+  {
+    std::vector<float> values(static_cast<size_t>(section_width) * section_height);
+
+    for (size_t i=0; i<section_height; i++)
+    {
+      const size_t offset = x + ((y + i) * image_width);
+      if (halfPrecision)
+      {
+        convert_half_to_float(halfValues.data() + offset, values.data() + (i * section_width), section_width);
+      }
+      else
+      {
+        std::copy_n(fullValues.data() + offset, section_width, values.data() + (i * section_width));
+      }
+    }
+
+    return values;
+  }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace imageops {
+
+  // float channel that is kept either in fp32 or in fp16 between the stages that use it. arithmetic always happens
+  // on fp32 values, half precision only halves the memory and bandwidth of the stored plane
+  class planestore
+  {
+    public:
+      planestore() = default;
+      planestore(std::vector<float> && channel, bool half_precision);
+
+      [[nodiscard]] bool halfprecision() const;
+      [[nodiscard]] size_t size() const;
+      [[nodiscard]] std::vector<float> channel() const;
+      [[nodiscard]] std::vector<float> section(uint32_t image_width, uint32_t x, uint32_t y, uint32_t section_width, uint32_t section_height) const;
+
+    private:
+      std::vector<float> fullValues;
+      std::vector<uint16_t> halfValues;
+      bool halfPrecision = false;
+  };
+}
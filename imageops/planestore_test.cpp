@@ -0,0 +1,67 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "common/testcheck.h"
+#include "imageops/planestore.h"
+#include "pipeline/pipeline.h"
+
+namespace {
+  constexpr uint32_t image_width = 150;
+  constexpr uint32_t image_height = 110;
+}
+
+int main()
+{
+  // a half keeps 11 significant bits, round to nearest gives at most half a unit of the last one
+  std::vector<float> channel (static_cast<size_t>(image_width) * image_height);
+  for (size_t i=0; i<channel.size(); i++)
+  {
+    channel[i] = -128.0f + (static_cast<float>(i % 25600) * 0.01f);
+  }
+
+  const imageops::planestore full (std::vector<float>(channel), false);
+  const imageops::planestore half (std::vector<float>(channel), true);
+  testcheck::check(!full.halfprecision() && half.halfprecision() && (half.size() == channel.size()), "planes keep the requested precision");
+  testcheck::check(full.channel() == channel, "fp32 planes are stored as they are");
+
+  const auto values = half.channel();
+  bool rounded = (values.size() == channel.size());
+  for (size_t i=0; rounded && (i<channel.size()); i++)
+  {
+    rounded = (std::abs(values[i] - channel[i]) <= (std::abs(channel[i]) * std::ldexp(1.0f, -11)));
+  }
+
+  testcheck::check(rounded, "fp16 planes round to the nearest half");
+
+  const auto section = half.section(image_width, 17, 9, 40, 30);
+  bool same_section = (section.size() == (40 * 30));
+  for (size_t i=0; same_section && (i<30); i++)
+  {
+    for (size_t j=0; j<40; j++)
+    {
+      same_section = same_section && (section[(i * 40) + j] == values[((i + 9) * image_width) + j + 17]);
+    }
+  }
+
+  testcheck::check(same_section, "sections of fp16 planes match the whole plane");
+
+  // the output with fp16 planes stays within 1 level of the fp32 output
+  const auto input = testcheck::synthetic_frame(image_width, image_height);
+  for (const auto mode : {pipeline::contrast_mode::block, pipeline::contrast_mode::interpolated, pipeline::contrast_mode::sliding_window})
+  {
+    pipeline::parameters params;
+    params.local_contrast_mode = mode;
+
+    pipeline::result expected;
+    pipeline::process(input, image_width, image_height, params, expected, false);
+
+    params.half_storage = true;
+    pipeline::result output;
+    pipeline::process(input, image_width, image_height, params, output, false);
+
+    testcheck::check(testcheck::max_difference(output.color_corrected_image, expected.color_corrected_image) <= 1, "fp16 output is within 1 level, contrast mode " + std::to_string(static_cast<int>(mode)));
+  }
+
+  return testcheck::result();
+}
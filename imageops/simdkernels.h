@@ -0,0 +1,242 @@
+// kernel bodies of imageops/cpudispatch.h. this file has no include guard, cpudispatch.cpp includes it once per
+// instruction set with KERNEL_TARGET set to the target attribute of that set. the loops are written so the compiler
+// can vectorize them, floating point operations stay in the order of the generic code
+
+namespace {
+
+  KERNEL_TARGET void unsharp_mask(const uint8_t * input, uint32_t image_width, uint32_t image_height, float unsharp_const, float * output)
+  {
+    // 1 2 1 in both directions divided by 16. the first row/column is repeated and the pixels past the last
+    // row/column are left out, like image_convolution does. the sums are small integers and the division is by a
+    // power of two, so they are exact in any order
+    constexpr float kernel_scale = 1.0f / 16.0f;
+    std::vector<int32_t> vertical (image_width);
+
+    for (size_t i=0; i<image_height; i++)
+    {
+      const uint8_t * above = input + ((i > 0) ? (i - 1) : 0) * image_width;
+      const uint8_t * row = input + (i * image_width);
+      float * output_row = output + (i * image_width);
+
+      if ((i + 1) < image_height)
+      {
+        const uint8_t * below = row + image_width;
+        for (size_t j=0; j<image_width; j++)
+        {
+          vertical[j] = static_cast<int32_t>(above[j]) + (2 * static_cast<int32_t>(row[j])) + static_cast<int32_t>(below[j]);
+        }
+      }
+      else
+      {
+        for (size_t j=0; j<image_width; j++)
+        {
+          vertical[j] = static_cast<int32_t>(above[j]) + (2 * static_cast<int32_t>(row[j]));
+        }
+      }
+
+      if (image_width == 1)
+      {
+        output_row[0] = unsharp_const * (static_cast<float>(row[0]) - (static_cast<float>(3 * vertical[0]) * kernel_scale));
+        continue;
+      }
+
+      output_row[0] = unsharp_const * (static_cast<float>(row[0]) - (static_cast<float>((3 * vertical[0]) + vertical[1]) * kernel_scale));
+
+      for (size_t j=1; j<(image_width - 1); j++)
+      {
+        const int32_t blur = vertical[j - 1] + (2 * vertical[j]) + vertical[j + 1];
+        output_row[j] = unsharp_const * (static_cast<float>(row[j]) - (static_cast<float>(blur) * kernel_scale));
+      }
+
+      const size_t last = image_width - 1;
+      output_row[last] = unsharp_const * (static_cast<float>(row[last]) - (static_cast<float>(vertical[last - 1] + (2 * vertical[last])) * kernel_scale));
+    }
+  }
+
+  // the channel count is a template argument so the inner loop is unrolled and the compiler can turn the strided
+  // loads and stores into shuffles. input and output types may differ, u8 pixels are split straight into float planes
+  template <size_t bpp, typename input_type, typename output_type>
+  KERNEL_TARGET void deinterleave_channels(const input_type * image, size_t pixel_count, output_type * const * channels)
+  {
+    std::array<output_type *, bpp> planes;
+    std::copy(channels, channels + bpp, planes.begin());
+    for (size_t i=0; i<pixel_count; i++)
+    {
+      for (size_t k=0; k<bpp; k++)
+      {
+        planes[k][i] = static_cast<output_type>(image[(i * bpp) + k]);
+      }
+    }
+  }
+
+  template <size_t bpp, typename value_type>
+  KERNEL_TARGET void interleave_channels(const value_type * const * channels, size_t pixel_count, value_type * image)
+  {
+    std::array<const value_type *, bpp> planes;
+    std::copy(channels, channels + bpp, planes.begin());
+    for (size_t i=0; i<pixel_count; i++)
+    {
+      for (size_t k=0; k<bpp; k++)
+      {
+        image[(i * bpp) + k] = planes[k][i];
+      }
+    }
+  }
+
+  template <typename input_type, typename output_type>
+  KERNEL_TARGET void deinterleave_any(const input_type * image, size_t pixel_count, uint32_t bpp, output_type * const * channels)
+  {
+    switch (bpp)
+    {
+      case 1:
+        return deinterleave_channels<1>(image, pixel_count, channels);
+      case 2:
+        return deinterleave_channels<2>(image, pixel_count, channels);
+      case 3:
+        return deinterleave_channels<3>(image, pixel_count, channels);
+      default:
+        return deinterleave_channels<4>(image, pixel_count, channels);
+    }
+  }
+
+  template <typename value_type>
+  KERNEL_TARGET void interleave_any(const value_type * const * channels, size_t pixel_count, uint32_t bpp, value_type * image)
+  {
+    switch (bpp)
+    {
+      case 1:
+        return interleave_channels<1>(channels, pixel_count, image);
+      case 2:
+        return interleave_channels<2>(channels, pixel_count, image);
+      case 3:
+        return interleave_channels<3>(channels, pixel_count, image);
+      default:
+        return interleave_channels<4>(channels, pixel_count, image);
+    }
+  }
+
+  KERNEL_TARGET void deinterleave(const uint8_t * image, size_t pixel_count, uint32_t bpp, uint8_t * const * channels)
+  {
+    deinterleave_any(image, pixel_count, bpp, channels);
+  }
+
+  KERNEL_TARGET void deinterleave_to_float(const uint8_t * image, size_t pixel_count, uint32_t bpp, float * const * channels)
+  {
+    deinterleave_any(image, pixel_count, bpp, channels);
+  }
+
+  KERNEL_TARGET void deinterleave_float(const float * image, size_t pixel_count, uint32_t bpp, float * const * channels)
+  {
+    deinterleave_any(image, pixel_count, bpp, channels);
+  }
+
+  KERNEL_TARGET void interleave(const uint8_t * const * channels, size_t pixel_count, uint32_t bpp, uint8_t * image)
+  {
+    interleave_any(channels, pixel_count, bpp, image);
+  }
+
+  KERNEL_TARGET void interleave_float(const float * const * channels, size_t pixel_count, uint32_t bpp, float * image)
+  {
+    interleave_any(channels, pixel_count, bpp, image);
+  }
+
+  // gray in the first bpp - 1 channels, the last one is opaque
+  template <size_t bpp>
+  KERNEL_TARGET void broadcast_channels(const uint8_t * gray, size_t pixel_count, uint8_t * image)
+  {
+    for (size_t i=0; i<pixel_count; i++)
+    {
+      for (size_t k=0; k<(bpp - 1); k++)
+      {
+        image[(i * bpp) + k] = gray[i];
+      }
+
+      image[(i * bpp) + bpp - 1] = std::numeric_limits<uint8_t>::max();
+    }
+  }
+
+  KERNEL_TARGET void broadcast_gray(const uint8_t * gray, size_t pixel_count, uint32_t bpp, uint8_t * image)
+  {
+    if constexpr (std::endian::native == std::endian::little)
+    {
+      // one 32 bit store per pixel, gray * 0x010101 puts the value in the three low bytes
+      if (bpp == 4)
+      {
+        for (size_t i=0; i<pixel_count; i++)
+        {
+          const uint32_t pixel = (static_cast<uint32_t>(gray[i]) * 0x00010101u) | 0xff000000u;
+          std::memcpy(image + (i * 4), &pixel, sizeof(pixel));
+        }
+
+        return;
+      }
+    }
+
+    switch (bpp)
+    {
+      case 2:
+        return broadcast_channels<2>(gray, pixel_count, image);
+      case 3:
+        return broadcast_channels<3>(gray, pixel_count, image);
+      default:
+        return broadcast_channels<4>(gray, pixel_count, image);
+    }
+  }
+
+  KERNEL_TARGET uint8_t min_value(const uint8_t * values, size_t count)
+  {
+    uint8_t value = std::numeric_limits<uint8_t>::max();
+    for (size_t i=0; i<count; i++)
+    {
+      value = (values[i] < value) ? values[i] : value;
+    }
+
+    return value;
+  }
+
+  KERNEL_TARGET uint8_t max_value(const uint8_t * values, size_t count)
+  {
+    uint8_t value = std::numeric_limits<uint8_t>::min();
+    for (size_t i=0; i<count; i++)
+    {
+      value = (values[i] > value) ? values[i] : value;
+    }
+
+    return value;
+  }
+
+  KERNEL_TARGET void add(const float * a, const float * b, float * output, size_t count)
+  {
+    for (size_t i=0; i<count; i++)
+    {
+      output[i] = a[i] + b[i];
+    }
+  }
+
+  KERNEL_TARGET void subtract(const float * a, const float * b, float * output, size_t count)
+  {
+    for (size_t i=0; i<count; i++)
+    {
+      output[i] = a[i] - b[i];
+    }
+  }
+
+  KERNEL_TARGET void multiply(const float * a, const float * b, float * output, size_t count)
+  {
+    for (size_t i=0; i<count; i++)
+    {
+      output[i] = a[i] * b[i];
+    }
+  }
+
+  KERNEL_TARGET void scale(const float * a, float scalar, float * output, size_t count)
+  {
+    for (size_t i=0; i<count; i++)
+    {
+      output[i] = a[i] * scalar;
+    }
+  }
+
+  constexpr kernel_table table = {unsharp_mask, deinterleave, deinterleave_to_float, deinterleave_float, interleave, interleave_float, broadcast_gray
+                                , min_value, max_value, add, subtract, multiply, scale};
+}
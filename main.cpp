@@ -4,6 +4,11 @@
 #include <vector>
 #include <tuple>
 #include <cstring>
+#include <algorithm>
+#include <memory>
+#include <iostream>
+#include <atomic>
+#include <csignal>
 
 #include <imgui.h>
 #include <imgui-SFML.h>
@@ -14,17 +19,49 @@
 #include <SFML/OpenGL.hpp>
 
 #include <spdlog/spdlog.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <CLI/CLI.hpp>
 
-#include "imageops/imageops.h"
-#include "imageops/imagefilters.h"
-#include "imageops/colormodel.h"
+#include "imageops/cpudispatch.h"
+#include "imageops/parallel.h"
+#include "pipeline/batchscheduler.h"
+#include "pipeline/pipeline.h"
+#include "pipeline/processservice.h"
+#include "pipeline/processworker.h"
+#include "pipeline/resultcache.h"
+#include "pipeline/stripio.h"
+#include "pipeline/strips.h"
 
 #define USE_ON_RESIZING true
 
-std::pair<std::vector<uint8_t>, float> redefine_algo(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel);
-std::vector<uint8_t> redefine(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float loss_limit);
-std::vector<uint8_t> attenuation_map_max(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel);
+namespace {
+  // the socket service runs until it is interrupted, stop() only stores atomics and shuts the listening socket down
+  std::atomic<processservice *> signalled_service = nullptr;
+
+  void stop_service(int)
+  {
+    if (processservice * service = signalled_service.load())
+    {
+      service->stop();
+    }
+  }
+
+  // --roi x,y,w,h clamped to an image of this size, an empty region without --roi
+  pipeline::region clamped_roi(const std::vector<uint32_t> & roi_values, uint32_t image_width, uint32_t image_height)
+  {
+    if ((roi_values.size() != 4) || (image_width == 0) || (image_height == 0))
+    {
+      return {};
+    }
+
+    pipeline::region roi;
+    roi.x = std::min(roi_values[0], image_width - 1);
+    roi.y = std::min(roi_values[1], image_height - 1);
+    roi.width = std::clamp(roi_values[2], 1u, image_width - roi.x);
+    roi.height = std::clamp(roi_values[3], 1u, image_height - roi.y);
+    return roi;
+  }
+}
 
 int main(int argc, char*argv[])
 {
@@ -52,21 +89,274 @@ int main(int argc, char*argv[])
   app.add_option("-e,--e", enhance_const, "image enhancement constant value");
 
   float k_const = 2.0f; // note papers uses a value of 2
-  app.add_option("-k,--k", k_const, "image enhancement constant value");
+  app.add_option("-k,--k", k_const, "guided filter detail gain");
 
   float v_const = 2.0f; // note papers uses a value of 2
-  app.add_option("-v,--v", v_const, "image enhancement constant value");
+  app.add_option("-v,--v", v_const, "guided filter edge threshold (L units)");
+
+  uint32_t guided_radius = 8;
+  app.add_option("--gf-r", guided_radius, "guided filter radius");
+
+  float attenuation_gamma = 1.2f;
+  app.add_option("-g,--gamma", attenuation_gamma, "attenuation map gamma (intensity of received light)");
+
+  std::string contrast_mode = "block";
+  app.add_option("--contrast-mode", contrast_mode, "local contrast statistics: block, interpolated or sliding")->check(CLI::IsMember({"block", "interpolated", "sliding"}));
+
+  bool half_storage = false;
+  app.add_flag("--fp16", half_storage, "keep the a, b and attenuation planes in half precision between the stages (output within 1 level), the planes are computed in fp32 first so the peak memory does not change");
+
+  bool fixed_point = false;
+  app.add_flag("--fixed", fixed_point, "use the 16-bit fixed point integer pipeline (faster, output within 2 levels of float from 64 up, dark values up to 8 levels)");
+
+  std::string cpu_level_name;
+  app.add_option("--cpu-level", cpu_level_name, "instruction set of the image kernels, default is the best supported: generic, sse2, avx2 or avx512")->check(CLI::IsMember({"generic", "sse2", "avx2", "avx512"}));
+
+  std::string thread_placement = "none";
+  app.add_option("--thread-placement", thread_placement, "placement of the image kernel threads: none, cores (pinned) or numa (spread over the nodes)")->check(CLI::IsMember({"none", "cores", "numa"}));
+
+  std::string thread_priority = "normal";
+  app.add_option("--thread-priority", thread_priority, "os priority of the image kernel threads: background, normal or interactive")->check(CLI::IsMember({"background", "normal", "interactive"}));
+
+  std::vector<uint32_t> roi_values;
+  app.add_option("--roi", roi_values, "only process the region x,y,w,h of the image: the first view of the window, the output of --strip-output and of --batch")->delimiter(',')->expected(4);
+
+  std::string strip_output_path;
+  app.add_option("--strip-output", strip_output_path, "process the image in strips without a window and write it to this file (.ppm, .pam or raw rgba)");
+
+  size_t memory_budget_mb = 1024;
+  app.add_option("--memory-budget", memory_budget_mb, "memory used per strip, or by the images of a batch at the same time, in MB");
+
+  std::vector<uint32_t> raw_size;
+  app.add_option("--raw-size", raw_size, "size WxH of a raw rgba input image (strip processing)")->delimiter('x')->expected(2);
+
+  std::string serve_path;
+  app.add_option("--serve", serve_path, "run as a service without a window, jobs are json lines read from this unix socket or from stdin when '-'");
+
+  size_t service_jobs = 2;
+  app.add_option("--jobs", service_jobs, "number of service jobs processed at the same time");
+
+  std::vector<std::string> batch_paths;
+  app.add_option("--batch", batch_paths, "process these images without a window, each is saved next to its input as <name>_color_corrected.png");
+
+  std::string cache_path;
+  app.add_option("--cache", cache_path, "keep the early stages of batch images in this directory, runs that only change -e, -k, -v, --gf-r, -b, --contrast-mode or --fp16 skip them");
 
   CLI11_PARSE(app, argc, argv)
 
-  // setup logger
+  if (!roi_values.empty() && !serve_path.empty())
+  {
+    spdlog::critical("--roi can not be used with --serve, give the roi of each job in its json line");
+    return 1;
+  }
+
+  // setup logger, stdout carries the results in the stream service mode so the log goes to stderr
+  if (serve_path == "-")
+  {
+    spdlog::set_default_logger(spdlog::stderr_color_mt("stderr"));
+  }
+
   constexpr uint32_t number_of_backtrace_logs = 32;
   spdlog::enable_backtrace(number_of_backtrace_logs);
 
+  imageops::cpu_level cpu_level = imageops::detected_cpu_level();
+  if (imageops::cpu_level_from_name(cpu_level_name, cpu_level))
+  {
+    cpu_level = imageops::set_cpu_level(cpu_level);
+  }
+  spdlog::info("image kernels: {} (detected {})", imageops::cpu_level_name(cpu_level), imageops::cpu_level_name(imageops::detected_cpu_level()));
+
+  cthreadpool::options pool_options;
+  if (thread_placement == "cores")
+  {
+    pool_options.threadplacement = cthreadpool::placement::cores;
+  }
+  else if (thread_placement == "numa")
+  {
+    pool_options.threadplacement = cthreadpool::placement::numa;
+  }
+
+  if (thread_priority == "background")
+  {
+    pool_options.threadpriority = cjthread::priority::background;
+  }
+  else if (thread_priority == "interactive")
+  {
+    pool_options.threadpriority = cjthread::priority::interactive;
+  }
+  imageops::configure_parallel_pool(pool_options);
+
+  pipeline::parameters params;
+  params.local_block_size = enhance_contrast_block_size;
+  params.sharp_const = sharp_const;
+  params.enhance_const = enhance_const;
+  params.k_const = k_const;
+  params.v_const = v_const;
+  params.guided_radius = guided_radius;
+  params.half_storage = half_storage;
+  params.arithmetic = fixed_point ? pipeline::arithmetic_mode::fixed_point : pipeline::arithmetic_mode::floating_point;
+  params.attenuation_gamma = attenuation_gamma;
+
+  if (contrast_mode == "interpolated")
+  {
+    params.local_contrast_mode = pipeline::contrast_mode::interpolated;
+  }
+  else if (contrast_mode == "sliding")
+  {
+    params.local_contrast_mode = pipeline::contrast_mode::sliding_window;
+  }
+
+  // gigapixel images are read and written in strips, the window is not needed for those
+
+  if (!strip_output_path.empty())
+  {
+    stripreader reader;
+    stripwriter writer;
+    const uint32_t raw_width = raw_size.empty() ? 0 : raw_size[0];
+    const uint32_t raw_height = raw_size.empty() ? 0 : raw_size[1];
+
+    if (!reader.open(image_file_path, raw_width, raw_height))
+    {
+      return 1;
+    }
+
+    const pipeline::region roi = clamped_roi(roi_values, reader.width(), reader.height());
+    if (!writer.open(strip_output_path, roi.empty() ? reader.width() : roi.width, roi.empty() ? reader.height() : roi.height))
+    {
+      return 1;
+    }
+
+    uint32_t reported_percent = 0;
+    const bool processed = pipeline::process_strips(reader, writer, params, memory_budget_mb * 1024 * 1024, roi, [&reported_percent](float value) {
+      const auto percent = static_cast<uint32_t>(value * 100.0f);
+      if (percent >= (reported_percent + 10))
+      {
+        reported_percent = percent;
+        spdlog::info("{}%", percent);
+      }
+
+      return true;
+    });
+
+    if (!processed)
+    {
+      spdlog::critical("strip processing failed: {}", strip_output_path);
+      return 1;
+    }
+
+    spdlog::info("exported: {}", strip_output_path);
+    return 0;
+  }
+
+  // batches pick per image between running side by side and splitting the image over several threads
+
+  if (!batch_paths.empty())
+  {
+    batchscheduler scheduler(params, memory_budget_mb * 1024 * 1024);
+    const std::unique_ptr<resultcache> cache = cache_path.empty() ? nullptr : std::make_unique<resultcache>(cache_path);
+    if (cache && !roi_values.empty())
+    {
+      spdlog::warn("the cache holds full frames, it is not used with --roi");
+    }
+
+    const size_t failed = scheduler.run(batch_paths.size(), [&](size_t index) -> bool {
+      const std::string & path = batch_paths[index];
+      sf::Image image;
+      if (!image.loadFromFile(path))
+      {
+        spdlog::warn("unable to load: {}", path);
+        return false;
+      }
+
+      const uint32_t width = image.getSize().x;
+      const uint32_t height = image.getSize().y;
+      const std::span<const uint8_t> pixels (image.getPixelsPtr(), static_cast<size_t>(width) * height * 4);
+      const pipeline::region roi = clamped_roi(roi_values, width, height);
+      pipeline::result output;
+      bool cached = false;
+
+      // the memory of the slot counts the rgba input and output, so it is held until the output is saved
+      batchscheduler::slot slot(scheduler, width, height);
+
+      bool processed = false;
+      if (!roi.empty())
+      {
+        pipeline::frame_statistics stats;
+        processed = pipeline::compute_frame_statistics(pixels, width, height, params, stats) && pipeline::process_region(pixels, width, height, stats, params, roi, output, false);
+      }
+      else
+      {
+        processed = (cache && cache->valid()) ? cache->process(pixels, width, height, params, output, &cached) : pipeline::process(pixels, width, height, params, output, false);
+      }
+
+      if (!processed)
+      {
+        spdlog::warn("processing failed: {}", path);
+        return false;
+      }
+
+      const std::string output_path = path.substr(0, path.find_last_of('.')) + "_color_corrected.png";
+      image.create(output.image_width, output.image_height, output.color_corrected_image.data());
+      if (!image.saveToFile(output_path))
+      {
+        spdlog::warn("unable to save: {}", output_path);
+        return false;
+      }
+
+      spdlog::info("exported: {} ({}x{}, {} threads{})", output_path, output.image_width, output.image_height, slot.threads(), cached ? ", cached" : "");
+      return true;
+    });
+
+    spdlog::info("batch done: {} of {} images", batch_paths.size() - failed, batch_paths.size());
+    return (failed == 0) ? 0 : 1;
+  }
+
+  // service mode keeps the process (pools, tables) alive between images, the images are loaded without a window
+
+  if (!serve_path.empty())
+  {
+    processservice service(params, service_jobs);
+    service.setimageio([](const std::string & path, std::vector<uint8_t> & pixels, uint32_t & width, uint32_t & height) -> bool {
+                         sf::Image image;
+                         if (!image.loadFromFile(path))
+                         {
+                           return false;
+                         }
+
+                         width = image.getSize().x;
+                         height = image.getSize().y;
+                         pixels.assign(image.getPixelsPtr(), image.getPixelsPtr() + (static_cast<size_t>(width) * height * 4));
+                         return true;
+                       }
+                      ,[](const std::string & path, const std::vector<uint8_t> & pixels, uint32_t width, uint32_t height) -> bool {
+                         sf::Image image;
+                         image.create(width, height, pixels.data());
+                         return image.saveToFile(path);
+                       });
+    service.warmup();
+
+    if (serve_path == "-")
+    {
+      return service.servestream(std::cin, std::cout) ? 0 : 1;
+    }
+
+    signalled_service = &service;
+    std::signal(SIGINT, stop_service);
+    std::signal(SIGTERM, stop_service);
+
+    const bool served = service.servesocket(serve_path);
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    signalled_service = nullptr;
+    return served ? 0 : 1;
+  }
+
   // load image file and checkerboard if image is not found
   sf::Image loaded_image;
 
   constexpr uint32_t loaded_image_margin = 16;
+  float display_scale = 1.0f;
 
   if (!image_file_path.empty())
   {
@@ -80,9 +370,14 @@ int main(int argc, char*argv[])
     else
     {
       // make the window twice as large of the original image and create pixels (margin) for some space
-      // between the original and processed image
-      window_width = (loaded_image.getSize().x * 2) + loaded_image_margin;
-      window_height = loaded_image.getSize().y + loaded_image_margin;
+      // between the original and processed image. large images are scaled down to fit on the desktop
+      const auto desktop_mode = sf::VideoMode::getDesktopMode();
+      display_scale = std::min({1.0f
+                               ,static_cast<float>(desktop_mode.width - loaded_image_margin) / static_cast<float>(loaded_image.getSize().x * 2)
+                               ,static_cast<float>(desktop_mode.height - loaded_image_margin) / static_cast<float>(loaded_image.getSize().y)});
+
+      window_width = static_cast<uint32_t>(static_cast<float>(loaded_image.getSize().x * 2) * display_scale) + loaded_image_margin;
+      window_height = static_cast<uint32_t>(static_cast<float>(loaded_image.getSize().y) * display_scale) + loaded_image_margin;
 
       spdlog::info("loaded!");
     }
@@ -140,316 +435,134 @@ int main(int argc, char*argv[])
   const uint32_t image_width = loaded_image.getSize().x;
   const uint32_t image_height = loaded_image.getSize().y;
 
-  std::vector<uint8_t> input_image (loaded_image.getPixelsPtr()
-                                   ,loaded_image.getPixelsPtr()+(image_width * image_height * bytes_per_pixel));
-
-  auto input_image_split = imageops::channel_split(input_image.data(), image_width, image_height, bytes_per_pixel);
-  auto input_image_split_red = imageops::convert_int_to_float_channel(input_image_split[0].data(), image_width, image_height);
-  auto input_image_split_green = imageops::convert_int_to_float_channel(input_image_split[1].data(), image_width, image_height);
-  auto input_image_split_blue = imageops::convert_int_to_float_channel(input_image_split[2].data(), image_width, image_height);
-
-  // generate redefined images based on mean of channels
-
-  constexpr float loss_limit = 1e-2f; // loss limit is set t0 10^(-2) as this gets us to the about the minimal amount of iterations needed for the redefine image channels to balance out
-  std::vector<uint8_t> combined_channels_corrected_image = input_image;
-  combined_channels_corrected_image = redefine(combined_channels_corrected_image, image_width, image_height, bytes_per_pixel, loss_limit);
-  auto combined_channels_corrected_image_split = imageops::channel_split(combined_channels_corrected_image.data(), image_width, image_height, bytes_per_pixel);
-
-  auto expanded_byte_redfine_mask_r = imageops::expand_to_n_channels(combined_channels_corrected_image_split[0].data(), image_width, image_height, 1, bytes_per_pixel);
-  auto expanded_byte_redfine_mask_g = imageops::expand_to_n_channels(combined_channels_corrected_image_split[1].data(), image_width, image_height, 1, bytes_per_pixel);
-  auto expanded_byte_redfine_mask_b = imageops::expand_to_n_channels(combined_channels_corrected_image_split[2].data(), image_width, image_height, 1, bytes_per_pixel);
+  auto input_image = std::make_shared<processworker::processimage>();
+  input_image->pixels.assign(loaded_image.getPixelsPtr()
+                            ,loaded_image.getPixelsPtr()+(image_width * image_height * bytes_per_pixel));
+  input_image->width = image_width;
+  input_image->height = image_height;
 
-  // generate attenuation channel (choose channel with the highest sum of pixel values)
+  // build preview levels down to the displayed size. the smallest level is used while parameters are being changed
+  // and the full resolution image is only processed once the parameters settle (or on export)
 
-  auto attenuation_channel = attenuation_map_max(input_image, image_width, image_height, bytes_per_pixel);
-  auto normalized_attenuation_channel = imageops::normalize_channel(attenuation_channel.data(), image_width, image_height);
-  auto expanded_attenuation_channel = imageops::expand_to_n_channels(attenuation_channel.data(), image_width, image_height, 1, bytes_per_pixel);
+  const auto display_width = static_cast<uint32_t>(static_cast<float>(image_width) * display_scale);
+  const auto display_height = static_cast<uint32_t>(static_cast<float>(image_height) * display_scale);
+  input_image->levels = pipeline::build_pyramid(input_image->pixels, image_width, image_height, display_width, display_height);
+  const auto preview_level = static_cast<uint32_t>(input_image->levels.size());
 
-  // generate detailed image (un-sharpen filter per channel)
+  spdlog::info("preview levels: {}", preview_level);
 
-  std::vector<std::vector<uint8_t>> rgb_detail_mask(3, std::vector<uint8_t>(image_width * image_height));
-  auto rgba_image_channels = imageops::channel_split(input_image.data(), image_width, image_height, bytes_per_pixel);
-  const float unsharp_const = sharp_const;
-  auto sharpen_mask_red = imagefilters::unsharpen_channel(rgba_image_channels[0], image_width, image_height, unsharp_const);
-  rgb_detail_mask[0] = imagefilters::constrain_filter_to_byte_map(sharpen_mask_red);
-
-  auto sharpen_mask_green = imagefilters::unsharpen_channel(rgba_image_channels[1], image_width, image_height, unsharp_const);
-  rgb_detail_mask[1] = imagefilters::constrain_filter_to_byte_map(sharpen_mask_green);
-
-  auto sharpen_mask_blue = imagefilters::unsharpen_channel(rgba_image_channels[2], image_width, image_height, unsharp_const);
-  rgb_detail_mask[2] = imagefilters::constrain_filter_to_byte_map(sharpen_mask_blue);
-
-  auto expanded_byte_sharpen_mask_red = imageops::expand_to_n_channels(rgb_detail_mask[0].data(), image_width, image_height, 1, bytes_per_pixel);
-  auto expanded_byte_sharpen_mask_green = imageops::expand_to_n_channels(rgb_detail_mask[1].data(), image_width, image_height, 1, bytes_per_pixel);
-  auto expanded_byte_sharpen_mask_blue = imageops::expand_to_n_channels(rgb_detail_mask[2].data(), image_width, image_height, 1, bytes_per_pixel);
-
-  // generate the Jaffe-McGlamey model --> J_c*t_c + A_c(1 - t_c), c E {R, G, B}
-  // I_fc = D_c + I_ct*A_max + I_c*(1 - A_max)
-
-  std::vector<float> neg_ones(image_width * image_height, 1.0f);
-  auto jm_model_one_minus_a = imageops::element_subtract(neg_ones.data(), normalized_attenuation_channel.data(), image_width, image_height);
-
-  auto combined_channels_corrected_image_split_red_float = imageops::convert_int_to_float_channel(combined_channels_corrected_image_split[0].data(), image_width, image_height);
-  auto jm_model_red_jt = imageops::element_multi(combined_channels_corrected_image_split_red_float.data(), normalized_attenuation_channel.data(), image_width, image_height);
-  auto jm_model_red_ai = imageops::element_multi(jm_model_one_minus_a.data(), input_image_split_red.data(), image_width, image_height);
-
-  auto combined_channels_corrected_image_split_green_float = imageops::convert_int_to_float_channel(combined_channels_corrected_image_split[1].data(), image_width, image_height);
-  auto jm_model_green_jt = imageops::element_multi(combined_channels_corrected_image_split_green_float.data(), normalized_attenuation_channel.data(), image_width, image_height);
-  auto jm_model_green_ai = imageops::element_multi(jm_model_one_minus_a.data(), input_image_split_green.data(), image_width, image_height);
-
-  auto combined_channels_corrected_image_split_blue_float = imageops::convert_int_to_float_channel(combined_channels_corrected_image_split[2].data(), image_width, image_height);
-  auto jm_model_blue_jt = imageops::element_multi(combined_channels_corrected_image_split_blue_float.data(), normalized_attenuation_channel.data(), image_width, image_height);
-  auto jm_model_blue_ai = imageops::element_multi(jm_model_one_minus_a.data(), input_image_split_blue.data(), image_width, image_height);
-
-  auto jm_model_red = imageops::element_add(imageops::element_add(jm_model_red_jt.data(), jm_model_red_ai.data(), image_width, image_height).data(), sharpen_mask_red.data(), image_width, image_height);
-  auto jm_model_green = imageops::element_add(imageops::element_add(jm_model_green_jt.data(), jm_model_green_ai.data(), image_width, image_height).data(), sharpen_mask_green.data(), image_width, image_height);
-  auto jm_model_blue = imageops::element_add(imageops::element_add(jm_model_blue_jt.data(), jm_model_blue_ai.data(), image_width, image_height).data(), sharpen_mask_blue.data(), image_width, image_height);
-
-  auto byte_jm_model_red = imagefilters::constrain_filter_to_byte_map(jm_model_red);
-  auto byte_jm_model_green = imagefilters::constrain_filter_to_byte_map(jm_model_green);
-  auto byte_jm_model_blue = imagefilters::constrain_filter_to_byte_map(jm_model_blue);
-
-  std::vector<std::vector<uint8_t>> jm_model_channels(4);
-  jm_model_channels[0] = byte_jm_model_red;
-  jm_model_channels[1] = byte_jm_model_green;
-  jm_model_channels[2] = byte_jm_model_blue;
-  jm_model_channels[3] = rgba_image_channels[3];
+  std::string image_file_path_base = image_file_path.substr(0, image_file_path.find_last_of('.'));
 
-  auto jm_model_color_corrected_image = imageops::channel_combine(jm_model_channels, image_width, image_height);
+  // process the image in the background so the window stays responsive. the worker thread will save the
+  // images when an export is requested, the render loop only picks up the latest result
 
-  // convert from rgb to cie-lab
+  processworker worker;
+  worker.setinput(input_image);
+  worker.setoncomplete([&image_file_path_base, image_width, image_height](const processworker::processresult & result) {
+    if (!result.exportrequested)
+    {
+      return;
+    }
 
-  auto cielab_color_corrected_image = colormodel::convert_image_rgb_to_cielab(jm_model_color_corrected_image, image_width, image_height);
-  auto cielab_color_corrected_image_split = imageops::channel_split(cielab_color_corrected_image.data(), image_width, image_height, bytes_per_pixel);
+    const uint32_t result_width = result.output.image_width;
+    const uint32_t result_height = result.output.image_height;
 
-  auto channel_l = imageops::convert_float_to_int_channel(imageops::element_multi(255.0f, imageops::constrained_normalize_channel(cielab_color_corrected_image_split[0].data(), image_width, image_height).data(), image_width, image_height).data(), image_width, image_height);
-  auto byte_cielab_l_channel = imageops::expand_to_n_channels(channel_l.data(), image_width, image_height, 1, bytes_per_pixel);
+    std::string export_file_path_base = image_file_path_base;
+    if (!(result.region == pipeline::region{0, 0, image_width, image_height}))
+    {
+      export_file_path_base += "_roi_" + std::to_string(result.region.x) + "_" + std::to_string(result.region.y) + "_" + std::to_string(result.region.width) + "_" + std::to_string(result.region.height);
+    }
 
-  // created integral image (summed-area table)
+    sf::Image export_image_parts;
+    export_image_parts.create(result_width, result_height);
+    for (const auto & [suffix, image_part] : result.output.image_parts)
+    {
+      std::memcpy((void *) export_image_parts.getPixelsPtr(), image_part.data(), result_width * result_height * bytes_per_pixel);
+      export_image_parts.saveToFile(export_file_path_base + suffix + ".png");
+    }
 
-  const uint32_t local_block_size = enhance_contrast_block_size;
-  auto cielab_cc_integral_image = imagefilters::integral_image_map(cielab_color_corrected_image_split[0], image_width, image_height);
-  auto cielab_cc_squared_integral_image = imagefilters::integral_square_image_map(cielab_color_corrected_image_split[0], image_width, image_height);
+    sf::Image image_result;
+    image_result.create(result_width, result_height, result.output.color_corrected_image.data());
 
-  float mv = imageops::max_channel_value(cielab_cc_integral_image.data(), image_width, image_height);
-  auto nm_ii = imageops::element_divide(mv, cielab_cc_integral_image.data(), image_width, image_height);
-  float max_int = 255.0f;
-  auto nm_ii_int = imageops::element_multi(max_int, nm_ii.data(), image_width, image_height);
-  auto byte_nm_ii_int = imageops::convert_float_to_int_channel(nm_ii_int.data(), image_width, image_height);
-  auto rgba_byte_nm_ii_int = imageops::expand_to_n_channels(byte_nm_ii_int.data(), image_width, image_height, 1, 4);
+    std::string color_corrected_image_file_path = export_file_path_base + "_color_corrected.png";
+    image_result.saveToFile(color_corrected_image_file_path);
 
-  float cielab_cc_global_var = imageops::variance(cielab_color_corrected_image_split[0].data(), image_width, image_height);
+    spdlog::info("exported: {}", color_corrected_image_file_path);
+  });
 
-  // create enhance contrast map
+  // visible part of the image. when zoomed in only the visible region is processed (at full resolution)
 
-  const auto block_y = static_cast<size_t>(std::ceil(image_height / local_block_size)) + 1;
-  const auto block_x = static_cast<size_t>(std::ceil(image_width / local_block_size)) + 1;
+  const pipeline::region full_frame_region = {0, 0, image_width, image_height};
+  pipeline::region view_region = full_frame_region;
+  float zoom = 1.0f;
+  float zoom_center_x = 0.5f;
+  float zoom_center_y = 0.5f;
 
-  std::vector<float> enhance_cie_l (image_width * image_height, 0.0f);
-  std::vector<float> enhance_cie_l_gf (image_width * image_height, 0.0f);
-  for (size_t i=0; i<block_y; i++)
+  if (const pipeline::region roi = clamped_roi(roi_values, image_width, image_height); !roi.empty() && !input_image->pixels.empty())
   {
-    for (size_t j=0; j<block_x; j++)
-    {
-      float cielab_cc_local_mean = imagefilters::integral_image_map_local_block_mean(cielab_cc_integral_image, image_width, image_height, j * local_block_size, i * local_block_size, local_block_size, local_block_size);
-      float cielab_cc_local_var = imagefilters::integral_image_map_local_block_variance(cielab_cc_squared_integral_image, cielab_cc_integral_image, image_width, image_height, j * local_block_size, i * local_block_size, local_block_size, local_block_size);
-      float cielab_cc_local_min = imageops::min_channel_section_value(cielab_color_corrected_image_split[0].data(), image_width, image_height, i, j, local_block_size, local_block_size);
-      float cielab_cc_local_max = imageops::max_channel_section_value(cielab_color_corrected_image_split[0].data(), image_width, image_height, i, j, local_block_size, local_block_size);
-      std::tuple<float, float, float, float, float> mean_var_gvar_min_max = {cielab_cc_local_mean, cielab_cc_local_var, cielab_cc_global_var, cielab_cc_local_min, cielab_cc_local_max};
-
-      auto calc_function = [e_c = enhance_const](const float & source_value, const uint32_t &x, const uint32_t &y, void* data) -> float {
-
-        auto [mean, var, gvar, m_min, m_max] = *reinterpret_cast<std::tuple<float, float, float, float, float>*>(data);
-        const float beta = e_c;
-        float var_ratio = (gvar / var);
-        float enhance_const = (var_ratio < beta) ? var_ratio : beta;
+    view_region = roi;
+    zoom = std::min(static_cast<float>(image_width) / static_cast<float>(view_region.width), static_cast<float>(image_height) / static_cast<float>(view_region.height));
+    zoom_center_x = (static_cast<float>(view_region.x) + (static_cast<float>(view_region.width) / 2.0f)) / static_cast<float>(image_width);
+    zoom_center_y = (static_cast<float>(view_region.y) + (static_cast<float>(view_region.height) / 2.0f)) / static_cast<float>(image_height);
 
+    spdlog::info("region of interest: {},{} {}x{}", view_region.x, view_region.y, view_region.width, view_region.height);
+  }
 
-        float output_value = mean + (enhance_const * (source_value - mean));
-        output_value = std::clamp(output_value, 0.0f, 100.0f);
+  auto zoomed_region = [&]() -> pipeline::region {
+    const auto view_width = std::clamp(static_cast<uint32_t>(static_cast<float>(image_width) / zoom), 1u, image_width);
+    const auto view_height = std::clamp(static_cast<uint32_t>(static_cast<float>(image_height) / zoom), 1u, image_height);
+    const auto view_x = std::clamp(static_cast<int32_t>((zoom_center_x * static_cast<float>(image_width)) - (static_cast<float>(view_width) / 2.0f)), 0, static_cast<int32_t>(image_width - view_width));
+    const auto view_y = std::clamp(static_cast<int32_t>((zoom_center_y * static_cast<float>(image_height)) - (static_cast<float>(view_height) / 2.0f)), 0, static_cast<int32_t>(image_height - view_height));
 
-        return output_value;
+    return {static_cast<uint32_t>(view_x), static_cast<uint32_t>(view_y), view_width, view_height};
+  };
 
-      };
+  constexpr float parameter_settle_time = 0.5f; // seconds without changes before processing at full resolution
+  sf::Clock settle_clock;
+  bool full_resolution_pending = false;
+  bool export_pending = false;
 
-      imageops::inplace_filter(cielab_color_corrected_image_split[0]
-                              ,enhance_cie_l
-                              ,j
-                              ,i
-                              ,local_block_size
-                              ,local_block_size
-                              ,image_width
-                              ,image_height
-                              ,calc_function
-                              ,&mean_var_gvar_min_max);
+  auto request_processing = [&](bool export_parts) {
+    if ((preview_level > 0) && (view_region == full_frame_region))
+    {
+      worker.request(params, false, preview_level);
+      full_resolution_pending = true;
+      export_pending = export_pending || export_parts;
+      settle_clock.restart();
     }
-  }
-
-  // guided filter
-
-  for (size_t i=0; i<block_y; i++)
-  {
-    for (size_t j=0; j<block_x; j++)
+    else
     {
-      float local_min = imageops::min_channel_section_value(enhance_cie_l.data(), image_width, image_height, j, i, local_block_size, local_block_size);
-      float local_max = imageops::max_channel_section_value(enhance_cie_l.data(), image_width, image_height, j, i, local_block_size, local_block_size);
-      auto local_min_max = std::make_pair(local_min, local_max);
-
-      auto calc_function22 = [kc = k_const, vc = v_const, ov = cielab_color_corrected_image_split[0]](const float & source_value, const uint32_t &x, const uint32_t &y, void* data) -> float {
-
-        auto [min_val, max_val] = (*(reinterpret_cast<std::pair<float,float>*>(data)));
-
-        float val_norm = (source_value - max_val) / (max_val - min_val);
-        //float output_value = (kc * val_norm + vc) * 100.0f;
-        //float output_value = std::clamp((kc * val_norm + vc) * 255.0f, 0.0f, 255.0f);
-
-        float guided_filter = (kc * val_norm + vc);
-        float output_value = guided_filter;
-        //float output_value = std::pow(((kc * val_norm + vc) - guided_filter), 2.0f);
-        //float output_value = std::clamp(std::pow(((kc * guided_filter + vc) - (ov[x + y] / 100.0f)), 2.0f) * 1.0f, 0.0f, 255000.0f);
-        //float output_value = std::pow(((kc * guided_filter + vc) - val_norm), 2.0f);
-        //float output_value = std::clamp(std::pow(((kc * guided_filter + vc) - val_norm), 2.0f), 0.0f, 1.0f);
-
-        output_value = output_value * (max_val - min_val) + max_val;
-        output_value = std::clamp(output_value, 0.0f, 100.0f);
-
-        return output_value;
-
-      };
-
-      imageops::inplace_filter(enhance_cie_l
-          ,enhance_cie_l_gf
-          ,j
-          ,i
-          ,local_block_size
-          ,local_block_size
-          ,image_width
-          ,image_height
-          ,calc_function22
-          ,&local_min_max);
+      worker.request(params, export_parts, 0, view_region);
+      full_resolution_pending = false;
     }
-  }
-
-  //std::vector<float> l_norm = imageops::constrained_normalize_channel(enhance_cie_l.data(), image_width, image_height);
-  //cielab_color_corrected_image_split[0] = enhance_cie_l; // update L channel with enhance results
-  cielab_color_corrected_image_split[0] = enhance_cie_l_gf; // update L channel with enhance results
+  };
 
-  //auto byte_enhance_cie_l_gf = imageops::convert_float_to_int_channel(enhance_cie_l_gf.data(), image_width, image_height);
-  //auto rgba_enhance_cie_l_gf = imageops::expand_to_n_channels(byte_enhance_cie_l_gf.data(), image_width, image_height, 1, bytes_per_pixel);
-
-  auto constrain_enhance_cie_l_gf = imageops::convert_float_to_int_channel(imageops::element_multi(255.0f, imageops::constrained_normalize_channel(enhance_cie_l_gf.data(), image_width, image_height).data(), image_width, image_height).data(), image_width, image_height);
-  auto rgba_enhance_cie_l_gf = imageops::expand_to_n_channels(constrain_enhance_cie_l_gf.data(), image_width, image_height, 1, bytes_per_pixel);
-
-
-  auto constrain_enhance_cie_l = imageops::convert_float_to_int_channel(imageops::element_multi(255.0f, imageops::constrained_normalize_channel(enhance_cie_l.data(), image_width, image_height).data(), image_width, image_height).data(), image_width, image_height);
-  auto rgba_enhance_cie_l = imageops::expand_to_n_channels(constrain_enhance_cie_l.data(), image_width, image_height, 1, bytes_per_pixel);
-
-  // create guided normalized image
-
-  // TODO: guide image
-  /*
-  for(size_t i=0; i<image_height; i++)
+  if (!input_image->pixels.empty())
   {
-    for (size_t j=0; j<image_width; j++)
-    {
-      l_norm[j + (i * image_width)] = (k_const * (l_norm[j + (i * image_width)]))  + v_const;
-      cielab_color_corrected_image_split[0][j + (i * image_width)] += l_norm[j + (i * image_width)];
-    }
+    request_processing(true);
   }
-  */
-
-  // color balance a and b channels
 
-  auto channel_a = cielab_color_corrected_image_split[1];
-  auto channel_b = cielab_color_corrected_image_split[2];
-  float channel_a_max = imageops::max_channel_value(channel_a.data(), image_width, image_height);
-  float channel_b_max = imageops::max_channel_value(channel_b.data(), image_width, image_height);
+  // results are streamed straight from the output buffer into persistent textures. full resolution results
+  // only update their region of the frame texture, previews replace the smaller preview texture
 
-  for (size_t i=0; i<channel_a.size(); i++)
-  {
-    channel_a[i] /= channel_a_max;
-    channel_b[i] /= channel_b_max;
-  }
+  sf::Texture texture_result;
+  sf::Texture texture_preview;
+  sf::Sprite result_plane;
+  pipeline::region result_region;
+  uint32_t result_scale = 1;
+  bool has_result = false;
 
-  for (size_t k=0; k<1; k++)
+  if (!input_image->pixels.empty())
   {
-    float cei_a_mean = imageops::mean(channel_a.data(), image_width, image_height);
-    float cei_b_mean = imageops::mean(channel_b.data(), image_width, image_height);
-
-    float cei_ab_ratio = ((cei_a_mean - cei_b_mean) / (cei_b_mean + cei_a_mean)) * 0.25f;
-    float cei_ba_ratio = ((cei_b_mean - cei_a_mean) / (cei_a_mean + cei_b_mean)) * 0.25f;
+    texture_result.create(image_width, image_height);
 
-    for(size_t i=0; i<image_height; i++)
+    if (preview_level > 0)
     {
-      for (size_t j=0; j<image_width; j++)
-      {
-        float cie_b_value = cielab_color_corrected_image_split[2][j + (i * image_width)];
-        float cie_a_value = cielab_color_corrected_image_split[1][j + (i * image_width)];
-
-        if (cei_a_mean > cei_b_mean)
-        {
-          float new_cei_b_value = cie_b_value + (cei_ab_ratio * cie_b_value);
-          cielab_color_corrected_image_split[2][j + (i * image_width)] = new_cei_b_value;
-        }
-
-        if (cei_a_mean < cei_b_mean)
-        {
-          float new_cei_a_value = cie_a_value + (cei_ba_ratio * cie_a_value);
-          cielab_color_corrected_image_split[1][j + (i * image_width)] = new_cei_a_value;
-        }
-      }
+      const auto & level = input_image->levels[preview_level - 1];
+      texture_preview.create(level.image_width, level.image_height);
     }
   }
 
-  // show original and resultant image
-
-  auto combine_cielab_color_corrected_image = imageops::channel_combine(cielab_color_corrected_image_split, image_width, image_height);
-  auto combine_cielab_color_corrected_image_rgba_convert = colormodel::convert_image_cielab_to_rgb(  combine_cielab_color_corrected_image, image_width, image_height);
-
-  std::string image_file_path_base = image_file_path.substr(0, image_file_path.find_last_of('.'));
-
-  sf::Image export_image_parts;
-  export_image_parts.create(image_width, image_height);
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_byte_redfine_mask_r.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_redefine_r.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_byte_redfine_mask_g.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_redefine_g.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_byte_redfine_mask_b.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_redefine_b.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_byte_sharpen_mask_red.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_detail_map_r.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_byte_sharpen_mask_green.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_detail_map_g.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_byte_sharpen_mask_blue.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_detail_map_b.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), expanded_attenuation_channel.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_max_attenuation.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), jm_model_color_corrected_image.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_color_transfer.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), rgba_byte_nm_ii_int.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_integral_map.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), byte_cielab_l_channel.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_cielab_channel_L.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), rgba_enhance_cie_l.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_local_contrast.png");
-  std::memcpy((void *) export_image_parts.getPixelsPtr(), rgba_enhance_cie_l_gf.data(), image_width * image_height * bytes_per_pixel);
-  export_image_parts.saveToFile(image_file_path_base + "_guided_filter.png");
-
-  //byte_cielab_l_channel
-  sf::Image image_result;
-  image_result.create(image_width, image_height, combine_cielab_color_corrected_image_rgba_convert.data());
-  //image_result.create(image_width, image_height, rgba_enhance_cie_l_gf.data()); //
-  //image_result.create(image_width, image_height, rgba_enhance_cie_l.data()); //
-
-  std::string color_corrected_image_file_path = image_file_path.substr(0, image_file_path.find_last_of('.'));
-  color_corrected_image_file_path = image_file_path_base + "_color_corrected.png";
-  image_result.saveToFile(color_corrected_image_file_path);
-
-  sf::Texture texture_result;
-  texture_result.loadFromImage(image_result);
-  sf::Sprite result_plane(texture_result);
-  result_plane.setPosition(static_cast<float>(loaded_image.getSize().x), loaded_image_margin / 2.0f);
-
   while (window.isOpen())
   {
     ImGui::SFML::Update(window, delta_clock.restart());
@@ -470,170 +583,131 @@ int main(int argc, char*argv[])
       }
     }
 
-    // Render
-    constexpr uint32_t cornflower_color = 0x9ACEEB;
-    window.clear(sf::Color(cornflower_color));
+    // pick up the latest finished result from the worker
 
-    if (loaded_image.getSize() != sf::Vector2u(0,0))
+    if (auto result = worker.takeresult())
     {
-      window.draw(loaded_image_plane);
+      const auto & output = result->output;
+      sf::Texture & texture = (result->scale > 1) ? texture_preview : texture_result;
+
+      if ((output.image_region.x + output.image_width <= texture.getSize().x) && (output.image_region.y + output.image_height <= texture.getSize().y))
+      {
+        texture.update(output.color_corrected_image.data(), output.image_width, output.image_height, output.image_region.x, output.image_region.y);
+        result_plane.setTexture(texture);
+        result_plane.setTextureRect(sf::IntRect(static_cast<int>(output.image_region.x), static_cast<int>(output.image_region.y), static_cast<int>(output.image_width), static_cast<int>(output.image_height)));
+        result_region = {output.image_region.x * result->scale, output.image_region.y * result->scale, output.image_width * result->scale, output.image_height * result->scale};
+        result_scale = result->scale;
+        has_result = true;
+      }
     }
 
-    if (image_result.getSize() != sf::Vector2u(0,0))
+    if (full_resolution_pending && (settle_clock.getElapsedTime().asSeconds() >= parameter_settle_time))
     {
-      window.draw(result_plane);
+      worker.request(params, export_pending, 0, view_region);
+      full_resolution_pending = false;
+      export_pending = false;
     }
 
-    ImGui::SFML::Render(window);
-
-    window.display();
-  }
+    // parameters ui
 
-  ImPlot::DestroyContext();
-  ImGui::SFML::Shutdown();
+    if (!input_image->pixels.empty())
+    {
+      ImGui::Begin("parameters");
 
-  spdlog::info("application done!");
+      pipeline::parameters ui_params = params;
 
-  return 0;
-}
+      int block_size = static_cast<int>(ui_params.local_block_size);
+      if (ImGui::SliderInt("block size", &block_size, 4, 256))
+      {
+        ui_params.local_block_size = static_cast<uint32_t>(block_size);
+      }
 
-std::pair<std::vector<uint8_t>, float> redefine_algo(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel)
-{
-  auto rgba_image_channels = imageops::channel_split(input_image.data(), image_width, image_height, bytes_per_pixel);
+      ImGui::SliderFloat("sharp", &ui_params.sharp_const, 0.0f, 4.0f);
+      ImGui::SliderFloat("enhance", &ui_params.enhance_const, 0.0f, 8.0f);
+      ImGui::SliderFloat("k", &ui_params.k_const, 0.0f, 8.0f);
+      ImGui::SliderFloat("v", &ui_params.v_const, 0.0f, 8.0f);
 
-  float red_channel_mean = imageops::mean(rgba_image_channels[0].data(), image_width, image_height);
-  float green_channel_mean = imageops::mean(rgba_image_channels[1].data(), image_width, image_height);
-  float blue_channel_mean = imageops::mean(rgba_image_channels[2].data(), image_width, image_height);
+      int guided_radius_value = static_cast<int>(ui_params.guided_radius);
+      if (ImGui::SliderInt("guided radius", &guided_radius_value, 1, 64))
+      {
+        ui_params.guided_radius = static_cast<uint32_t>(guided_radius_value);
+      }
+      ImGui::SliderFloat("gamma", &ui_params.attenuation_gamma, 0.1f, 4.0f);
 
-  std::map<float, std::vector<uint8_t>> mean_channel_order;
-  mean_channel_order[red_channel_mean] = rgba_image_channels[0];
-  mean_channel_order[green_channel_mean] = rgba_image_channels[1];
-  mean_channel_order[blue_channel_mean] = rgba_image_channels[2];
+      const char * contrast_modes[] = {"block", "interpolated", "sliding window"};
+      int contrast_mode_index = static_cast<int>(ui_params.local_contrast_mode);
+      if (ImGui::Combo("contrast", &contrast_mode_index, contrast_modes, 3))
+      {
+        ui_params.local_contrast_mode = static_cast<pipeline::contrast_mode>(contrast_mode_index);
+      }
 
-  float loss = std::numeric_limits<float>::max();
-  float loss_1 = std::numeric_limits<float>::max();
-  float loss_2 = std::numeric_limits<float>::max();
+      bool fixed_point_value = (ui_params.arithmetic == pipeline::arithmetic_mode::fixed_point);
+      if (ImGui::Checkbox("fixed point", &fixed_point_value))
+      {
+        ui_params.arithmetic = fixed_point_value ? pipeline::arithmetic_mode::fixed_point : pipeline::arithmetic_mode::floating_point;
+      }
 
-  size_t r_index = 0, g_index = 0, b_index = 0;
+      bool view_changed = ImGui::SliderFloat("zoom", &zoom, 1.0f, 16.0f);
+      view_changed = ImGui::SliderFloat("zoom x", &zoom_center_x, 0.0f, 1.0f) || view_changed;
+      view_changed = ImGui::SliderFloat("zoom y", &zoom_center_y, 0.0f, 1.0f) || view_changed;
 
-  std::vector<float> lms_mean;
-  std::vector<std::pair<float, float>> lms_minmax;
-  std::vector<std::vector<uint8_t>> lms_channels(3);
-  size_t index = 3;
-  for (auto [key, value] : mean_channel_order)
-  {
-    auto min_value = imageops::min_channel_value(value.data(), image_width, image_height);
-    auto max_value = imageops::max_channel_value(value.data(), image_width, image_height);
+      if (view_changed)
+      {
+        view_region = (zoom > 1.0f) ? zoomed_region() : full_frame_region;
+      }
 
-    lms_minmax.insert(lms_minmax.begin(), {min_value, max_value});
-    lms_mean.insert(lms_mean.begin(), key);
-    lms_channels.insert(lms_channels.begin(), value);
+      if (!(ui_params == params) || view_changed)
+      {
+        params = ui_params;
+        request_processing(false);
+      }
 
-    if (key == red_channel_mean)
-    {
-      r_index = index-- - 1;
-    }
+      ImGui::ProgressBar(worker.busy() ? worker.progress() : 1.0f);
 
-    if (key == green_channel_mean)
-    {
-      g_index = index-- - 1;
-    }
+      if (ImGui::Button("export"))
+      {
+        worker.request(params, true, 0, view_region);
+        full_resolution_pending = false;
+        export_pending = false;
+      }
 
-    if (key == blue_channel_mean)
-    {
-      b_index = index-- - 1;
+      ImGui::End();
     }
-  }
-
-  // create correct image for each channel
-  // calculate the loss values
-  // find loss_color
-
-  std::vector<std::vector<uint8_t>> corrected_lms_channel(3, std::vector<uint8_t>(image_width*image_height));
-
-  constexpr float image_min_0 = 0.0f;
-  constexpr float image_max_0 = 255.0f;
-  for (size_t i=0; i<(image_width*image_height); i++)
-  {
-    const float range_minmax = ((image_max_0 - image_min_0) / (lms_minmax[0].second - lms_minmax[0].first));
-    const float range = static_cast<float>(lms_channels[0][i]) - static_cast<float>(lms_minmax[0].first);
-    float l_value = std::clamp(image_min_0 + (range * range_minmax), 0.0f, 255.0f);
-    corrected_lms_channel[0][i] = static_cast<uint8_t>(l_value);
-  }
 
-  for (size_t i=0; i<(image_width*image_height); i++)
-  {
-    auto m_value = std::clamp(static_cast<float>(lms_channels[1][i]) + ((lms_mean[0] - lms_mean[1]) / 255.0f) * static_cast<float>(lms_channels[0][i]), 0.0f, 255.0f);
-    corrected_lms_channel[1][i] = static_cast<uint8_t>(m_value);
-  }
-
-  for (size_t i=0; i<(image_width*image_height); i++)
-  {
-    auto s_value = std::clamp(static_cast<float>(lms_channels[2][i]) + ((lms_mean[1] - lms_mean[2]) / 255.0f) * static_cast<float>(lms_channels[1][i]), 0.0f, 255.0f);
-    corrected_lms_channel[2][i] = static_cast<uint8_t>(s_value);
-  }
-
-  loss_1 = std::min(((lms_mean[0] - lms_mean[1]) / 255.0f), loss_1);
-  loss_2 = std::min(((lms_mean[1] - lms_mean[2]) / 255.0f), loss_2);
-  loss = std::min(std::abs(loss_1 - loss_2), loss);
-
-  std::vector<std::vector<uint8_t>> corrected_images;
-  corrected_images.emplace_back(corrected_lms_channel[r_index]);
-  corrected_images.emplace_back(corrected_lms_channel[g_index]);
-  corrected_images.emplace_back(corrected_lms_channel[b_index]);
-  corrected_images.emplace_back(rgba_image_channels[3]);
-  auto combined_channels_corrected_image = imageops::channel_combine(corrected_images, image_width, image_height);
-
-  return {combined_channels_corrected_image, loss};
-}
+    // Render
+    constexpr uint32_t cornflower_color = 0x9ACEEB;
+    window.clear(sf::Color(cornflower_color));
 
-std::vector<uint8_t> redefine(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float loss_limit)
-{
-  float loss = 1.0f;
-  std::vector<uint8_t> combined_channels_corrected_image = input_image;
-  while (loss > loss_limit)
-  {
-    std::tie(combined_channels_corrected_image, loss) = redefine_algo(combined_channels_corrected_image, image_width, image_height, bytes_per_pixel);
-  }
+    // both images show the same view of the image, results of another view are placed relative to it
 
-  return combined_channels_corrected_image;
-}
+    const float view_scale = display_scale * std::min(static_cast<float>(image_width) / static_cast<float>(std::max(view_region.width, 1u))
+                                                     ,static_cast<float>(image_height) / static_cast<float>(std::max(view_region.height, 1u)));
 
-std::vector<uint8_t> attenuation_map_max(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel)
-{
-  constexpr float gamma = 1.2f; // controls intensity of received light
-  auto rgba_image_channels = imageops::channel_split(input_image.data(), image_width, image_height, bytes_per_pixel);
+    if (loaded_image.getSize() != sf::Vector2u(0,0))
+    {
+      loaded_image_plane.setTextureRect(sf::IntRect(static_cast<int>(view_region.x), static_cast<int>(view_region.y), static_cast<int>(view_region.width), static_cast<int>(view_region.height)));
+      loaded_image_plane.setScale(view_scale, view_scale);
+      window.draw(loaded_image_plane);
+    }
 
-  for (size_t i=0; i<image_height; i++)
-  {
-    for (size_t j=0; j<image_width; j++)
+    if (has_result)
     {
-      for (size_t k=0; k<3; k++)
-      {
-        float norm_pixel_value = static_cast<float>(rgba_image_channels[k][j + (i * image_width)]) / 255.0f;
-        float new_pixel_value = 1.0f - std::pow(norm_pixel_value, gamma);
-        rgba_image_channels[k][j + (i * image_width)] = static_cast<uint8_t>(new_pixel_value * 255.0f);
-      }
+      const float result_x = (static_cast<float>(result_region.x) - static_cast<float>(view_region.x)) * view_scale;
+      const float result_y = (static_cast<float>(result_region.y) - static_cast<float>(view_region.y)) * view_scale;
+      result_plane.setPosition((static_cast<float>(image_width) * display_scale) + (loaded_image_margin / 2.0f) + result_x, (loaded_image_margin / 2.0f) + result_y);
+      result_plane.setScale(view_scale * static_cast<float>(result_scale), view_scale * static_cast<float>(result_scale));
+      window.draw(result_plane);
     }
-  }
 
-  float r_max = imageops::channel_sum(rgba_image_channels[0].data(), image_width, image_height);
-  float g_max = imageops::channel_sum(rgba_image_channels[1].data(), image_width, image_height);
-  float b_max = imageops::channel_sum(rgba_image_channels[2].data(), image_width, image_height);
+    ImGui::SFML::Render(window);
 
-  std::vector<uint8_t> max_attenuation_channel;
-  if ((r_max > g_max) && (r_max > b_max))
-  {
-    max_attenuation_channel = rgba_image_channels[0];
-  }
-  else if ((g_max > r_max) && (g_max > b_max))
-  {
-    max_attenuation_channel = rgba_image_channels[1];
-  }
-  else
-  {
-    max_attenuation_channel = rgba_image_channels[2];
+    window.display();
   }
 
-  return max_attenuation_channel;
+  ImPlot::DestroyContext();
+  ImGui::SFML::Shutdown();
+
+  spdlog::info("application done!");
+
+  return 0;
 }
@@ -0,0 +1,114 @@
+#include "batchscheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <latch>
+
+#include "common/cthreadpool.h"
+#include "imageops/parallel.h"
+#include "strips.h"
+
+namespace {
+  const std::string batch_pool_name = "batch";
+
+  // below about a 512x512 frame per thread the chunks of the parallel loops are too small to pay for the hand off,
+  // and a single threaded image keeps its planes in the cache of one core
+  constexpr size_t pixels_per_thread = 512 * 512;
+}
+
+batchscheduler::batchscheduler(const pipeline::parameters & process_params, size_t memory_budget, size_t n_threads)
+  : params(process_params)
+  , memoryBudget(memory_budget)
+  , nThreads(std::max((n_threads > 0) ? n_threads : imageops::parallel_threads(), static_cast<size_t>(1)))
+  , freeThreads(nThreads)
+{
+}
+
+size_t batchscheduler::threadsfor(uint32_t image_width, uint32_t image_height) const
+{
+  const size_t pixels = static_cast<size_t>(image_width) * image_height;
+  return std::clamp(pixels / pixels_per_thread, static_cast<size_t>(1), nThreads);
+}
+
+size_t batchscheduler::memoryfor(uint32_t image_width, uint32_t image_height) const
+{
+  return pipeline::processing_memory(image_width, image_height, params);
+}
+
+void batchscheduler::acquire(size_t threads, size_t memory)
+{
+  std::unique_lock<std::mutex> lock(slotmutex);
+  const uint64_t ticket = nextTicket++;
+
+  // an image larger than the budget runs once nothing else does
+  cvSlotFree.wait(lock, [&]() -> bool {
+    return (ticket == servingTicket) && (threads <= freeThreads) && ((runningSlots == 0) || ((usedMemory + memory) <= memoryBudget));
+  });
+
+  freeThreads -= threads;
+  usedMemory += memory;
+  runningSlots++;
+  servingTicket++;
+  lock.unlock();
+  cvSlotFree.notify_all();
+}
+
+void batchscheduler::release(size_t threads, size_t memory)
+{
+  {
+    std::lock_guard<std::mutex> lock(slotmutex);
+    freeThreads += threads;
+    usedMemory -= memory;
+    runningSlots--;
+  }
+
+  cvSlotFree.notify_all();
+}
+
+batchscheduler::slot::slot(batchscheduler & scheduler, uint32_t image_width, uint32_t image_height)
+  : owner(scheduler)
+  , grantedThreads(scheduler.threadsfor(image_width, image_height))
+  , grantedMemory(scheduler.memoryfor(image_width, image_height))
+{
+  owner.acquire(grantedThreads, grantedMemory);
+  imageops::set_parallel_width(grantedThreads);
+}
+
+batchscheduler::slot::~slot()
+{
+  imageops::set_parallel_width(0);
+  owner.release(grantedThreads, grantedMemory);
+}
+
+size_t batchscheduler::run(size_t count, const std::function<bool(size_t)> & job)
+{
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  // the jobs are handed out by index so a job thread that finishes early picks up the next image
+  const size_t n_workers = std::min(count, nThreads);
+  std::atomic<size_t> next_job = 0;
+  std::atomic<size_t> failed_jobs = 0;
+  std::latch done(static_cast<std::ptrdiff_t>(n_workers));
+
+  cthreadpool pool(n_workers, batch_pool_name);
+  for (size_t w=0; w<n_workers; w++)
+  {
+    pool.addjob([&]() {
+      for (size_t i=next_job++; i<count; i=next_job++)
+      {
+        if (!job(i))
+        {
+          failed_jobs++;
+        }
+      }
+
+      done.count_down();
+    });
+  }
+
+  done.wait();
+  return failed_jobs;
+}
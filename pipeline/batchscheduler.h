@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "pipeline.h"
+
+// shares the threads of the imageops pool and a memory budget between the images of a batch. every image asks for
+// threads by its size: thumbnails run single threaded side by side, large frames split their parallel loops over
+// many threads and a mixed batch gets a mix of both (e.g. 4 images with 8 threads each on 32 threads). requests are
+// granted in order so a large frame is not starved by the small ones behind it
+class batchscheduler
+{
+  public:
+    // memory_budget in bytes for all images that are processed at the same time, n_threads 0 uses the pool size
+    batchscheduler(const pipeline::parameters & params, size_t memory_budget, size_t n_threads = 0);
+
+    batchscheduler(const batchscheduler &) = delete;
+    batchscheduler & operator=(const batchscheduler &) = delete;
+
+    // taken by a job once the size of its image is known, blocks until the threads and the memory are free. the
+    // parallel loops started by the calling thread use the granted threads until the slot is destroyed
+    class slot
+    {
+      public:
+        slot(batchscheduler & scheduler, uint32_t image_width, uint32_t image_height);
+        ~slot();
+
+        slot(const slot &) = delete;
+        slot & operator=(const slot &) = delete;
+
+        [[nodiscard]] size_t threads() const { return grantedThreads; }
+
+      private:
+        batchscheduler & owner;
+        size_t grantedThreads = 0;
+        size_t grantedMemory = 0;
+    };
+
+    [[nodiscard]] size_t threadsfor(uint32_t image_width, uint32_t image_height) const;
+    [[nodiscard]] size_t memoryfor(uint32_t image_width, uint32_t image_height) const;
+    [[nodiscard]] size_t numberofthreads() const { return nThreads; }
+
+    // runs job(i) for i in [0, count), at most one job per thread at once. a job loads its image and takes a slot
+    // that it holds until the result is saved, the memory of a slot counts the rgba input and output as well.
+    // returns the number of jobs that returned false
+    size_t run(size_t count, const std::function<bool(size_t)> & job);
+
+  private:
+    void acquire(size_t threads, size_t memory);
+    void release(size_t threads, size_t memory);
+
+    pipeline::parameters params;
+    size_t memoryBudget = 0;
+    size_t nThreads = 1;
+
+    std::mutex slotmutex;
+    std::condition_variable cvSlotFree;
+    size_t freeThreads = 0;
+    size_t usedMemory = 0;
+    size_t runningSlots = 0;
+    uint64_t nextTicket = 0;
+    uint64_t servingTicket = 0;
+};
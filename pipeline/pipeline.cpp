@@ -0,0 +1,1308 @@
+#include "pipeline.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include "imageops/imageops.h"
+#include "imageops/expression.h"
+#include "imageops/imagefilters.h"
+#include "imageops/parallel.h"
+#include "imageops/planestore.h"
+#include "imageops/colormodel.h"
+#include "imageops/fixedpoint.h"
+
+namespace {
+  constexpr uint8_t bytes_per_pixel = 4;
+  constexpr float loss_limit = pipeline::redefine_loss_limit;
+
+  bool report(const pipeline::progress_callback & progress, float value)
+  {
+    return !progress || progress(value);
+  }
+
+  pipeline::progress_callback sub_progress(const pipeline::progress_callback & progress, float begin, float end)
+  {
+    if (!progress)
+    {
+      return nullptr;
+    }
+
+    return [&progress, begin, end](float value) -> bool {
+      return progress(begin + ((end - begin) * value));
+    };
+  }
+
+  void redefine_pixel(uint8_t * pixel, const pipeline::redefine_step & step)
+  {
+    constexpr float image_min_0 = 0.0f;
+    constexpr float image_max_0 = 255.0f;
+
+    const auto l_channel = static_cast<float>(pixel[step.lms_order[0]]);
+    const auto m_channel = static_cast<float>(pixel[step.lms_order[1]]);
+    const auto s_channel = static_cast<float>(pixel[step.lms_order[2]]);
+
+    const float range_minmax = ((image_max_0 - image_min_0) / (step.l_max - step.l_min));
+    const float range = l_channel - step.l_min;
+    float l_value = std::clamp(image_min_0 + (range * range_minmax), 0.0f, 255.0f);
+    float m_value = std::clamp(m_channel + ((step.lms_mean[0] - step.lms_mean[1]) / 255.0f) * l_channel, 0.0f, 255.0f);
+    float s_value = std::clamp(s_channel + ((step.lms_mean[1] - step.lms_mean[2]) / 255.0f) * m_channel, 0.0f, 255.0f);
+
+    pixel[step.lms_order[0]] = static_cast<uint8_t>(l_value);
+    pixel[step.lms_order[1]] = static_cast<uint8_t>(m_value);
+    pixel[step.lms_order[2]] = static_cast<uint8_t>(s_value);
+  }
+
+  // channels ordered from the highest to the lowest mean (l, m, s), l_min and l_max are left to the caller
+  pipeline::redefine_step ordered_redefine_step(const std::array<float, 3> & channel_means)
+  {
+    pipeline::redefine_step step;
+    std::iota(step.lms_order.begin(), step.lms_order.end(), 0);
+    std::stable_sort(step.lms_order.begin(), step.lms_order.end(), [&channel_means](uint32_t a, uint32_t b) -> bool {
+      return channel_means[a] > channel_means[b];
+    });
+
+    for (size_t k=0; k<3; k++)
+    {
+      step.lms_mean[k] = channel_means[step.lms_order[k]];
+    }
+
+    return step;
+  }
+
+  float redefine_loss(const pipeline::redefine_step & step)
+  {
+    float loss_1 = ((step.lms_mean[0] - step.lms_mean[1]) / 255.0f);
+    float loss_2 = ((step.lms_mean[1] - step.lms_mean[2]) / 255.0f);
+    return std::abs(loss_1 - loss_2);
+  }
+
+  // channel with the highest sum of attenuated values
+  uint32_t max_attenuation_channel(uint64_t r_max, uint64_t g_max, uint64_t b_max)
+  {
+    if ((r_max > g_max) && (r_max > b_max))
+    {
+      return 0;
+    }
+    else if ((g_max > r_max) && (g_max > b_max))
+    {
+      return 1;
+    }
+
+    return 2;
+  }
+
+  // rows compose_region reads for an area
+  pipeline::region composed_rows(const pipeline::region & area, uint32_t image_width, uint32_t image_height)
+  {
+    const uint32_t y0 = (area.y > 0) ? (area.y - 1) : 0;
+    const uint32_t y1 = std::min(area.y + area.height + 1, image_height);
+    return {0, y0, image_width, (y1 - y0)};
+  }
+
+  // per pixel stages of a region: redefine, attenuation, detail map, jaffe-mcglamey model and cie-lab conversion
+  struct composed_region
+  {
+    pipeline::region area;
+    std::vector<uint8_t> redefined_image; // rgba
+    imageops::planestore attenuation_channel; // normalized
+    std::vector<std::vector<uint8_t>> detail_maps;
+    std::vector<uint8_t> jm_model_image; // rgba
+    std::vector<float> cielab_l;
+    imageops::planestore cielab_a;
+    imageops::planestore cielab_b;
+    std::vector<std::vector<uint16_t>> lab_fixed; // L, a and b of the fixed point path instead of the three above
+    colormodel::cielab_statistics cielab_stats; // of the composed area
+  };
+
+  // area that has to be processed so that the blocks of the local contrast stage see the same pixels as they do
+  // for the full frame. halo pixels are added around it (rounded up to whole blocks) for stages that look past their
+  // own block
+  pipeline::region processing_area(const pipeline::region & roi, uint32_t image_width, uint32_t image_height, uint32_t local_block_size, uint32_t halo_pixels)
+  {
+    const uint32_t halo = ((halo_pixels + local_block_size - 1) / local_block_size) * local_block_size;
+    uint32_t x0 = (roi.x / local_block_size) * local_block_size;
+    uint32_t y0 = (roi.y / local_block_size) * local_block_size;
+    uint32_t x1 = std::min(((roi.x + roi.width + local_block_size - 1) / local_block_size) * local_block_size, image_width);
+    uint32_t y1 = std::min(((roi.y + roi.height + local_block_size - 1) / local_block_size) * local_block_size, image_height);
+
+    x0 = (x0 >= halo) ? (x0 - halo) : 0;
+    y0 = (y0 >= halo) ? (y0 - halo) : 0;
+    x1 = std::min(x1 + halo, image_width);
+    y1 = std::min(y1 + halo, image_height);
+
+    // the last block of a row/column is moved back to the image edge, make sure it is inside of the area
+    if ((x1 == image_width) && ((x1 - x0) < local_block_size))
+    {
+      x0 = (x0 >= local_block_size) ? (x0 - local_block_size) : 0;
+    }
+
+    if ((y1 == image_height) && ((y1 - y0) < local_block_size))
+    {
+      y0 = (y0 >= local_block_size) ? (y0 - local_block_size) : 0;
+    }
+
+    return {x0, y0, (x1 - x0), (y1 - y0)};
+  }
+
+  // roi clamped to the image (an empty roi is the full frame) and the area that has to be composed for it
+  std::pair<pipeline::region, pipeline::region> roi_processing_area(const pipeline::region & roi, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params)
+  {
+    pipeline::region clamped_roi = roi.empty() ? pipeline::region{0, 0, image_width, image_height} : roi;
+    clamped_roi.x = std::min(clamped_roi.x, image_width - 1);
+    clamped_roi.y = std::min(clamped_roi.y, image_height - 1);
+    clamped_roi.width = std::min(clamped_roi.width, image_width - clamped_roi.x);
+    clamped_roi.height = std::min(clamped_roi.height, image_height - clamped_roi.y);
+
+    // interpolated and sliding window statistics reach into the neighbouring blocks, the guided filter runs two box
+    // filters of its radius on the local contrast output
+    const uint32_t local_block_size = std::max(params.local_block_size, 1u);
+    const uint32_t contrast_halo = (params.local_contrast_mode == pipeline::contrast_mode::block) ? 0 : local_block_size;
+    const uint32_t guided_halo = 2 * std::max(params.guided_radius, 1u);
+    const pipeline::region area = processing_area(clamped_roi, image_width, image_height, local_block_size, contrast_halo + guided_halo);
+
+    return {clamped_roi, area};
+  }
+
+  // input_image holds the rows of the frame from first_row on, at least the area and one row around it
+  bool compose_region(std::span<const uint8_t> input_image, uint32_t first_row, uint32_t image_width, uint32_t image_height, const pipeline::frame_statistics & stats, const pipeline::parameters & params, const pipeline::region & area, composed_region & composed, const pipeline::progress_callback & progress)
+  {
+    composed.area = area;
+
+    // the detail map (3x3 kernel) needs one pixel around the area
+
+    const uint32_t bx0 = (area.x > 0) ? (area.x - 1) : 0;
+    const uint32_t by0 = (area.y > 0) ? (area.y - 1) : 0;
+    const uint32_t bx1 = std::min(area.x + area.width + 1, image_width);
+    const uint32_t by1 = std::min(area.y + area.height + 1, image_height);
+    const uint32_t border_width = (bx1 - bx0);
+    const uint32_t border_height = (by1 - by0);
+    const bool full_frame = ((border_width == image_width) && (border_height == image_height));
+
+    std::vector<uint8_t> border_image;
+    if (!full_frame)
+    {
+      border_image = imageops::copy_section(input_image.data(), image_width, image_height, bytes_per_pixel, bx0, by0 - first_row, border_width, border_height);
+    }
+
+    const std::span<const uint8_t> source_image = full_frame ? input_image : std::span<const uint8_t>(border_image);
+
+    // generate redefined images based on mean of channels
+
+    std::vector<uint8_t> combined_channels_corrected_image (source_image.begin(), source_image.end());
+    pipeline::apply_redefine(combined_channels_corrected_image, border_width, border_height, bytes_per_pixel, stats.redefine_steps);
+
+    if (!report(progress, 0.2f))
+    {
+      return false;
+    }
+
+    std::vector<float> normalized_attenuation_channel;
+    std::vector<std::vector<uint8_t>> rgb_detail_mask;
+    std::vector<uint8_t> jm_model_color_corrected_image;
+
+    if (params.arithmetic == pipeline::arithmetic_mode::fixed_point)
+    {
+      // attenuation, detail map and jaffe-mcglamey model in one integer pass on the 8-bit attenuation map
+
+      auto attenuation_channel = pipeline::attenuation_map(source_image, border_width, border_height, bytes_per_pixel, stats.attenuation_channel, stats.attenuation_lut);
+      jm_model_color_corrected_image = fixedpoint::compose_jaffe_mcglamey(source_image.data(), combined_channels_corrected_image.data(), attenuation_channel.data(), border_width, border_height, params.sharp_const, rgb_detail_mask);
+
+      normalized_attenuation_channel.resize(attenuation_channel.size());
+      std::transform(attenuation_channel.begin(), attenuation_channel.end(), normalized_attenuation_channel.begin(), [](uint8_t value) {
+        return static_cast<float>(value) / static_cast<float>(std::numeric_limits<uint8_t>::max());
+      });
+    }
+    else
+    {
+      auto input_image_split = imageops::channel_split(source_image.data(), border_width, border_height, bytes_per_pixel);
+
+      auto combined_channels_corrected_image_split = imageops::channel_split(combined_channels_corrected_image.data(), border_width, border_height, bytes_per_pixel);
+
+      // generate attenuation channel (channel with the highest sum of pixel values over the full frame)
+
+      normalized_attenuation_channel = pipeline::normalized_attenuation_map(source_image, border_width, border_height, bytes_per_pixel, stats.attenuation_channel, stats.attenuation_lut);
+
+      // generate detailed image (un-sharpen filter per channel)
+
+      rgb_detail_mask.assign(3, std::vector<uint8_t>(border_width * border_height));
+      const auto & rgba_image_channels = input_image_split;
+      const float unsharp_const = params.sharp_const;
+      auto sharpen_mask_red = imagefilters::unsharpen_channel(rgba_image_channels[0], border_width, border_height, unsharp_const);
+      rgb_detail_mask[0] = imagefilters::constrain_filter_to_byte_map(sharpen_mask_red);
+
+      auto sharpen_mask_green = imagefilters::unsharpen_channel(rgba_image_channels[1], border_width, border_height, unsharp_const);
+      rgb_detail_mask[1] = imagefilters::constrain_filter_to_byte_map(sharpen_mask_green);
+
+      auto sharpen_mask_blue = imagefilters::unsharpen_channel(rgba_image_channels[2], border_width, border_height, unsharp_const);
+      rgb_detail_mask[2] = imagefilters::constrain_filter_to_byte_map(sharpen_mask_blue);
+
+      if (!report(progress, 0.5f))
+      {
+        return false;
+      }
+
+      // generate the Jaffe-McGlamey model --> J_c*t_c + A_c(1 - t_c), c E {R, G, B}
+      // I_fc = D_c + I_ct*A_max + I_c*(1 - A_max)
+
+      const size_t image_size = static_cast<size_t>(border_width) * border_height;
+      const auto t = imageops::plane(normalized_attenuation_channel);
+      const auto one_minus_t = 1.0f - t;
+      auto jm_model_channel = [&](size_t c, const std::vector<float> & sharpen_mask) {
+        const auto jt = imageops::plane(combined_channels_corrected_image_split[c]) * t;
+        const auto ai = one_minus_t * imageops::plane(input_image_split[c]);
+        return imageops::evaluate<uint8_t>(imageops::clamp((jt + ai) + imageops::plane(sharpen_mask), 0.0f, 255.0f), image_size);
+      };
+
+      std::vector<std::vector<uint8_t>> jm_model_channels(4);
+      jm_model_channels[0] = jm_model_channel(0, sharpen_mask_red);
+      jm_model_channels[1] = jm_model_channel(1, sharpen_mask_green);
+      jm_model_channels[2] = jm_model_channel(2, sharpen_mask_blue);
+      jm_model_channels[3] = rgba_image_channels[3];
+
+      jm_model_color_corrected_image = imageops::channel_combine(jm_model_channels, border_width, border_height);
+    }
+
+    if (!report(progress, 0.6f))
+    {
+      return false;
+    }
+
+    // drop the border
+
+    if (full_frame)
+    {
+      composed.redefined_image = std::move(combined_channels_corrected_image);
+      composed.attenuation_channel = imageops::planestore(std::move(normalized_attenuation_channel), params.half_storage);
+      composed.detail_maps = std::move(rgb_detail_mask);
+      composed.jm_model_image = std::move(jm_model_color_corrected_image);
+    }
+    else
+    {
+      const uint32_t ox = area.x - bx0;
+      const uint32_t oy = area.y - by0;
+
+      composed.redefined_image = imageops::copy_section(combined_channels_corrected_image.data(), border_width, border_height, bytes_per_pixel, ox, oy, area.width, area.height);
+      composed.attenuation_channel = imageops::planestore(imageops::copy_section(normalized_attenuation_channel.data(), border_width, border_height, 1, ox, oy, area.width, area.height), params.half_storage);
+      composed.detail_maps.clear();
+      for (const auto & detail_map : rgb_detail_mask)
+      {
+        composed.detail_maps.push_back(imageops::copy_section(detail_map.data(), border_width, border_height, 1, ox, oy, area.width, area.height));
+      }
+      composed.jm_model_image = imageops::copy_section(jm_model_color_corrected_image.data(), border_width, border_height, bytes_per_pixel, ox, oy, area.width, area.height);
+    }
+
+    // convert from rgb to cie-lab
+
+    if (params.arithmetic == pipeline::arithmetic_mode::fixed_point)
+    {
+      composed.lab_fixed = fixedpoint::convert_image_rgb_to_planar_lab(composed.jm_model_image.data(), area.width, area.height, composed.cielab_stats);
+      return report(progress, 1.0f);
+    }
+
+    auto cielab_channels = colormodel::convert_image_rgb_to_planar_cielab(composed.jm_model_image.data(), area.width, area.height, composed.cielab_stats);
+    composed.cielab_l = std::move(cielab_channels[0]);
+    composed.cielab_a = imageops::planestore(std::move(cielab_channels[1]), params.half_storage);
+    composed.cielab_b = imageops::planestore(std::move(cielab_channels[2]), params.half_storage);
+
+    return report(progress, 1.0f);
+  }
+
+  void statistics_from_cielab(const colormodel::cielab_statistics & cielab_stats, pipeline::frame_statistics & stats)
+  {
+    // mean of (a / a_max) is mean(a) / a_max
+    stats.cielab_l_variance = cielab_stats.l_variance();
+    stats.cielab_a_max = cielab_stats.a_max;
+    stats.cielab_b_max = cielab_stats.b_max;
+    stats.cielab_a_mean = cielab_stats.a_mean() / stats.cielab_a_max;
+    stats.cielab_b_mean = cielab_stats.b_mean() / stats.cielab_b_max;
+  }
+
+  std::vector<uint8_t> normalized_byte_map(const std::vector<float> & channel, uint32_t image_width, uint32_t image_height)
+  {
+    const float max_value = imageops::max_channel_value(channel.data(), image_width, image_height);
+    const float min_value = imageops::min_channel_value(channel.data(), image_width, image_height);
+    auto byte_channel = imageops::evaluate<uint8_t>(((imageops::plane(channel) - min_value) / (max_value - min_value)) * 255.0f, channel.size());
+    return imageops::expand_to_n_channels(byte_channel.data(), image_width, image_height, 1, bytes_per_pixel);
+  }
+
+  // per block state of the local contrast stage
+  struct local_contrast_block
+  {
+    float mean = 0.0f;
+    float var = 0.0f;
+    float global_var = 0.0f;
+  };
+
+  // enhance contrast of the L channel: mean + min(global variance / local variance, enhance const) * (L - mean)
+  std::vector<float> local_contrast(const std::vector<float> & cielab_l, uint32_t image_width, uint32_t image_height, float global_variance, const pipeline::parameters & params)
+  {
+    const uint32_t local_block_size = std::max(params.local_block_size, 1u);
+    const float beta = params.enhance_const;
+    std::vector<float> enhance_cie_l (image_width * image_height, 0.0f);
+
+    auto enhance_gain = [beta, global_variance](float variance) -> float {
+      float var_ratio = (global_variance / variance);
+      return (var_ratio < beta) ? var_ratio : beta;
+    };
+
+    if (params.local_contrast_mode == pipeline::contrast_mode::sliding_window)
+    {
+      std::vector<float> mean;
+      std::vector<float> variance;
+      imagefilters::box_mean_variance(cielab_l, image_width, image_height, local_block_size / 2, mean, variance);
+
+      imageops::parallel_for(0, enhance_cie_l.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i=begin; i<end; i++)
+        {
+          float output_value = mean[i] + (enhance_gain(variance[i]) * (cielab_l[i] - mean[i]));
+          enhance_cie_l[i] = std::clamp(output_value, 0.0f, 100.0f);
+        }
+      });
+
+      return enhance_cie_l;
+    }
+
+    // the statistics of all blocks are computed in one pass, after that every block is a pure per pixel mapping
+
+    const auto block_stats = imagefilters::compute_block_stats_grid(cielab_l, image_width, image_height, local_block_size);
+
+    if (params.local_contrast_mode == pipeline::contrast_mode::interpolated)
+    {
+      // the mapping is linear in L, so blending the block mappings is the same as blending their outputs
+      std::vector<float> offset(block_stats.blocks.size());
+      std::vector<float> gain(block_stats.blocks.size());
+      for (size_t b=0; b<block_stats.blocks.size(); b++)
+      {
+        gain[b] = enhance_gain(block_stats.blocks[b].variance);
+        offset[b] = block_stats.blocks[b].mean * (1.0f - gain[b]);
+      }
+
+      imagefilters::interpolated_block_linear_map(cielab_l, image_width, image_height, block_stats, offset, gain, 0.0f, 100.0f, enhance_cie_l);
+      return enhance_cie_l;
+    }
+
+    imageops::parallel_for(0, block_stats.blocks_y, 1, [&](size_t row_begin, size_t row_end) {
+      for (size_t i=row_begin; i<row_end; i++)
+      {
+        for (size_t j=0; j<block_stats.blocks_x; j++)
+        {
+          const auto & l_stats = block_stats.at(j, i);
+          const local_contrast_block block = {l_stats.mean, l_stats.variance, global_variance};
+
+          imageops::block_filter(cielab_l.data()
+                                ,enhance_cie_l.data()
+                                ,image_width
+                                ,image_height
+                                ,j
+                                ,i
+                                ,local_block_size
+                                ,local_block_size
+                                ,block
+                                ,[beta](float source_value, const local_contrast_block & b) -> float {
+                                   float var_ratio = (b.global_var / b.var);
+                                   float enhance_const = (var_ratio < beta) ? var_ratio : beta;
+
+                                   float output_value = b.mean + (enhance_const * (source_value - b.mean));
+                                   return std::clamp(output_value, 0.0f, 100.0f);
+                                 });
+        }
+      }
+    });
+
+    return enhance_cie_l;
+  }
+
+  // detail enhancement with the guided filter: the smoothed base plus the detail scaled by k. v is the edge threshold
+  // in L units, details with a standard deviation above it are kept as edges
+  std::vector<float> guided_detail_enhance(const std::vector<float> & enhance_cie_l, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params)
+  {
+    std::vector<float> enhance_cie_l_gf = enhance_cie_l;
+    imagefilters::guided_filter(enhance_cie_l_gf, image_width, image_height, std::max(params.guided_radius, 1u), std::max(params.v_const * params.v_const, 1e-6f));
+
+    const float kc = params.k_const;
+    imageops::parallel_for(0, enhance_cie_l_gf.size(), 4096, [&](size_t begin, size_t end) {
+      for (size_t i=begin; i<end; i++)
+      {
+        const float base = enhance_cie_l_gf[i];
+        enhance_cie_l_gf[i] = std::clamp(base + (kc * (enhance_cie_l[i] - base)), 0.0f, 100.0f);
+      }
+    });
+
+    return enhance_cie_l_gf;
+  }
+
+  // rgba pixels of the roi: the buffer of the caller when there is one, otherwise the image of the result which keeps
+  // its capacity between calls
+  std::span<uint8_t> output_pixels(pipeline::result & output, std::span<uint8_t> output_image, const pipeline::region & roi)
+  {
+    if (!output_image.empty())
+    {
+      return output_image;
+    }
+
+    output.color_corrected_image.resize(static_cast<size_t>(roi.width) * roi.height * bytes_per_pixel);
+    return output.color_corrected_image;
+  }
+
+  // local contrast, guided filter, color balance and conversion back to rgb of enhance_region on the integer planes
+  bool enhance_region_fixed(const composed_region & composed, const pipeline::frame_statistics & stats, const pipeline::parameters & params, const pipeline::region & roi, pipeline::result & output, std::span<uint8_t> output_image, bool keep_image_parts, const pipeline::progress_callback & progress)
+  {
+    const uint32_t image_width = composed.area.width;
+    const uint32_t image_height = composed.area.height;
+    const uint32_t rx = roi.x - composed.area.x;
+    const uint32_t ry = roi.y - composed.area.y;
+    const auto & cielab_l = composed.lab_fixed[0];
+    const uint32_t local_block_size = std::max(params.local_block_size, 1u);
+
+    auto crop_l_channel = [&](const std::vector<uint16_t> & channel) {
+      auto section = imageops::copy_section(channel.data(), image_width, image_height, 1, rx, ry, roi.width, roi.height);
+      return normalized_byte_map(fixedpoint::l_channel_to_float(section), roi.width, roi.height);
+    };
+
+    // create enhance contrast map, the interpolated mode blends the float block mappings on the converted plane
+
+    std::vector<uint16_t> enhance_cie_l;
+    if (params.local_contrast_mode == pipeline::contrast_mode::block)
+    {
+      enhance_cie_l = fixedpoint::local_contrast_blocks(cielab_l, image_width, image_height, local_block_size, stats.cielab_l_variance, params.enhance_const);
+    }
+    else if (params.local_contrast_mode == pipeline::contrast_mode::sliding_window)
+    {
+      enhance_cie_l = fixedpoint::local_contrast_window(cielab_l, image_width, image_height, local_block_size / 2, stats.cielab_l_variance, params.enhance_const);
+    }
+    else
+    {
+      enhance_cie_l = fixedpoint::l_channel_from_float(local_contrast(fixedpoint::l_channel_to_float(cielab_l), image_width, image_height, stats.cielab_l_variance, params));
+    }
+
+    if (!report(progress, 0.4f))
+    {
+      return false;
+    }
+
+    // guided filter
+
+    auto enhance_cie_l_gf = fixedpoint::guided_detail_enhance(enhance_cie_l, image_width, image_height, std::max(params.guided_radius, 1u), std::max(params.v_const * params.v_const, 1e-6f), params.k_const);
+
+    if (!report(progress, 0.8f))
+    {
+      return false;
+    }
+
+    if (keep_image_parts)
+    {
+      output.image_parts.emplace_back("_local_contrast", crop_l_channel(enhance_cie_l));
+      output.image_parts.emplace_back("_guided_filter", crop_l_channel(enhance_cie_l_gf));
+    }
+
+    // color balance of the a and b channels is applied while converting the roi back to rgb
+
+    auto cielab_l_roi = imageops::copy_section(enhance_cie_l_gf.data(), image_width, image_height, 1, rx, ry, roi.width, roi.height);
+    auto cielab_a_roi = imageops::copy_section(composed.lab_fixed[1].data(), image_width, image_height, 1, rx, ry, roi.width, roi.height);
+    auto cielab_b_roi = imageops::copy_section(composed.lab_fixed[2].data(), image_width, image_height, 1, rx, ry, roi.width, roi.height);
+
+    const float cei_a_mean = stats.cielab_a_mean;
+    const float cei_b_mean = stats.cielab_b_mean;
+    const float cei_ab_ratio = (cei_a_mean > cei_b_mean) ? (((cei_a_mean - cei_b_mean) / (cei_b_mean + cei_a_mean)) * 0.25f) : 0.0f;
+    const float cei_ba_ratio = (cei_a_mean < cei_b_mean) ? (((cei_b_mean - cei_a_mean) / (cei_a_mean + cei_b_mean)) * 0.25f) : 0.0f;
+
+    if (!report(progress, 0.9f))
+    {
+      return false;
+    }
+
+    fixedpoint::convert_planar_lab_to_rgb(cielab_l_roi.data(), cielab_a_roi.data(), cielab_b_roi.data(), roi.width, roi.height, cei_ba_ratio, cei_ab_ratio, output_pixels(output, output_image, roi));
+
+    return report(progress, 1.0f);
+  }
+
+  // local contrast, guided filter and color balance on a composed area, the output is cropped to the roi. the rgba
+  // pixels go to output_image when it is not empty (roi size), the image of the result stays empty then
+  bool enhance_region(composed_region & composed, const pipeline::frame_statistics & stats, const pipeline::parameters & params, const pipeline::region & roi, pipeline::result & output, std::span<uint8_t> output_image, bool keep_image_parts, const pipeline::progress_callback & progress)
+  {
+    const uint32_t image_width = composed.area.width;
+    const uint32_t image_height = composed.area.height;
+    const uint32_t rx = roi.x - composed.area.x;
+    const uint32_t ry = roi.y - composed.area.y;
+    const bool fixed_point = (params.arithmetic == pipeline::arithmetic_mode::fixed_point);
+
+    // the fixed point path only needs L in float for the image parts
+    std::vector<float> fixed_cielab_l;
+    if (fixed_point && keep_image_parts)
+    {
+      fixed_cielab_l = fixedpoint::l_channel_to_float(composed.lab_fixed[0]);
+    }
+
+    const auto & cielab_l = fixed_point ? fixed_cielab_l : composed.cielab_l;
+
+    output.image_width = roi.width;
+    output.image_height = roi.height;
+    output.image_region = roi;
+    output.color_corrected_image.clear();
+    output.image_parts.clear();
+
+    auto crop_channel = [&](const std::vector<uint8_t> & channel) {
+      auto section = imageops::copy_section(channel.data(), image_width, image_height, 1, rx, ry, roi.width, roi.height);
+      return imageops::expand_to_n_channels(section.data(), roi.width, roi.height, 1, bytes_per_pixel);
+    };
+
+    auto crop_float_channel = [&](const std::vector<float> & channel) {
+      auto section = imageops::copy_section(channel.data(), image_width, image_height, 1, rx, ry, roi.width, roi.height);
+      return normalized_byte_map(section, roi.width, roi.height);
+    };
+
+    if (keep_image_parts)
+    {
+      auto redefined_split = imageops::channel_split(composed.redefined_image.data(), image_width, image_height, bytes_per_pixel);
+      output.image_parts.emplace_back("_redefine_r", crop_channel(redefined_split[0]));
+      output.image_parts.emplace_back("_redefine_g", crop_channel(redefined_split[1]));
+      output.image_parts.emplace_back("_redefine_b", crop_channel(redefined_split[2]));
+      output.image_parts.emplace_back("_detail_map_r", crop_channel(composed.detail_maps[0]));
+      output.image_parts.emplace_back("_detail_map_g", crop_channel(composed.detail_maps[1]));
+      output.image_parts.emplace_back("_detail_map_b", crop_channel(composed.detail_maps[2]));
+      auto normalized_attenuation_channel = composed.attenuation_channel.channel();
+      std::vector<uint8_t> attenuation_channel(normalized_attenuation_channel.size());
+      std::transform(normalized_attenuation_channel.begin(), normalized_attenuation_channel.end(), attenuation_channel.begin(), [](float value) {
+        return static_cast<uint8_t>(std::lround(value * 255.0f)); // exact inverse of the normalized lut, also from fp16
+      });
+      output.image_parts.emplace_back("_max_attenuation", crop_channel(attenuation_channel));
+      output.image_parts.emplace_back("_color_transfer", imageops::copy_section(composed.jm_model_image.data(), image_width, image_height, bytes_per_pixel, rx, ry, roi.width, roi.height));
+    }
+
+    if (keep_image_parts)
+    {
+      // integral image (summed-area table) is only shown as an image part, the block statistics are computed directly
+      auto cielab_cc_integral_image = imagefilters::integral_image_map(cielab_l, image_width, image_height);
+      float mv = imageops::max_channel_value(cielab_cc_integral_image.data(), image_width, image_height);
+      float max_int = 255.0f;
+      auto byte_nm_ii_int = imageops::evaluate<uint8_t>((imageops::plane(cielab_cc_integral_image) / mv) * max_int, cielab_cc_integral_image.size());
+      output.image_parts.emplace_back("_integral_map", crop_channel(byte_nm_ii_int));
+      output.image_parts.emplace_back("_cielab_channel_L", crop_float_channel(cielab_l));
+    }
+
+    const float cielab_cc_global_var = stats.cielab_l_variance;
+
+    if (fixed_point)
+    {
+      return enhance_region_fixed(composed, stats, params, roi, output, output_image, keep_image_parts, progress);
+    }
+
+    // create enhance contrast map
+
+    auto enhance_cie_l = local_contrast(cielab_l, image_width, image_height, cielab_cc_global_var, params);
+
+    if (!report(progress, 0.4f))
+    {
+      return false;
+    }
+
+    // guided filter
+
+    auto enhance_cie_l_gf = guided_detail_enhance(enhance_cie_l, image_width, image_height, params);
+
+    if (!report(progress, 0.8f))
+    {
+      return false;
+    }
+
+    if (keep_image_parts)
+    {
+      output.image_parts.emplace_back("_local_contrast", crop_float_channel(enhance_cie_l));
+      output.image_parts.emplace_back("_guided_filter", crop_float_channel(enhance_cie_l_gf));
+    }
+
+    // only the roi is color balanced and converted back to rgb
+
+    std::vector<std::vector<float>> cielab_roi_split(4);
+    cielab_roi_split[0] = imageops::copy_section(enhance_cie_l_gf.data(), image_width, image_height, 1, rx, ry, roi.width, roi.height); // L channel with enhance results
+    cielab_roi_split[1] = composed.cielab_a.section(image_width, rx, ry, roi.width, roi.height);
+    cielab_roi_split[2] = composed.cielab_b.section(image_width, rx, ry, roi.width, roi.height);
+    cielab_roi_split[3] = std::vector<float>(roi.width * roi.height, 100.0f);
+
+    // color balance a and b channels
+
+    const float cei_a_mean = stats.cielab_a_mean;
+    const float cei_b_mean = stats.cielab_b_mean;
+
+    const float cei_ab_ratio = ((cei_a_mean - cei_b_mean) / (cei_b_mean + cei_a_mean)) * 0.25f;
+    const float cei_ba_ratio = ((cei_b_mean - cei_a_mean) / (cei_a_mean + cei_b_mean)) * 0.25f;
+
+    for(size_t i=0; i<roi.height; i++)
+    {
+      for (size_t j=0; j<roi.width; j++)
+      {
+        float cie_b_value = cielab_roi_split[2][j + (i * roi.width)];
+        float cie_a_value = cielab_roi_split[1][j + (i * roi.width)];
+
+        if (cei_a_mean > cei_b_mean)
+        {
+          float new_cei_b_value = cie_b_value + (cei_ab_ratio * cie_b_value);
+          cielab_roi_split[2][j + (i * roi.width)] = new_cei_b_value;
+        }
+
+        if (cei_a_mean < cei_b_mean)
+        {
+          float new_cei_a_value = cie_a_value + (cei_ba_ratio * cie_a_value);
+          cielab_roi_split[1][j + (i * roi.width)] = new_cei_a_value;
+        }
+      }
+    }
+
+    if (!report(progress, 0.9f))
+    {
+      return false;
+    }
+
+    // convert back to rgb
+
+    auto combine_cielab_color_corrected_image = imageops::channel_combine(cielab_roi_split, roi.width, roi.height);
+    colormodel::convert_image_cielab_to_rgb(combine_cielab_color_corrected_image, roi.width, roi.height, output_pixels(output, output_image, roi));
+
+    return report(progress, 1.0f);
+  }
+
+  // late stages on a composed full frame, the frame statistics come from its cie-lab planes
+  bool enhance_full_frame(composed_region & composed, const pipeline::parameters & params, pipeline::result & output, std::span<uint8_t> output_image, const pipeline::progress_callback & progress)
+  {
+    pipeline::frame_statistics stats;
+    stats.image_width = composed.area.width;
+    stats.image_height = composed.area.height;
+    stats.sharp_const = params.sharp_const;
+    stats.attenuation_gamma = params.attenuation_gamma;
+    stats.arithmetic = params.arithmetic;
+    statistics_from_cielab(composed.cielab_stats, stats);
+
+    return enhance_region(composed, stats, params, composed.area, output, output_image, false, progress);
+  }
+
+  bool process_frame(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params, pipeline::result & output, std::span<uint8_t> output_image, pipeline::frame_statistics * frame_stats, bool keep_image_parts, const pipeline::progress_callback & progress)
+  {
+    // same as compute_frame_statistics followed by process_region of the full frame, but the full frame is only
+    // composed once. the statistics are given to the caller when frame_stats is set
+
+    if (!report(progress, 0.0f))
+    {
+      return false;
+    }
+
+    pipeline::frame_statistics stats;
+    stats.image_width = image_width;
+    stats.image_height = image_height;
+    stats.sharp_const = params.sharp_const;
+    stats.attenuation_gamma = params.attenuation_gamma;
+    stats.arithmetic = params.arithmetic;
+    stats.redefine_steps = pipeline::redefine_plan(input_image, image_width, image_height, bytes_per_pixel, loss_limit);
+    stats.attenuation_lut = pipeline::attenuation_lut(params.attenuation_gamma);
+    stats.attenuation_channel = pipeline::attenuation_channel_max(input_image, image_width, image_height, bytes_per_pixel, stats.attenuation_lut);
+
+    if (!report(progress, 0.15f))
+    {
+      return false;
+    }
+
+    const pipeline::region full_frame = {0, 0, image_width, image_height};
+    composed_region composed;
+    if (!compose_region(input_image, 0, image_width, image_height, stats, params, full_frame, composed, sub_progress(progress, 0.15f, 0.55f)))
+    {
+      return false;
+    }
+
+    statistics_from_cielab(composed.cielab_stats, stats);
+
+    if (!enhance_region(composed, stats, params, full_frame, output, output_image, keep_image_parts, sub_progress(progress, 0.55f, 1.0f)))
+    {
+      return false;
+    }
+
+    if (frame_stats != nullptr)
+    {
+      *frame_stats = std::move(stats);
+    }
+
+    return true;
+  }
+
+  bool lab_contrast_frame(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params, pipeline::result & output, std::span<uint8_t> output_image, const pipeline::progress_callback & progress)
+  {
+    // only the cie-lab planes and statistics of the composed region are used by enhance_region without image parts
+    composed_region composed;
+    composed.area = {0, 0, image_width, image_height};
+
+    if (params.arithmetic == pipeline::arithmetic_mode::fixed_point)
+    {
+      composed.lab_fixed = fixedpoint::convert_image_rgb_to_planar_lab(input_image.data(), image_width, image_height, composed.cielab_stats);
+    }
+    else
+    {
+      auto cielab_channels = colormodel::convert_image_rgb_to_planar_cielab(input_image.data(), image_width, image_height, composed.cielab_stats);
+      composed.cielab_l = std::move(cielab_channels[0]);
+      composed.cielab_a = imageops::planestore(std::move(cielab_channels[1]), params.half_storage);
+      composed.cielab_b = imageops::planestore(std::move(cielab_channels[2]), params.half_storage);
+    }
+
+    if (!report(progress, 0.2f))
+    {
+      return false;
+    }
+
+    return enhance_full_frame(composed, params, output, output_image, sub_progress(progress, 0.2f, 1.0f));
+  }
+
+  bool output_fits(std::span<uint8_t> output_image, uint32_t image_width, uint32_t image_height)
+  {
+    return output_image.size() >= (static_cast<size_t>(image_width) * image_height * bytes_per_pixel);
+  }
+}
+
+namespace pipeline {
+
+  bool statistics_valid(const frame_statistics & stats, uint32_t image_width, uint32_t image_height, const parameters & params)
+  {
+    return (stats.image_width == image_width) && (stats.image_height == image_height) && (stats.sharp_const == params.sharp_const) && (stats.attenuation_gamma == params.attenuation_gamma) && (stats.arithmetic == params.arithmetic) && !stats.redefine_steps.empty();
+  }
+
+  bool compute_frame_statistics(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, frame_statistics & stats, const progress_callback & progress)
+  {
+    stats = {};
+
+    if (!report(progress, 0.0f))
+    {
+      return false;
+    }
+
+    frame_statistics frame_stats;
+    frame_stats.image_width = image_width;
+    frame_stats.image_height = image_height;
+    frame_stats.sharp_const = params.sharp_const;
+    frame_stats.attenuation_gamma = params.attenuation_gamma;
+    frame_stats.arithmetic = params.arithmetic;
+    frame_stats.redefine_steps = redefine_plan(input_image, image_width, image_height, bytes_per_pixel, loss_limit);
+    frame_stats.attenuation_lut = attenuation_lut(params.attenuation_gamma);
+    frame_stats.attenuation_channel = attenuation_channel_max(input_image, image_width, image_height, bytes_per_pixel, frame_stats.attenuation_lut);
+
+    if (!report(progress, 0.3f))
+    {
+      return false;
+    }
+
+    composed_region composed;
+    if (!compose_region(input_image, 0, image_width, image_height, frame_stats, params, {0, 0, image_width, image_height}, composed, sub_progress(progress, 0.3f, 0.9f)))
+    {
+      return false;
+    }
+
+    statistics_from_cielab(composed.cielab_stats, frame_stats);
+    stats = std::move(frame_stats);
+
+    return report(progress, 1.0f);
+  }
+
+  bool process_region(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const frame_statistics & stats, const parameters & params, const region & roi, result & output, bool keep_image_parts, const progress_callback & progress)
+  {
+    const auto [clamped_roi, area] = roi_processing_area(roi, image_width, image_height, params);
+
+    composed_region composed;
+    if (!compose_region(input_image, 0, image_width, image_height, stats, params, area, composed, sub_progress(progress, 0.0f, 0.5f)))
+    {
+      return false;
+    }
+
+    return enhance_region(composed, stats, params, clamped_roi, output, {}, keep_image_parts, sub_progress(progress, 0.5f, 1.0f));
+  }
+
+  bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, result & output, bool keep_image_parts, const progress_callback & progress)
+  {
+    return process_frame(input_image, image_width, image_height, params, output, {}, nullptr, keep_image_parts, progress);
+  }
+
+  bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, result & output, frame_statistics & stats, bool keep_image_parts, const progress_callback & progress)
+  {
+    return process_frame(input_image, image_width, image_height, params, output, {}, &stats, keep_image_parts, progress);
+  }
+
+  bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, std::span<uint8_t> output_image, const progress_callback & progress)
+  {
+    if (!output_fits(output_image, image_width, image_height))
+    {
+      return false;
+    }
+
+    result output;
+    return process_frame(input_image, image_width, image_height, params, output, output_image, nullptr, false, progress);
+  }
+
+  std::vector<uint8_t> detail_map(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, float sharp_const)
+  {
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    auto rgba_image_channels = imageops::channel_split(input_image.data(), image_width, image_height, bytes_per_pixel);
+
+    std::vector<std::vector<uint8_t>> detail_channels(bytes_per_pixel);
+    for (size_t c=0; c<3; c++)
+    {
+      detail_channels[c] = imagefilters::constrain_filter_to_byte_map(imagefilters::unsharpen_channel(rgba_image_channels[c], image_width, image_height, sharp_const));
+    }
+    detail_channels[3].assign(image_size, std::numeric_limits<uint8_t>::max());
+
+    return imageops::channel_combine(detail_channels, image_width, image_height);
+  }
+
+  bool lab_contrast(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, result & output, const progress_callback & progress)
+  {
+    return lab_contrast_frame(input_image, image_width, image_height, params, output, {}, progress);
+  }
+
+  bool lab_contrast(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, std::span<uint8_t> output_image, const progress_callback & progress)
+  {
+    if (!output_fits(output_image, image_width, image_height))
+    {
+      return false;
+    }
+
+    result output;
+    return lab_contrast_frame(input_image, image_width, image_height, params, output, output_image, progress);
+  }
+
+  bool compose_lab_frame(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, lab_frame & frame, const progress_callback & progress)
+  {
+    frame = {};
+
+    if (!report(progress, 0.0f))
+    {
+      return false;
+    }
+
+    // a and b stay in fp32 so the frame does not depend on the storage precision of the run that made it
+    parameters compose_params = params;
+    compose_params.half_storage = false;
+
+    frame_statistics stats;
+    stats.image_width = image_width;
+    stats.image_height = image_height;
+    stats.sharp_const = params.sharp_const;
+    stats.attenuation_gamma = params.attenuation_gamma;
+    stats.arithmetic = params.arithmetic;
+    stats.redefine_steps = redefine_plan(input_image, image_width, image_height, bytes_per_pixel, loss_limit);
+    stats.attenuation_lut = attenuation_lut(params.attenuation_gamma);
+    stats.attenuation_channel = attenuation_channel_max(input_image, image_width, image_height, bytes_per_pixel, stats.attenuation_lut);
+
+    if (!report(progress, 0.3f))
+    {
+      return false;
+    }
+
+    composed_region composed;
+    if (!compose_region(input_image, 0, image_width, image_height, stats, compose_params, {0, 0, image_width, image_height}, composed, sub_progress(progress, 0.3f, 1.0f)))
+    {
+      return false;
+    }
+
+    frame.image_width = image_width;
+    frame.image_height = image_height;
+    frame.sharp_const = params.sharp_const;
+    frame.attenuation_gamma = params.attenuation_gamma;
+    frame.arithmetic = params.arithmetic;
+    frame.cielab_stats = composed.cielab_stats;
+
+    if (params.arithmetic == arithmetic_mode::fixed_point)
+    {
+      frame.lab_fixed = std::move(composed.lab_fixed);
+    }
+    else
+    {
+      frame.lab.push_back(std::move(composed.cielab_l));
+      frame.lab.push_back(composed.cielab_a.channel());
+      frame.lab.push_back(composed.cielab_b.channel());
+    }
+
+    return true;
+  }
+
+  bool enhance_lab_frame(const lab_frame & frame, const parameters & params, result & output, const progress_callback & progress)
+  {
+    if (!lab_frame_valid(frame, frame.image_width, frame.image_height, params))
+    {
+      return false;
+    }
+
+    composed_region composed;
+    composed.area = {0, 0, frame.image_width, frame.image_height};
+    composed.cielab_stats = frame.cielab_stats;
+
+    if (params.arithmetic == arithmetic_mode::fixed_point)
+    {
+      composed.lab_fixed = frame.lab_fixed;
+    }
+    else
+    {
+      composed.cielab_l = frame.lab[0];
+      composed.cielab_a = imageops::planestore(std::vector<float>(frame.lab[1]), params.half_storage);
+      composed.cielab_b = imageops::planestore(std::vector<float>(frame.lab[2]), params.half_storage);
+    }
+
+    return enhance_full_frame(composed, params, output, {}, progress);
+  }
+
+  bool lab_frame_valid(const lab_frame & frame, uint32_t image_width, uint32_t image_height, const parameters & params)
+  {
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    const auto & planes_size = [image_size](const auto & planes) {
+      return (planes.size() == 3) && std::all_of(planes.begin(), planes.end(), [image_size](const auto & plane) {
+        return plane.size() == image_size;
+      });
+    };
+
+    return (frame.image_width == image_width) && (frame.image_height == image_height) && (frame.sharp_const == params.sharp_const) && (frame.attenuation_gamma == params.attenuation_gamma) && (frame.arithmetic == params.arithmetic)
+           && ((params.arithmetic == arithmetic_mode::fixed_point) ? planes_size(frame.lab_fixed) : planes_size(frame.lab));
+  }
+
+  void color_histogram::add(const uint8_t * rgba_pixels, size_t pixel_count)
+  {
+    if (counts.empty())
+    {
+      counts.assign(1u << 24, 0);
+    }
+
+    for (size_t i=0; i<pixel_count; i++, rgba_pixels += bytes_per_pixel)
+    {
+      const uint32_t color = rgba_pixels[0] + (rgba_pixels[1] << 8) + (rgba_pixels[2] << 16);
+      if (++counts[color] == 0)
+      {
+        overflow[color]++;
+      }
+    }
+  }
+
+  uint64_t color_histogram::count(uint32_t color) const
+  {
+    if (color >= counts.size())
+    {
+      return 0;
+    }
+
+    const auto wrapped = overflow.find(color);
+    const uint64_t wraps = (wrapped != overflow.end()) ? wrapped->second : 0;
+    return (wraps << 32) + counts[color];
+  }
+
+  frame_statistics begin_frame_statistics(const color_histogram & histogram, uint32_t image_width, uint32_t image_height, const parameters & params)
+  {
+    frame_statistics stats;
+    stats.image_width = image_width;
+    stats.image_height = image_height;
+    stats.sharp_const = params.sharp_const;
+    stats.attenuation_gamma = params.attenuation_gamma;
+    stats.arithmetic = params.arithmetic;
+    stats.redefine_steps = redefine_plan(histogram, loss_limit);
+    stats.attenuation_lut = attenuation_lut(params.attenuation_gamma);
+    stats.attenuation_channel = attenuation_channel_max(histogram, stats.attenuation_lut);
+
+    return stats;
+  }
+
+  bool add_strip_statistics(const frame_rows & rows, const region & strip, const frame_statistics & stats, const parameters & params, colormodel::cielab_statistics & cielab_stats, const progress_callback & progress)
+  {
+    // the cie-lab statistics are gathered on the composed strip, the sums of all strips are the sums of the frame
+    composed_region composed;
+    if (!compose_region(rows.pixels, rows.first_row, stats.image_width, stats.image_height, stats, params, strip, composed, progress))
+    {
+      return false;
+    }
+
+    cielab_stats.add(composed.cielab_stats);
+    return true;
+  }
+
+  void end_frame_statistics(const colormodel::cielab_statistics & cielab_stats, frame_statistics & stats)
+  {
+    statistics_from_cielab(cielab_stats, stats);
+  }
+
+  bool process_strip(const frame_rows & rows, const frame_statistics & stats, const parameters & params, const region & roi, result & output, const progress_callback & progress)
+  {
+    const auto [clamped_roi, area] = roi_processing_area(roi, stats.image_width, stats.image_height, params);
+
+    composed_region composed;
+    if (!compose_region(rows.pixels, rows.first_row, stats.image_width, stats.image_height, stats, params, area, composed, sub_progress(progress, 0.0f, 0.5f)))
+    {
+      return false;
+    }
+
+    return enhance_region(composed, stats, params, clamped_roi, output, {}, false, sub_progress(progress, 0.5f, 1.0f));
+  }
+
+  region strip_statistics_rows(const region & strip, uint32_t image_width, uint32_t image_height)
+  {
+    return composed_rows(strip, image_width, image_height);
+  }
+
+  region strip_input_rows(const region & roi, uint32_t image_width, uint32_t image_height, const parameters & params)
+  {
+    return composed_rows(roi_processing_area(roi, image_width, image_height, params).second, image_width, image_height);
+  }
+
+  std::vector<image_level> build_pyramid(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t min_width, uint32_t min_height)
+  {
+    // halve the image until the next level would be smaller than the requested size. the full resolution image
+    // is not part of the pyramid so it is not copied
+    std::vector<image_level> levels;
+
+    const std::vector<uint8_t> * previous_pixels = &input_image;
+    uint32_t previous_width = image_width;
+    uint32_t previous_height = image_height;
+    uint32_t scale = 1;
+
+    while (((previous_width / 2) >= std::max(min_width, 1u)) && ((previous_height / 2) >= std::max(min_height, 1u)))
+    {
+      image_level level;
+      level.pixels = imageops::downsample_half(previous_pixels->data(), previous_width, previous_height, bytes_per_pixel);
+      level.image_width = (previous_width + 1) / 2;
+      level.image_height = (previous_height + 1) / 2;
+      level.scale = (scale *= 2);
+      levels.push_back(std::move(level));
+
+      previous_pixels = &levels.back().pixels;
+      previous_width = levels.back().image_width;
+      previous_height = levels.back().image_height;
+    }
+
+    return levels;
+  }
+
+  parameters scale_parameters(const parameters & params, uint32_t scale)
+  {
+    // spatial parameters are in full resolution pixels so they shrink with the preview
+    parameters scaled_params = params;
+    scaled_params.local_block_size = std::max(params.local_block_size / std::max(scale, 1u), 2u);
+    scaled_params.guided_radius = std::max(params.guided_radius / std::max(scale, 1u), 1u);
+
+    return scaled_params;
+  }
+
+  region scale_region(const region & image_region, uint32_t scale, uint32_t image_width, uint32_t image_height)
+  {
+    // scale a full resolution region to a pyramid level of the given size, the region grows to whole pixels
+    if (image_region.empty())
+    {
+      return image_region;
+    }
+
+    scale = std::max(scale, 1u);
+
+    region scaled_region;
+    scaled_region.x = std::min(image_region.x / scale, image_width - 1);
+    scaled_region.y = std::min(image_region.y / scale, image_height - 1);
+    scaled_region.width = std::min(((image_region.x + image_region.width + scale - 1) / scale) - scaled_region.x, image_width - scaled_region.x);
+    scaled_region.height = std::min(((image_region.y + image_region.height + scale - 1) / scale) - scaled_region.y, image_height - scaled_region.y);
+
+    return scaled_region;
+  }
+
+  std::vector<redefine_step> redefine_plan(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float loss_limit)
+  {
+    // the redefine algorithm is repeated until the loss is small enough. every iteration is recorded so it can be
+    // applied to any part of the image without the full frame
+    std::vector<redefine_step> steps;
+    std::vector<uint8_t> combined_channels_corrected_image (input_image.begin(), input_image.end());
+
+    float loss = 1.0f;
+    while (loss > loss_limit)
+    {
+      auto rgba_image_channels = imageops::channel_split(combined_channels_corrected_image.data(), image_width, image_height, bytes_per_pixel);
+
+      std::array<float, 3> channel_means = {imageops::mean(rgba_image_channels[0].data(), image_width, image_height)
+                                           ,imageops::mean(rgba_image_channels[1].data(), image_width, image_height)
+                                           ,imageops::mean(rgba_image_channels[2].data(), image_width, image_height)};
+
+      // order the channels from the highest to the lowest mean (l, m, s)
+      redefine_step step = ordered_redefine_step(channel_means);
+
+      step.l_min = imageops::min_channel_value(rgba_image_channels[step.lms_order[0]].data(), image_width, image_height);
+      step.l_max = imageops::max_channel_value(rgba_image_channels[step.lms_order[0]].data(), image_width, image_height);
+
+      // calculate the loss values
+
+      loss = redefine_loss(step);
+
+      apply_redefine(combined_channels_corrected_image, image_width, image_height, bytes_per_pixel, {step});
+      steps.push_back(step);
+    }
+
+    return steps;
+  }
+
+  std::vector<redefine_step> redefine_plan(const color_histogram & histogram, float loss_limit)
+  {
+    // same iterations as the image version on the distinct colors weighted by their pixel count. the channel sums
+    // are exact so the means can differ from the float sums of the image version in the last bits
+    std::vector<uint8_t> colors; // rgba
+    std::vector<uint64_t> weights;
+    uint64_t pixel_count = 0;
+
+    for (uint32_t color=0; color<histogram.counts.size(); color++)
+    {
+      const uint64_t n = histogram.count(color);
+      if (n > 0)
+      {
+        colors.insert(colors.end(), {static_cast<uint8_t>(color & 0xffu), static_cast<uint8_t>((color >> 8) & 0xffu), static_cast<uint8_t>((color >> 16) & 0xffu), 255});
+        weights.push_back(n);
+        pixel_count += n;
+      }
+    }
+
+    std::vector<redefine_step> steps;
+    if (pixel_count == 0)
+    {
+      return steps;
+    }
+
+    float loss = 1.0f;
+    while (loss > loss_limit)
+    {
+      std::array<uint64_t, 3> sums = {0, 0, 0};
+      std::array<uint8_t, 3> min_values = {255, 255, 255};
+      std::array<uint8_t, 3> max_values = {0, 0, 0};
+
+      for (size_t i=0; i<weights.size(); i++)
+      {
+        for (size_t c=0; c<3; c++)
+        {
+          const uint8_t value = colors[(i * bytes_per_pixel) + c];
+          sums[c] += weights[i] * value;
+          min_values[c] = std::min(min_values[c], value);
+          max_values[c] = std::max(max_values[c], value);
+        }
+      }
+
+      std::array<float, 3> channel_means;
+      for (size_t c=0; c<3; c++)
+      {
+        channel_means[c] = static_cast<float>(static_cast<double>(sums[c]) / static_cast<double>(pixel_count));
+      }
+
+      redefine_step step = ordered_redefine_step(channel_means);
+      step.l_min = min_values[step.lms_order[0]];
+      step.l_max = max_values[step.lms_order[0]];
+      loss = redefine_loss(step);
+
+      for (size_t i=0; i<weights.size(); i++)
+      {
+        redefine_pixel(&colors[i * bytes_per_pixel], step);
+      }
+
+      steps.push_back(step);
+    }
+
+    return steps;
+  }
+
+  void apply_redefine(std::vector<uint8_t> & image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, const std::vector<redefine_step> & steps)
+  {
+    for (size_t i=0; i<(image_width * image_height); i++)
+    {
+      for (const auto & step : steps)
+      {
+        redefine_pixel(&image[i * bytes_per_pixel], step);
+      }
+    }
+  }
+
+  std::vector<uint8_t> redefine(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float loss_limit)
+  {
+    std::vector<uint8_t> combined_channels_corrected_image (input_image.begin(), input_image.end());
+    apply_redefine(combined_channels_corrected_image, image_width, image_height, bytes_per_pixel, redefine_plan(input_image, image_width, image_height, bytes_per_pixel, loss_limit));
+
+    return combined_channels_corrected_image;
+  }
+
+  attenuation_table attenuation_lut(float gamma)
+  {
+    // inputs are 8-bit so the power is only evaluated once per value
+    attenuation_table lut;
+    for (size_t i=0; i<lut.size(); i++)
+    {
+      float norm_pixel_value = static_cast<float>(i) / 255.0f;
+      float new_pixel_value = 1.0f - std::pow(norm_pixel_value, gamma);
+      lut[i] = static_cast<uint8_t>(new_pixel_value * 255.0f);
+    }
+
+    return lut;
+  }
+
+  uint32_t attenuation_channel_max(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, const attenuation_table & lut)
+  {
+    // sum of the attenuated values of all three channels in one pass, the sums are exact
+    uint64_t r_max = 0;
+    uint64_t g_max = 0;
+    uint64_t b_max = 0;
+
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    const uint8_t * pixel = input_image.data();
+
+    for (size_t i=0; i<image_size; i++, pixel += bytes_per_pixel)
+    {
+      r_max += lut[pixel[0]];
+      g_max += lut[pixel[1]];
+      b_max += lut[pixel[2]];
+    }
+
+    return max_attenuation_channel(r_max, g_max, b_max);
+  }
+
+  uint32_t attenuation_channel_max(const color_histogram & histogram, const attenuation_table & lut)
+  {
+    uint64_t r_max = 0;
+    uint64_t g_max = 0;
+    uint64_t b_max = 0;
+
+    for (uint32_t color=0; color<histogram.counts.size(); color++)
+    {
+      const uint64_t n = histogram.count(color);
+      r_max += n * lut[color & 0xffu];
+      g_max += n * lut[(color >> 8) & 0xffu];
+      b_max += n * lut[(color >> 16) & 0xffu];
+    }
+
+    return max_attenuation_channel(r_max, g_max, b_max);
+  }
+
+  std::vector<uint8_t> attenuation_map(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, uint32_t channel, const attenuation_table & lut)
+  {
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<uint8_t> attenuation_channel (image_size);
+
+    for (size_t i=0; i<image_size; i++)
+    {
+      attenuation_channel[i] = lut[input_image[(i * bytes_per_pixel) + channel]];
+    }
+
+    return attenuation_channel;
+  }
+
+  std::vector<float> normalized_attenuation_map(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, uint32_t channel, const attenuation_table & lut)
+  {
+    // same values as normalizing the attenuation map, without the intermediate byte channel
+    std::array<float, 256> normalized_lut;
+    for (size_t i=0; i<normalized_lut.size(); i++)
+    {
+      normalized_lut[i] = static_cast<float>(lut[i]) / static_cast<float>(std::numeric_limits<uint8_t>::max());
+    }
+
+    const size_t image_size = static_cast<size_t>(image_width) * image_height;
+    std::vector<float> attenuation_channel (image_size);
+
+    for (size_t i=0; i<image_size; i++)
+    {
+      attenuation_channel[i] = normalized_lut[input_image[(i * bytes_per_pixel) + channel]];
+    }
+
+    return attenuation_channel;
+  }
+
+  std::vector<uint8_t> attenuation_map_max(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float gamma)
+  {
+    const auto lut = attenuation_lut(gamma);
+    return attenuation_map(input_image, image_width, image_height, bytes_per_pixel, attenuation_channel_max(input_image, image_width, image_height, bytes_per_pixel, lut), lut);
+  }
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <functional>
+#include <span>
+#include <unordered_map>
+
+#include "imageops/colormodel.h"
+
+namespace pipeline {
+
+  enum class contrast_mode : uint8_t
+  {
+    block = 0, // one mean and variance per block, as in the paper
+    interpolated, // block statistics bilinearly interpolated between the block centres
+    sliding_window // statistics of the block sized window around every pixel
+  };
+
+  enum class arithmetic_mode : uint8_t
+  {
+    floating_point = 0,
+    fixed_point // 16-bit integer intermediates, see imageops/fixedpoint.h for the deviation from floating point
+  };
+
+  struct parameters
+  {
+    uint32_t local_block_size = 50;
+    float sharp_const = 1.0f;
+    float enhance_const = 2.0f; // note papers uses a value of 2
+    float k_const = 2.0f; // guided filter detail gain, note papers uses a value of 2
+    float v_const = 2.0f; // guided filter edge threshold in L units, note papers uses a value of 2
+    uint32_t guided_radius = 8;
+    float attenuation_gamma = 1.2f; // controls intensity of received light
+    contrast_mode local_contrast_mode = contrast_mode::block;
+    bool half_storage = false; // keep the planes that live across stages in fp16, they are produced in fp32 so the peak is the same
+    arithmetic_mode arithmetic = arithmetic_mode::floating_point;
+
+    bool operator==(const parameters &) const = default;
+  };
+
+  // rectangle in pixels, an empty region means the full frame
+  struct region
+  {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    [[nodiscard]] bool empty() const { return (width == 0) || (height == 0); }
+    bool operator==(const region &) const = default;
+  };
+
+  struct result
+  {
+    uint32_t image_width = 0; // size of the processed region
+    uint32_t image_height = 0;
+    region image_region; // processed region of the full frame
+    std::vector<uint8_t> color_corrected_image; // rgba
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> image_parts; // file suffix and rgba image of each stage
+  };
+
+  struct image_level
+  {
+    std::vector<uint8_t> pixels; // rgba
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    uint32_t scale = 1; // full resolution size = (level size * scale)
+  };
+
+  // one iteration of the redefine algorithm, the channels are ordered by their mean (l > m > s)
+  struct redefine_step
+  {
+    std::array<uint32_t, 3> lms_order = {0, 1, 2}; // rgb channel index of the l, m and s channel
+    std::array<float, 3> lms_mean = {0.0f, 0.0f, 0.0f};
+    float l_min = 0.0f;
+    float l_max = 255.0f;
+  };
+
+  // attenuated value of every 8-bit input value: 255 * (1 - (x / 255)^gamma)
+  using attenuation_table = std::array<uint8_t, 256>;
+
+  // statistics that need the full frame. the per pixel stages of any region only depend on these
+  struct frame_statistics
+  {
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    float sharp_const = 0.0f; // statistics depend on the detail map so they are invalid when this changes
+    float attenuation_gamma = 0.0f; // the attenuation channel is picked with this gamma
+    arithmetic_mode arithmetic = arithmetic_mode::floating_point; // the cie-lab statistics come from this path
+
+    std::vector<redefine_step> redefine_steps;
+    uint32_t attenuation_channel = 0;
+    attenuation_table attenuation_lut = {};
+    float cielab_l_variance = 0.0f;
+    float cielab_a_max = 0.0f;
+    float cielab_b_max = 0.0f;
+    float cielab_a_mean = 0.0f; // mean of (a / a_max)
+    float cielab_b_mean = 0.0f; // mean of (b / b_max)
+  };
+
+  // pixel count of every rgb color of a frame. the redefine plan and the attenuation channel only depend on these so
+  // they can be gathered from a frame that is read in strips
+  struct color_histogram
+  {
+    std::vector<uint32_t> counts; // r + (g << 8) + (b << 16), allocated by the first add
+    std::unordered_map<uint32_t, uint64_t> overflow; // number of times the count of a color wrapped around
+
+    void add(const uint8_t * rgba_pixels, size_t pixel_count);
+    [[nodiscard]] uint64_t count(uint32_t color) const;
+  };
+
+  // rgba rows [first_row, first_row + row_count) of a frame that is not kept in memory as a whole
+  struct frame_rows
+  {
+    std::vector<uint8_t> pixels;
+    uint32_t first_row = 0;
+    uint32_t row_count = 0;
+  };
+
+  // progress is reported in the range [0, 1]. returning false from the callback cancels the processing
+  using progress_callback = std::function<bool(float)>;
+
+  // the redefine algorithm is repeated until the loss is below 10^(-2), that is about the minimal amount of
+  // iterations needed for the channels to balance out
+  constexpr float redefine_loss_limit = 1e-2f;
+
+  // input images are rgba pixels that stay owned by the caller, vectors convert to the span
+  std::vector<redefine_step> redefine_plan(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float loss_limit);
+  std::vector<redefine_step> redefine_plan(const color_histogram & histogram, float loss_limit);
+  void apply_redefine(std::vector<uint8_t> & image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, const std::vector<redefine_step> & steps);
+  std::vector<uint8_t> redefine(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float loss_limit);
+  attenuation_table attenuation_lut(float gamma);
+  uint32_t attenuation_channel_max(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, const attenuation_table & lut);
+  uint32_t attenuation_channel_max(const color_histogram & histogram, const attenuation_table & lut);
+  std::vector<uint8_t> attenuation_map(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, uint32_t channel, const attenuation_table & lut);
+  std::vector<float> normalized_attenuation_map(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, uint32_t channel, const attenuation_table & lut);
+  std::vector<uint8_t> attenuation_map_max(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, uint32_t bytes_per_pixel, float gamma = 1.2f);
+
+  std::vector<image_level> build_pyramid(const std::vector<uint8_t> & input_image, uint32_t image_width, uint32_t image_height, uint32_t min_width, uint32_t min_height);
+  parameters scale_parameters(const parameters & params, uint32_t scale);
+  region scale_region(const region & image_region, uint32_t scale, uint32_t image_width, uint32_t image_height);
+  bool statistics_valid(const frame_statistics & stats, uint32_t image_width, uint32_t image_height, const parameters & params);
+
+  bool compute_frame_statistics(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, frame_statistics & stats, const progress_callback & progress = nullptr);
+  bool process_region(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const frame_statistics & stats, const parameters & params, const region & roi, result & output, bool keep_image_parts = false, const progress_callback & progress = nullptr);
+  bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, result & output, bool keep_image_parts = true, const progress_callback & progress = nullptr);
+  // process() that also gives the frame statistics it computed, later regions of the frame pass them to process_region
+  bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, result & output, frame_statistics & stats, bool keep_image_parts = true, const progress_callback & progress = nullptr);
+  // process() without image parts that writes the rgba pixels into output_image (image_width * image_height * 4
+  // bytes) given by the caller, false when it is too small
+  bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, std::span<uint8_t> output_image, const progress_callback & progress = nullptr);
+
+  // single stages of process() on a whole frame, for callers that look at the intermediate images. the detail map is
+  // rgba with the maps of r, g and b in their channels, lab_contrast takes the input as the color transfer output
+  // and runs the local contrast, guided filter and color balance stages on it
+  std::vector<uint8_t> detail_map(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, float sharp_const);
+  bool lab_contrast(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, result & output, const progress_callback & progress = nullptr);
+  bool lab_contrast(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, std::span<uint8_t> output_image, const progress_callback & progress = nullptr);
+
+  // output of the early stages of a full frame: redefine, attenuation map, detail maps, color transfer and the cie-lab
+  // conversion with its statistics. it only depends on the input, the sharp constant, the gamma and the arithmetic,
+  // so the late stages (local contrast, guided filter, color balance) can run again from it when only their
+  // parameters change. enhance_lab_frame gives the same output as process() without image parts
+  struct lab_frame
+  {
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+    float sharp_const = 0.0f;
+    float attenuation_gamma = 0.0f;
+    arithmetic_mode arithmetic = arithmetic_mode::floating_point;
+    std::vector<std::vector<float>> lab; // L, a and b of the floating point path
+    std::vector<std::vector<uint16_t>> lab_fixed; // L, a and b of the fixed point path
+    colormodel::cielab_statistics cielab_stats;
+  };
+
+  bool compose_lab_frame(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const parameters & params, lab_frame & frame, const progress_callback & progress = nullptr);
+  bool enhance_lab_frame(const lab_frame & frame, const parameters & params, result & output, const progress_callback & progress = nullptr);
+  bool lab_frame_valid(const lab_frame & frame, uint32_t image_width, uint32_t image_height, const parameters & params);
+
+  // frames that are read in strips: begin_frame_statistics with the histogram of all rows, add_strip_statistics for
+  // every strip (full width, in row order) and end_frame_statistics. the strips are then processed with process_strip
+  frame_statistics begin_frame_statistics(const color_histogram & histogram, uint32_t image_width, uint32_t image_height, const parameters & params);
+  bool add_strip_statistics(const frame_rows & rows, const region & strip, const frame_statistics & stats, const parameters & params, colormodel::cielab_statistics & cielab_stats, const progress_callback & progress = nullptr);
+  void end_frame_statistics(const colormodel::cielab_statistics & cielab_stats, frame_statistics & stats);
+  bool process_strip(const frame_rows & rows, const frame_statistics & stats, const parameters & params, const region & roi, result & output, const progress_callback & progress = nullptr);
+
+  // rows of the frame add_strip_statistics and process_strip read for a strip or roi
+  region strip_statistics_rows(const region & strip, uint32_t image_width, uint32_t image_height);
+  region strip_input_rows(const region & roi, uint32_t image_width, uint32_t image_height, const parameters & params);
+}
@@ -0,0 +1,960 @@
+#include "processservice.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <list>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+#include "common/cjthread.h"
+#include "stripio.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SERVICE_SOCKET_AVAILABLE 1
+#else
+#define SERVICE_SOCKET_AVAILABLE 0
+#endif
+
+namespace {
+  const std::string service_pool_name = "service";
+  constexpr uint32_t warmup_size = 32;
+  constexpr std::chrono::milliseconds accept_retry_min (10);
+  constexpr std::chrono::milliseconds accept_retry_max (1000);
+
+  // the subset of json a job line needs: one flat object of strings, numbers, booleans and arrays of numbers
+  struct json_value
+  {
+    enum class kind : uint8_t
+    {
+      string,
+      number,
+      boolean,
+      array,
+      null
+    };
+
+    kind type = kind::null;
+    std::string text; // string value, or the number as it was written
+    double number = 0.0;
+    bool boolean = false;
+    std::vector<double> numbers;
+  };
+
+  using json_object = std::unordered_map<std::string, json_value>;
+
+  class jsonreader
+  {
+    public:
+      explicit jsonreader(const std::string & json_text) : text(json_text) {}
+
+      bool readobject(json_object & object, std::string & error)
+      {
+        if (!expect('{'))
+        {
+          error = "expected an object";
+          return false;
+        }
+
+        if (!expect('}'))
+        {
+          do
+          {
+            std::string key;
+            json_value value;
+            if (!readstring(key) || !expect(':') || !readvalue(value))
+            {
+              error = "malformed object at offset " + std::to_string(position);
+              return false;
+            }
+
+            object[key] = std::move(value);
+          }
+          while (expect(','));
+
+          if (!expect('}'))
+          {
+            error = "expected } at offset " + std::to_string(position);
+            return false;
+          }
+        }
+
+        skipspace();
+        if (position != text.size())
+        {
+          error = "trailing characters after the object";
+          return false;
+        }
+
+        return true;
+      }
+
+    private:
+      void skipspace()
+      {
+        while ((position < text.size()) && std::isspace(static_cast<unsigned char>(text[position])))
+        {
+          position++;
+        }
+      }
+
+      bool expect(char c)
+      {
+        skipspace();
+        if ((position < text.size()) && (text[position] == c))
+        {
+          position++;
+          return true;
+        }
+
+        return false;
+      }
+
+      bool readstring(std::string & value)
+      {
+        if (!expect('"'))
+        {
+          return false;
+        }
+
+        while (position < text.size())
+        {
+          const char c = text[position++];
+          if (c == '"')
+          {
+            return true;
+          }
+
+          if (c != '\\')
+          {
+            value.push_back(c);
+            continue;
+          }
+
+          if (position >= text.size())
+          {
+            return false;
+          }
+
+          const char escaped = text[position++];
+          switch (escaped)
+          {
+            case 'b': value.push_back('\b'); break;
+            case 'f': value.push_back('\f'); break;
+            case 'n': value.push_back('\n'); break;
+            case 'r': value.push_back('\r'); break;
+            case 't': value.push_back('\t'); break;
+            case 'u':
+            {
+              // code points of the basic plane as utf-8, surrogate pairs are not combined
+              if ((position + 4) > text.size())
+              {
+                return false;
+              }
+
+              char * end = nullptr;
+              const std::string digits = text.substr(position, 4);
+              const auto code = static_cast<uint32_t>(std::strtoul(digits.c_str(), &end, 16));
+              if (end != (digits.c_str() + 4))
+              {
+                return false;
+              }
+
+              position += 4;
+              if (code < 0x80)
+              {
+                value.push_back(static_cast<char>(code));
+              }
+              else if (code < 0x800)
+              {
+                value.push_back(static_cast<char>(0xc0 | (code >> 6)));
+                value.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+              }
+              else
+              {
+                value.push_back(static_cast<char>(0xe0 | (code >> 12)));
+                value.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+                value.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+              }
+              break;
+            }
+            default:
+              value.push_back(escaped); // \" \\ and \/
+              break;
+          }
+        }
+
+        return false;
+      }
+
+      size_t skipdigits(size_t index) const
+      {
+        while ((index < text.size()) && std::isdigit(static_cast<unsigned char>(text[index])))
+        {
+          index++;
+        }
+
+        return index;
+      }
+
+      // only the json number syntax -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? is taken, strtod alone would also
+      // read inf, nan and hex floats. numbers too large for a double are rejected as well
+      bool readnumber(double & value, std::string & token)
+      {
+        skipspace();
+        size_t end = position;
+        if ((end < text.size()) && (text[end] == '-'))
+        {
+          end++;
+        }
+
+        if ((end < text.size()) && (text[end] == '0'))
+        {
+          end++;
+        }
+        else
+        {
+          const size_t digits = skipdigits(end);
+          if (digits == end)
+          {
+            return false;
+          }
+
+          end = digits;
+        }
+
+        if ((end < text.size()) && (text[end] == '.'))
+        {
+          const size_t digits = skipdigits(end + 1);
+          if (digits == (end + 1))
+          {
+            return false;
+          }
+
+          end = digits;
+        }
+
+        if ((end < text.size()) && ((text[end] == 'e') || (text[end] == 'E')))
+        {
+          end++;
+          if ((end < text.size()) && ((text[end] == '+') || (text[end] == '-')))
+          {
+            end++;
+          }
+
+          const size_t digits = skipdigits(end);
+          if (digits == end)
+          {
+            return false;
+          }
+
+          end = digits;
+        }
+
+        token = text.substr(position, end - position);
+        value = std::strtod(token.c_str(), nullptr);
+        if (!std::isfinite(value))
+        {
+          return false;
+        }
+
+        position = end;
+        return true;
+      }
+
+      bool readliteral(std::string_view literal)
+      {
+        skipspace();
+        if (text.compare(position, literal.size(), literal) != 0)
+        {
+          return false;
+        }
+
+        position += literal.size();
+        return true;
+      }
+
+      bool readvalue(json_value & value)
+      {
+        skipspace();
+        if (position >= text.size())
+        {
+          return false;
+        }
+
+        const char c = text[position];
+        if (c == '"')
+        {
+          value.type = json_value::kind::string;
+          return readstring(value.text);
+        }
+
+        if (c == '[')
+        {
+          position++;
+          value.type = json_value::kind::array;
+          if (expect(']'))
+          {
+            return true;
+          }
+
+          do
+          {
+            double number = 0.0;
+            std::string token;
+            if (!readnumber(number, token))
+            {
+              return false;
+            }
+
+            value.numbers.push_back(number);
+          }
+          while (expect(','));
+
+          return expect(']');
+        }
+
+        if (readliteral("true") || readliteral("false"))
+        {
+          value.type = json_value::kind::boolean;
+          value.boolean = (c == 't');
+          return true;
+        }
+
+        if (readliteral("null"))
+        {
+          value.type = json_value::kind::null;
+          return true;
+        }
+
+        value.type = json_value::kind::number;
+        return readnumber(value.number, value.text);
+      }
+
+      const std::string & text;
+      size_t position = 0;
+  };
+
+  std::string json_string(std::string_view value)
+  {
+    std::string quoted = "\"";
+    for (const char c : value)
+    {
+      switch (c)
+      {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\r': quoted += "\\r"; break;
+        case '\t': quoted += "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20)
+          {
+            quoted += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+          }
+          else
+          {
+            quoted.push_back(c);
+          }
+          break;
+      }
+    }
+
+    return quoted + "\"";
+  }
+
+  struct service_job
+  {
+    std::string id = "null"; // json text of the id, echoed in every line about the job
+    std::string input;
+    std::string output;
+    pipeline::parameters params;
+    pipeline::region roi;
+    bool progress = false;
+  };
+
+  // parameters are never negative, and the value has to fit the parameter type before it is cast
+  template <typename T>
+  bool in_range(double value)
+  {
+    return std::isfinite(value) && (value >= 0.0) && (value <= static_cast<double>(std::numeric_limits<T>::max()));
+  }
+
+  bool read_job(const std::string & line, const pipeline::parameters & defaults, service_job & job, std::string & error)
+  {
+    json_object object;
+    if (!jsonreader(line).readobject(object, error))
+    {
+      return false;
+    }
+
+    job.params = defaults;
+
+    if (const auto id = object.find("id"); id != object.end())
+    {
+      // the id is written back into json lines, so only strings and finite numbers are taken and both are written anew
+      if (id->second.type == json_value::kind::string)
+      {
+        job.id = json_string(id->second.text);
+      }
+      else if ((id->second.type == json_value::kind::number) && std::isfinite(id->second.number))
+      {
+        job.id = fmt::format("{}", id->second.number);
+      }
+      else
+      {
+        error = "id must be a string or a number";
+        return false;
+      }
+    }
+
+    auto string_value = [&](const std::string & key, std::string & value) -> bool {
+      const auto & entry = object.at(key);
+      value = entry.text;
+      return (entry.type == json_value::kind::string);
+    };
+
+    // the range is checked before the cast, a value that does not fit the parameter leaves it unchanged
+    auto number_value = [&](const std::string & key, auto & value) -> bool {
+      using value_type = std::remove_reference_t<decltype(value)>;
+      const auto & entry = object.at(key);
+      if ((entry.type != json_value::kind::number) || !in_range<value_type>(entry.number))
+      {
+        return false;
+      }
+
+      value = static_cast<value_type>(entry.number);
+      return true;
+    };
+
+    auto boolean_value = [&](const std::string & key, bool & value) -> bool {
+      const auto & entry = object.at(key);
+      value = entry.boolean;
+      return (entry.type == json_value::kind::boolean);
+    };
+
+    for (const auto & [key, value] : object)
+    {
+      bool valid = true;
+      if (key == "id")
+      {
+        continue;
+      }
+      else if (key == "input")
+      {
+        valid = string_value(key, job.input);
+      }
+      else if (key == "output")
+      {
+        valid = string_value(key, job.output);
+      }
+      else if (key == "block_size")
+      {
+        valid = number_value(key, job.params.local_block_size) && (job.params.local_block_size > 0);
+      }
+      else if (key == "sharp")
+      {
+        valid = number_value(key, job.params.sharp_const);
+      }
+      else if (key == "enhance")
+      {
+        valid = number_value(key, job.params.enhance_const);
+      }
+      else if (key == "k")
+      {
+        valid = number_value(key, job.params.k_const);
+      }
+      else if (key == "v")
+      {
+        valid = number_value(key, job.params.v_const);
+      }
+      else if (key == "gf_r")
+      {
+        valid = number_value(key, job.params.guided_radius);
+      }
+      else if (key == "gamma")
+      {
+        valid = number_value(key, job.params.attenuation_gamma);
+      }
+      else if (key == "contrast_mode")
+      {
+        std::string mode;
+        valid = string_value(key, mode);
+        if (mode == "block")
+        {
+          job.params.local_contrast_mode = pipeline::contrast_mode::block;
+        }
+        else if (mode == "interpolated")
+        {
+          job.params.local_contrast_mode = pipeline::contrast_mode::interpolated;
+        }
+        else if (mode == "sliding")
+        {
+          job.params.local_contrast_mode = pipeline::contrast_mode::sliding_window;
+        }
+        else
+        {
+          valid = false;
+        }
+      }
+      else if (key == "fp16")
+      {
+        valid = boolean_value(key, job.params.half_storage);
+      }
+      else if (key == "fixed")
+      {
+        bool fixed_point = false;
+        valid = boolean_value(key, fixed_point);
+        job.params.arithmetic = fixed_point ? pipeline::arithmetic_mode::fixed_point : pipeline::arithmetic_mode::floating_point;
+      }
+      else if (key == "progress")
+      {
+        valid = boolean_value(key, job.progress);
+      }
+      else if (key == "roi")
+      {
+        valid = (value.type == json_value::kind::array) && (value.numbers.size() == 4) && std::all_of(value.numbers.begin(), value.numbers.end(), in_range<uint32_t>);
+        if (valid)
+        {
+          job.roi = {static_cast<uint32_t>(value.numbers[0]), static_cast<uint32_t>(value.numbers[1]), static_cast<uint32_t>(value.numbers[2]), static_cast<uint32_t>(value.numbers[3])};
+        }
+      }
+      else
+      {
+        error = "unknown key: " + key;
+        return false;
+      }
+
+      if (!valid)
+      {
+        error = "invalid value for " + key;
+        return false;
+      }
+    }
+
+    if (job.input.empty() || job.output.empty())
+    {
+      error = "input and output are required";
+      return false;
+    }
+
+    return true;
+  }
+
+  std::string error_line(const std::string & id, const std::string & error)
+  {
+    return fmt::format("{{\"id\": {}, \"ok\": false, \"error\": {}}}", id, json_string(error));
+  }
+
+  bool stripio_path(const std::string & path)
+  {
+    const std::string extension = std::filesystem::path(path).extension().string();
+    return (extension == ".ppm") || (extension == ".pam");
+  }
+
+  double elapsed_ms(std::chrono::steady_clock::time_point since)
+  {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+  }
+
+#if SERVICE_SOCKET_AVAILABLE
+  // one client of the socket. the descriptor is closed once the reader and every job of the connection are done
+  struct connection
+  {
+    explicit connection(int connection_fd) : fd(connection_fd) {}
+    ~connection() { ::close(fd); }
+
+    void send(const std::string & line)
+    {
+      std::lock_guard<std::mutex> lock(sendmutex);
+      const std::string data = line + "\n";
+      size_t sent = 0;
+      while (sent < data.size())
+      {
+#ifdef MSG_NOSIGNAL
+        const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#else
+        const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, 0);
+#endif
+        if (n <= 0)
+        {
+          return; // the client went away, the remaining results of its jobs are dropped
+        }
+
+        sent += static_cast<size_t>(n);
+      }
+    }
+
+    int fd;
+    std::mutex sendmutex;
+  };
+#endif
+}
+
+processservice::processservice(const pipeline::parameters & default_params, size_t concurrent_jobs)
+  : defaultParams(default_params)
+  , jobPool(std::max(concurrent_jobs, static_cast<size_t>(1)), service_pool_name)
+{
+}
+
+processservice::~processservice()
+{
+  stop();
+  waitforjobs();
+}
+
+void processservice::setimageio(imageloader image_loader, imagesaver image_saver)
+{
+  loader = std::move(image_loader);
+  saver = std::move(image_saver);
+}
+
+void processservice::warmup()
+{
+  std::vector<uint8_t> pixels (static_cast<size_t>(warmup_size) * warmup_size * 4);
+  for (size_t i=0; i<pixels.size(); i++)
+  {
+    pixels[i] = static_cast<uint8_t>((i * 37) & 0xff);
+  }
+
+  for (const auto arithmetic : {pipeline::arithmetic_mode::floating_point, pipeline::arithmetic_mode::fixed_point})
+  {
+    pipeline::parameters params = defaultParams;
+    params.arithmetic = arithmetic;
+    params.local_block_size = std::min(params.local_block_size, warmup_size / 2);
+    params.guided_radius = std::min(params.guided_radius, warmup_size / 4);
+
+    pipeline::result output;
+    pipeline::process(pixels, warmup_size, warmup_size, params, output, false);
+  }
+}
+
+bool processservice::servestream(std::istream & input, std::ostream & output)
+{
+  std::mutex output_mutex;
+  auto respond = [&output, &output_mutex](const std::string & line) {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    output << line << '\n';
+    output.flush();
+  };
+
+  std::string line;
+  while (running && std::getline(input, line))
+  {
+    submit(line, respond);
+  }
+
+  waitforjobs();
+  return true;
+}
+
+bool processservice::servesocket(const std::string & socket_path)
+{
+#if SERVICE_SOCKET_AVAILABLE
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+  {
+    spdlog::critical("socket path is too long: {}", socket_path);
+    return false;
+  }
+
+  std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+  {
+    spdlog::critical("unable to create socket: {}", socket_path);
+    return false;
+  }
+
+  ::unlink(socket_path.c_str()); // left behind by a previous run
+  if ((::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) || (::listen(fd, SOMAXCONN) != 0))
+  {
+    spdlog::critical("unable to listen on socket: {}", socket_path);
+    ::close(fd);
+    return false;
+  }
+
+  listenSocket = fd;
+  spdlog::info("listening on {}", socket_path);
+
+  // the reader and the jobs of a client own its connection, so the client sees the end of the stream once the
+  // last result is sent
+  struct client
+  {
+    std::weak_ptr<connection> link;
+    std::unique_ptr<cjthread> reader;
+  };
+
+  std::list<client> clients;
+  auto retry_delay = accept_retry_min;
+
+  while (running)
+  {
+    const int connection_fd = ::accept(fd, nullptr, nullptr);
+    if (connection_fd < 0)
+    {
+      const int accept_error = errno;
+      if (!running)
+      {
+        break; // the socket was shut down by stop()
+      }
+
+      if ((accept_error == EINTR) || (accept_error == ECONNABORTED))
+      {
+        continue;
+      }
+
+      // out of descriptors or memory, retrying at once would only spin. finished clients release theirs meanwhile
+      spdlog::warn("unable to accept a connection, retrying in {} ms: {}", retry_delay.count(), std::strerror(accept_error));
+      std::this_thread::sleep_for(retry_delay);
+      retry_delay = std::min(retry_delay * 2, accept_retry_max);
+      clients.remove_if([](const client & c) { return c.link.expired(); });
+      continue;
+    }
+
+    retry_delay = accept_retry_min;
+
+    // joins the readers of clients that are done
+    clients.remove_if([](const client & c) { return c.link.expired(); });
+
+    auto link = std::make_shared<connection>(connection_fd);
+    clients.push_back({link, std::make_unique<cjthread>("service_client", [this, link]() {
+      auto respond = [link](const std::string & line) { link->send(line); };
+      std::string pending;
+      char buffer[4096];
+
+      while (true)
+      {
+        const ssize_t n = ::recv(link->fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+        {
+          break;
+        }
+
+        pending.append(buffer, static_cast<size_t>(n));
+        size_t line_end = 0;
+        while ((line_end = pending.find('\n')) != std::string::npos)
+        {
+          submit(pending.substr(0, line_end), respond);
+          pending.erase(0, line_end + 1);
+        }
+      }
+
+      if (!pending.empty())
+      {
+        submit(pending, respond);
+      }
+    })});
+  }
+
+  // readers still waiting on their clients stop once the read side is closed
+  for (auto & c : clients)
+  {
+    if (const auto link = c.link.lock())
+    {
+      ::shutdown(link->fd, SHUT_RD);
+    }
+  }
+
+  clients.clear();
+  waitforjobs();
+
+  ::close(fd);
+  ::unlink(socket_path.c_str());
+  return true;
+#else
+  spdlog::critical("unix domain sockets are not available on this platform, use the stream mode: {}", socket_path);
+  return false;
+#endif
+}
+
+void processservice::stop()
+{
+  running = false;
+
+#if SERVICE_SOCKET_AVAILABLE
+  const int fd = listenSocket.exchange(-1);
+  if (fd >= 0)
+  {
+    ::shutdown(fd, SHUT_RDWR); // wakes up accept
+  }
+#endif
+}
+
+void processservice::submit(const std::string & line, const responder & respond)
+{
+  if (line.find_first_not_of(" \t\r") == std::string::npos)
+  {
+    return;
+  }
+
+  auto job = std::make_shared<service_job>();
+  std::string error;
+  if (!read_job(line, defaultParams, *job, error))
+  {
+    respond(error_line(job->id, error));
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(jobmutex);
+    pendingJobs++;
+  }
+
+  jobPool.addjob([this, job, respond]() {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<jobscratch> scratch;
+    {
+      std::lock_guard<std::mutex> lock(jobmutex);
+      if (!freeScratch.empty())
+      {
+        scratch = std::move(freeScratch.back());
+        freeScratch.pop_back();
+      }
+    }
+
+    if (!scratch)
+    {
+      scratch = std::make_unique<jobscratch>();
+    }
+
+    std::vector<uint8_t> & pixels = scratch->pixels;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::string error;
+    pipeline::result & output = scratch->output;
+    double load_ms = 0.0;
+    double process_ms = 0.0;
+    double save_ms = 0.0;
+
+    uint32_t reported_percent = 0;
+    auto progress = [&](float value) -> bool {
+      const auto percent = static_cast<uint32_t>(value * 100.0f);
+      if (job->progress && (percent >= (reported_percent + 10)))
+      {
+        reported_percent = percent;
+        respond(fmt::format("{{\"id\": {}, \"progress\": {:.2f}}}", job->id, value));
+      }
+
+      return running.load();
+    };
+
+    if (!loadimage(job->input, pixels, width, height))
+    {
+      error = "unable to load " + job->input;
+    }
+    else
+    {
+      load_ms = elapsed_ms(start);
+      const auto process_start = std::chrono::steady_clock::now();
+
+      bool processed = false;
+      if (job->roi.empty())
+      {
+        processed = pipeline::process(pixels, width, height, job->params, output, false, progress);
+      }
+      else
+      {
+        pipeline::region roi;
+        roi.x = std::min(job->roi.x, width - 1);
+        roi.y = std::min(job->roi.y, height - 1);
+        roi.width = std::clamp(job->roi.width, 1u, width - roi.x);
+        roi.height = std::clamp(job->roi.height, 1u, height - roi.y);
+
+        pipeline::frame_statistics stats;
+        processed = pipeline::compute_frame_statistics(pixels, width, height, job->params, stats, [&progress](float value) { return progress(value * 0.5f); })
+                 && pipeline::process_region(pixels, width, height, stats, job->params, roi, output, false, [&progress](float value) { return progress(0.5f + (value * 0.5f)); });
+      }
+
+      process_ms = elapsed_ms(process_start);
+      const auto save_start = std::chrono::steady_clock::now();
+
+      if (!processed)
+      {
+        error = "processing failed or was cancelled";
+      }
+      else if (!saveimage(job->output, output.color_corrected_image, output.image_width, output.image_height))
+      {
+        error = "unable to save " + job->output;
+      }
+
+      save_ms = elapsed_ms(save_start);
+    }
+
+    if (error.empty())
+    {
+      respond(fmt::format("{{\"id\": {}, \"ok\": true, \"output\": {}, \"width\": {}, \"height\": {}, \"timings\": {{\"load_ms\": {:.2f}, \"process_ms\": {:.2f}, \"save_ms\": {:.2f}, \"total_ms\": {:.2f}}}}}"
+                         ,job->id, json_string(job->output), output.image_width, output.image_height, load_ms, process_ms, save_ms, elapsed_ms(start)));
+    }
+    else
+    {
+      spdlog::warn("job {}: {}", job->id, error);
+      respond(error_line(job->id, error));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(jobmutex);
+      freeScratch.push_back(std::move(scratch));
+      pendingJobs--;
+    }
+
+    cvJobsDone.notify_all();
+  });
+}
+
+void processservice::waitforjobs()
+{
+  std::unique_lock<std::mutex> lock(jobmutex);
+  cvJobsDone.wait(lock, [this]() -> bool {
+    return (pendingJobs == 0);
+  });
+}
+
+bool processservice::loadimage(const std::string & path, std::vector<uint8_t> & pixels, uint32_t & width, uint32_t & height)
+{
+  if (stripio_path(path) || !loader)
+  {
+    stripreader reader;
+    pipeline::frame_rows rows;
+    rows.pixels = std::move(pixels); // read() resizes, so the buffer of the previous job is reused
+    const bool read = reader.open(path) && reader.read(0, reader.height(), rows);
+    pixels = std::move(rows.pixels);
+    if (!read)
+    {
+      return false;
+    }
+
+    width = reader.width();
+    height = reader.height();
+    return true;
+  }
+
+  return loader(path, pixels, width, height);
+}
+
+bool processservice::saveimage(const std::string & path, const std::vector<uint8_t> & pixels, uint32_t width, uint32_t height)
+{
+  if (stripio_path(path) || !saver)
+  {
+    stripwriter writer;
+    return writer.open(path, width, height) && writer.write(pixels.data(), height) && writer.close();
+  }
+
+  return saver(path, pixels, width, height);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "common/cthreadpool.h"
+#include "pipeline.h"
+
+// long running mode for batch callers. jobs are json objects, one per line, read from a stream (stdin) or from the
+// connections of a unix domain socket:
+//   {"id": "a1", "input": "in.png", "output": "out.png", "fixed": true, "roi": [0, 0, 640, 480], "progress": true}
+// the other keys are block_size, sharp, enhance, k, v, gf_r, gamma, contrast_mode and fp16, missing keys keep the
+// defaults given to the service. the id is a string or a number. every job is answered on the same stream with one
+// line, in completion order:
+//   {"id": "a1", "ok": true, "output": "out.png", "width": 640, "height": 480, "timings": {"load_ms": ...}}
+//   {"id": "a1", "ok": false, "error": "..."}
+// jobs run concurrently on the service pool, the image kernels share the imageops pool and their tables, both stay
+// warm between jobs. the input pixels and the result image of a job are kept in a scratch slot that the next job
+// reuses, the planes inside the pipeline are still allocated per job
+class processservice
+{
+  public:
+    // rgba pixels, .ppm and .pam files are handled by the service itself
+    using imageloader = std::function<bool(const std::string & path, std::vector<uint8_t> & pixels, uint32_t & width, uint32_t & height)>;
+    using imagesaver = std::function<bool(const std::string & path, const std::vector<uint8_t> & pixels, uint32_t width, uint32_t height)>;
+
+    processservice(const pipeline::parameters & default_params, size_t concurrent_jobs);
+    ~processservice();
+
+    processservice(const processservice &) = delete;
+    processservice & operator=(const processservice &) = delete;
+
+    void setimageio(imageloader loader, imagesaver saver);
+
+    // runs a small frame through every arithmetic so the lookup tables and pool threads exist before the first job
+    void warmup();
+
+    // returns at the end of the input once every job read from it is answered
+    bool servestream(std::istream & input, std::ostream & output);
+    // accepts connections until stop() is called, returns false if the socket can not be created
+    bool servesocket(const std::string & socket_path);
+    void stop();
+
+  private:
+    using responder = std::function<void(const std::string &)>;
+
+    struct jobscratch
+    {
+      std::vector<uint8_t> pixels;
+      pipeline::result output;
+    };
+
+    void submit(const std::string & line, const responder & respond);
+    void waitforjobs();
+
+    bool loadimage(const std::string & path, std::vector<uint8_t> & pixels, uint32_t & width, uint32_t & height);
+    bool saveimage(const std::string & path, const std::vector<uint8_t> & pixels, uint32_t width, uint32_t height);
+
+    pipeline::parameters defaultParams;
+    imageloader loader;
+    imagesaver saver;
+
+    std::mutex jobmutex;
+    std::condition_variable cvJobsDone;
+    size_t pendingJobs = 0;
+    std::vector<std::unique_ptr<jobscratch>> freeScratch; // at most one per concurrent job
+
+    std::atomic<bool> running = true;
+    std::atomic<int> listenSocket = -1;
+
+    cthreadpool jobPool; // keep last so everything above is constructed before the threads start
+};
@@ -0,0 +1,220 @@
+#include "processworker.h"
+
+#include <spdlog/spdlog.h>
+
+#include "imageops/parallel.h"
+
+namespace {
+  const std::string worker_thread_name = "process_worker";
+}
+
+processworker::processworker()
+  : worker(worker_thread_name, &processworker::workertask, this)
+{
+}
+
+processworker::~processworker()
+{
+  {
+    std::lock_guard<std::mutex> lock(requestmutex);
+    running = false;
+    latestRequest++; // invalidates the request in flight so it stops at the next progress report
+  }
+
+  cvRequestAvailable.notify_all();
+}
+
+void processworker::setinput(std::shared_ptr<const processimage> image)
+{
+  std::lock_guard<std::mutex> lock(requestmutex);
+  inputImage = std::move(image);
+}
+
+void processworker::setoncomplete(std::function<void(const processresult &)> on_complete)
+{
+  std::lock_guard<std::mutex> lock(requestmutex);
+  onComplete = std::move(on_complete);
+}
+
+uint64_t processworker::request(const pipeline::parameters & params, bool export_parts, uint32_t level, const pipeline::region & roi)
+{
+  uint64_t request_id;
+
+  {
+    std::lock_guard<std::mutex> lock(requestmutex);
+    pendingParams = params;
+    pendingExport = export_parts;
+    pendingLevel = level;
+    pendingRegion = roi;
+    pendingRequest = true;
+    request_id = ++latestRequest; // any request still processing is now stale
+  }
+
+  cvRequestAvailable.notify_all();
+
+  return request_id;
+}
+
+void processworker::cancel()
+{
+  std::lock_guard<std::mutex> lock(requestmutex);
+  pendingRequest = false;
+  latestRequest++;
+}
+
+std::shared_ptr<processworker::processresult> processworker::takeresult()
+{
+  return readyResult.exchange(nullptr);
+}
+
+float processworker::progress() const
+{
+  return currentProgress;
+}
+
+bool processworker::busy() const
+{
+  return processing;
+}
+
+void processworker::workertask()
+{
+  while (true)
+  {
+    std::shared_ptr<const processimage> image;
+    std::function<void(const processresult &)> on_complete;
+    auto result = std::make_shared<processresult>();
+
+    {
+      std::unique_lock<std::mutex> lock(requestmutex);
+      cvRequestAvailable.wait(lock, [this]() -> bool {
+        return (!running || pendingRequest);
+      });
+
+      if (!running)
+      {
+        break;
+      }
+
+      image = inputImage;
+      on_complete = onComplete;
+      result->params = pendingParams;
+      result->exportrequested = pendingExport;
+      result->level = pendingLevel;
+      result->region = pendingRegion;
+      result->requestid = latestRequest;
+      pendingRequest = false;
+    }
+
+    if (!image || image->pixels.empty())
+    {
+      continue;
+    }
+
+    // previews run on a smaller pyramid level with the spatial parameters scaled to match
+
+    const std::vector<uint8_t> * pixels = &image->pixels;
+    uint32_t width = image->width;
+    uint32_t height = image->height;
+    pipeline::parameters params = result->params;
+
+    if ((result->level > 0) && (result->level <= image->levels.size()))
+    {
+      const auto & level = image->levels[result->level - 1];
+      pixels = &level.pixels;
+      width = level.image_width;
+      height = level.image_height;
+      result->scale = level.scale;
+      params = pipeline::scale_parameters(result->params, level.scale);
+    }
+    else
+    {
+      result->level = 0;
+    }
+
+    if (result->region.empty())
+    {
+      result->region = {0, 0, image->width, image->height};
+    }
+
+    processing = true;
+    currentProgress = 0.0f;
+
+    // previews are what the user waits for, full resolution and exports queue behind other work in the pool
+    imageops::set_parallel_priority((result->level > 0) ? cthreadpool::jobpriority::interactive : cthreadpool::jobpriority::background);
+
+    auto report_progress = [this, request_id = result->requestid](float value) -> bool {
+      currentProgress = value;
+      return (request_id == latestRequest);
+    };
+
+    // frame statistics only depend on the image, the sharp constant, the gamma and the arithmetic so they are kept
+    // between requests. a full frame request without them computes them in the same run
+
+    bool completed = true;
+    bool processed = false;
+    float statistics_progress = 0.0f;
+
+    const bool same_image = !cachedStatsImage.expired() && !cachedStatsImage.owner_before(image) && !image.owner_before(cachedStatsImage);
+    if (!same_image)
+    {
+      cachedStats.clear();
+      cachedStatsImage = image;
+    }
+
+    pipeline::frame_statistics & stats = cachedStats[result->level];
+    const pipeline::region roi = pipeline::scale_region(result->region, result->scale, width, height);
+
+    if (!pipeline::statistics_valid(stats, width, height, params))
+    {
+      if (roi == pipeline::region{0, 0, width, height})
+      {
+        processed = true;
+        completed = pipeline::process(*pixels, width, height, params, result->output, stats, result->exportrequested, report_progress);
+      }
+      else
+      {
+        statistics_progress = 0.5f;
+        completed = pipeline::compute_frame_statistics(*pixels
+                                                      ,width
+                                                      ,height
+                                                      ,params
+                                                      ,stats
+                                                      ,[&report_progress, statistics_progress](float value) -> bool {
+                                                         return report_progress(value * statistics_progress);
+                                                       });
+      }
+    }
+
+    if (completed && !processed)
+    {
+      completed = pipeline::process_region(*pixels
+                                          ,width
+                                          ,height
+                                          ,stats
+                                          ,params
+                                          ,roi
+                                          ,result->output
+                                          ,result->exportrequested
+                                          ,[&report_progress, statistics_progress](float value) -> bool {
+                                             return report_progress(statistics_progress + (value * (1.0f - statistics_progress)));
+                                           });
+    }
+
+    if (completed && (result->requestid == latestRequest))
+    {
+      if (on_complete)
+      {
+        on_complete(*result);
+      }
+
+      readyResult.store(result);
+    }
+    else
+    {
+      spdlog::info("processing request {} cancelled", result->requestid);
+    }
+
+    processing = false;
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+
+#include "common/cjthread.h"
+#include "pipeline.h"
+
+class processworker
+{
+  public:
+    struct processimage
+    {
+      std::vector<uint8_t> pixels; // rgba
+      uint32_t width = 0;
+      uint32_t height = 0;
+      std::vector<pipeline::image_level> levels; // preview pyramid, levels[0] is half of the full resolution
+    };
+
+    struct processresult
+    {
+      pipeline::result output;
+      pipeline::parameters params;
+      uint64_t requestid = 0;
+      uint32_t level = 0; // 0 is full resolution otherwise (level - 1) is the index of the preview level
+      uint32_t scale = 1;
+      pipeline::region region; // requested region in full resolution pixels
+      bool exportrequested = false;
+    };
+
+    processworker();
+    ~processworker();
+
+    processworker(const processworker &) = delete;
+    processworker & operator=(const processworker &) = delete;
+
+    void setinput(std::shared_ptr<const processimage> image);
+    void setoncomplete(std::function<void(const processresult &)> on_complete);
+
+    uint64_t request(const pipeline::parameters & params, bool export_parts = false, uint32_t level = 0, const pipeline::region & roi = {});
+    void cancel();
+
+    [[nodiscard]] std::shared_ptr<processresult> takeresult();
+    [[nodiscard]] float progress() const;
+    [[nodiscard]] bool busy() const;
+
+  private:
+    void workertask();
+
+    std::shared_ptr<const processimage> inputImage;
+    std::function<void(const processresult &)> onComplete;
+
+    pipeline::parameters pendingParams;
+    bool pendingExport = false;
+    uint32_t pendingLevel = 0;
+    pipeline::region pendingRegion;
+    bool pendingRequest = false;
+
+    // only used by the worker thread. the gui alternates between a preview level and full resolution, so the
+    // statistics are kept per level of the image
+    std::unordered_map<uint32_t, pipeline::frame_statistics> cachedStats;
+    std::weak_ptr<const processimage> cachedStatsImage;
+
+    std::atomic<uint64_t> latestRequest = 0;
+    std::atomic<float> currentProgress = 0.0f;
+    std::atomic<bool> processing = false;
+    std::atomic<std::shared_ptr<processresult>> readyResult;
+
+    std::mutex requestmutex;
+    std::condition_variable cvRequestAvailable;
+    bool running = true;
+
+    cjthread worker; // keep last so everything above is constructed before the thread starts
+};
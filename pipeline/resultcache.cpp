@@ -0,0 +1,341 @@
+#include "resultcache.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+#include <spdlog/spdlog.h>
+
+#include "imageops/parallel.h"
+
+namespace {
+
+  constexpr char cache_magic[8] = {'U', 'W', 'I', 'E', 'L', 'A', 'B', '\0'};
+  constexpr uint32_t cache_version = 1;
+  constexpr size_t plane_alignment = 64;
+  const std::string cache_extension = ".uwlab";
+
+  // blocks are hashed in parallel and combined in order, so the hash does not depend on the thread count
+  constexpr size_t hash_block = 1 << 20;
+
+  constexpr uint64_t prime_1 = 0x9e3779b185ebca87ull;
+  constexpr uint64_t prime_2 = 0xc2b2ae3d27d4eb4full;
+  constexpr uint64_t prime_3 = 0x165667b19e3779f9ull;
+
+  struct entry_header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t image_width;
+    uint32_t image_height;
+    uint32_t arithmetic;
+    float sharp_const;
+    float attenuation_gamma;
+    uint64_t input_hash;
+    uint64_t count;
+    double l_sum;
+    double l_m2;
+    double a_sum;
+    double b_sum;
+    float l_min;
+    float l_max;
+    float a_max;
+    float b_max;
+    uint64_t plane_offsets[3];
+    uint64_t plane_bytes;
+  };
+
+  static_assert(std::is_trivially_copyable_v<entry_header> && ((sizeof(entry_header) % plane_alignment) == 0));
+
+  uint64_t avalanche(uint64_t h)
+  {
+    h ^= h >> 33;
+    h *= prime_2;
+    h ^= h >> 29;
+    h *= prime_3;
+    h ^= h >> 32;
+    return h;
+  }
+
+  uint64_t hash_bytes(const uint8_t * data, size_t size, uint64_t seed)
+  {
+    // four independent lanes of 8 byte words so the multiplies of a 32 byte stripe overlap
+    uint64_t lanes[4] = {seed + prime_1 + prime_2, seed + prime_2, seed, seed - prime_1};
+    size_t i = 0;
+    for (; (i + 32)<=size; i+=32)
+    {
+      for (size_t k=0; k<4; k++)
+      {
+        uint64_t word;
+        std::memcpy(&word, data + i + (k * 8), sizeof(word));
+        lanes[k] = std::rotl(lanes[k] + (word * prime_2), 31) * prime_1;
+      }
+    }
+
+    uint64_t h = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+    for (; i<size; i++)
+    {
+      h = std::rotl(h ^ (static_cast<uint64_t>(data[i]) * prime_3), 11) * prime_1;
+    }
+
+    return avalanche(h ^ size);
+  }
+
+  size_t aligned_size(size_t size)
+  {
+    return ((size + plane_alignment - 1) / plane_alignment) * plane_alignment;
+  }
+
+  template <typename value_type>
+  bool read_planes(std::ifstream & file, const entry_header & header, std::vector<std::vector<value_type>> & planes)
+  {
+    const size_t image_size = static_cast<size_t>(header.image_width) * header.image_height;
+    if (header.plane_bytes != (image_size * sizeof(value_type)))
+    {
+      return false;
+    }
+
+    planes.assign(3, std::vector<value_type>(image_size));
+    for (size_t c=0; c<3; c++)
+    {
+      file.seekg(static_cast<std::streamoff>(header.plane_offsets[c]));
+      if (!file.read(reinterpret_cast<char *>(planes[c].data()), static_cast<std::streamsize>(header.plane_bytes)))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  template <typename value_type>
+  bool write_planes(std::ofstream & file, const std::vector<std::vector<value_type>> & planes)
+  {
+    const std::vector<char> padding (plane_alignment, 0);
+    for (const auto & plane : planes)
+    {
+      const size_t plane_bytes = plane.size() * sizeof(value_type);
+      file.write(reinterpret_cast<const char *>(plane.data()), static_cast<std::streamsize>(plane_bytes));
+      file.write(padding.data(), static_cast<std::streamsize>(aligned_size(plane_bytes) - plane_bytes));
+    }
+
+    return static_cast<bool>(file);
+  }
+}
+
+resultcache::resultcache(const std::string & cache_directory)
+{
+  std::error_code error;
+  std::filesystem::create_directories(cache_directory, error);
+  if (error || !std::filesystem::is_directory(cache_directory))
+  {
+    spdlog::warn("unable to use cache directory {}: {}", cache_directory, error.message());
+    return;
+  }
+
+  directory = cache_directory;
+}
+
+uint64_t resultcache::inputhash(std::span<const uint8_t> input_image)
+{
+  const size_t n_blocks = (input_image.size() + hash_block - 1) / hash_block;
+  std::vector<uint64_t> block_hashes (n_blocks);
+
+  imageops::parallel_for(0, n_blocks, 1, [&](size_t first, size_t last) {
+    for (size_t b=first; b<last; b++)
+    {
+      const size_t offset = b * hash_block;
+      block_hashes[b] = hash_bytes(input_image.data() + offset, std::min(hash_block, input_image.size() - offset), b);
+    }
+  });
+
+  uint64_t h = prime_3 ^ input_image.size();
+  for (const uint64_t block_hash : block_hashes)
+  {
+    h = avalanche(h ^ block_hash) * prime_1;
+  }
+
+  return avalanche(h);
+}
+
+std::string resultcache::entrypath(uint64_t input_hash, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params) const
+{
+  // the early stage parameters go into the name, the header repeats them so a collision is never used
+  uint64_t key = input_hash;
+  for (const uint64_t value : {static_cast<uint64_t>(image_width), static_cast<uint64_t>(image_height), static_cast<uint64_t>(std::bit_cast<uint32_t>(params.sharp_const))
+                              ,static_cast<uint64_t>(std::bit_cast<uint32_t>(params.attenuation_gamma)), static_cast<uint64_t>(params.arithmetic)})
+  {
+    key = avalanche(key ^ (value * prime_2));
+  }
+
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << key << cache_extension;
+  return (std::filesystem::path(directory) / name.str()).string();
+}
+
+bool resultcache::load(uint64_t input_hash, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params, pipeline::lab_frame & frame) const
+{
+  if (!valid())
+  {
+    return false;
+  }
+
+  const std::string path = entrypath(input_hash, image_width, image_height, params);
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
+
+  entry_header header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+  {
+    spdlog::warn("cache entry is truncated: {}", path);
+    return false;
+  }
+
+  const bool same_entry = (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0) && (header.version == cache_version) && (header.input_hash == input_hash)
+                          && (header.image_width == image_width) && (header.image_height == image_height) && (header.arithmetic == static_cast<uint32_t>(params.arithmetic))
+                          && (header.sharp_const == params.sharp_const) && (header.attenuation_gamma == params.attenuation_gamma);
+  if (!same_entry)
+  {
+    return false;
+  }
+
+  frame = {};
+  frame.image_width = image_width;
+  frame.image_height = image_height;
+  frame.sharp_const = header.sharp_const;
+  frame.attenuation_gamma = header.attenuation_gamma;
+  frame.arithmetic = params.arithmetic;
+  frame.cielab_stats.count = header.count;
+  frame.cielab_stats.l_sum = header.l_sum;
+  frame.cielab_stats.l_m2 = header.l_m2;
+  frame.cielab_stats.a_sum = header.a_sum;
+  frame.cielab_stats.b_sum = header.b_sum;
+  frame.cielab_stats.l_min = header.l_min;
+  frame.cielab_stats.l_max = header.l_max;
+  frame.cielab_stats.a_max = header.a_max;
+  frame.cielab_stats.b_max = header.b_max;
+
+  const bool read = (params.arithmetic == pipeline::arithmetic_mode::fixed_point) ? read_planes(file, header, frame.lab_fixed) : read_planes(file, header, frame.lab);
+  if (!read)
+  {
+    spdlog::warn("cache entry is damaged: {}", path);
+    frame = {};
+    return false;
+  }
+
+  return true;
+}
+
+bool resultcache::store(uint64_t input_hash, const pipeline::lab_frame & frame) const
+{
+  pipeline::parameters params;
+  params.sharp_const = frame.sharp_const;
+  params.attenuation_gamma = frame.attenuation_gamma;
+  params.arithmetic = frame.arithmetic;
+
+  if (!valid() || !pipeline::lab_frame_valid(frame, frame.image_width, frame.image_height, params))
+  {
+    return false;
+  }
+
+  const bool fixed_point = (frame.arithmetic == pipeline::arithmetic_mode::fixed_point);
+  const size_t image_size = static_cast<size_t>(frame.image_width) * frame.image_height;
+
+  entry_header header = {};
+  std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+  header.version = cache_version;
+  header.image_width = frame.image_width;
+  header.image_height = frame.image_height;
+  header.arithmetic = static_cast<uint32_t>(frame.arithmetic);
+  header.sharp_const = frame.sharp_const;
+  header.attenuation_gamma = frame.attenuation_gamma;
+  header.input_hash = input_hash;
+  header.count = frame.cielab_stats.count;
+  header.l_sum = frame.cielab_stats.l_sum;
+  header.l_m2 = frame.cielab_stats.l_m2;
+  header.a_sum = frame.cielab_stats.a_sum;
+  header.b_sum = frame.cielab_stats.b_sum;
+  header.l_min = frame.cielab_stats.l_min;
+  header.l_max = frame.cielab_stats.l_max;
+  header.a_max = frame.cielab_stats.a_max;
+  header.b_max = frame.cielab_stats.b_max;
+  header.plane_bytes = image_size * (fixed_point ? sizeof(uint16_t) : sizeof(float));
+  for (size_t c=0; c<3; c++)
+  {
+    header.plane_offsets[c] = sizeof(header) + (c * aligned_size(header.plane_bytes));
+  }
+
+  const std::string path = entrypath(input_hash, frame.image_width, frame.image_height, params);
+  const auto writer_id = std::hash<std::thread::id>{}(std::this_thread::get_id()) ^ static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+  const std::string temporary_path = path + ".tmp" + std::to_string(writer_id);
+
+  bool written = false;
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (file)
+    {
+      file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      written = fixed_point ? write_planes(file, frame.lab_fixed) : write_planes(file, frame.lab);
+      file.close();
+      written = written && !file.fail();
+    }
+  }
+
+  std::error_code error;
+  if (written)
+  {
+    std::filesystem::rename(temporary_path, path, error);
+  }
+
+  if (!written || error)
+  {
+    spdlog::warn("unable to write cache entry {}", path);
+    std::filesystem::remove(temporary_path, error);
+    return false;
+  }
+
+  return true;
+}
+
+bool resultcache::process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params, pipeline::result & output, bool * cache_hit, const pipeline::progress_callback & progress) const
+{
+  const uint64_t input_hash = inputhash(input_image);
+
+  pipeline::lab_frame frame;
+  const bool hit = load(input_hash, image_width, image_height, params, frame);
+  if (cache_hit != nullptr)
+  {
+    *cache_hit = hit;
+  }
+
+  // the early stages take about half of the time of a frame
+  const float early_share = hit ? 0.0f : 0.5f;
+  if (!hit)
+  {
+    const bool composed = pipeline::compose_lab_frame(input_image, image_width, image_height, params, frame, [&progress, early_share](float value) -> bool {
+      return !progress || progress(value * early_share);
+    });
+
+    if (!composed)
+    {
+      return false;
+    }
+
+    store(input_hash, frame);
+  }
+
+  return pipeline::enhance_lab_frame(frame, params, output, [&progress, early_share](float value) -> bool {
+    return !progress || progress(early_share + (value * (1.0f - early_share)));
+  });
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "pipeline.h"
+
+// on disk cache of the early stages of full frames (pipeline::lab_frame) for runs over the same images with other
+// late stage parameters (enhance, k, v, guided filter radius, block size, contrast mode, fp16). entries are keyed by
+// a hash of the input pixels and the early stage parameters (sharp, gamma, arithmetic), one file per entry:
+//   header: magic, version, size, parameters, input hash and the cie-lab statistics
+//   planes: L, a and b (float or 16-bit), each starting at a multiple of 64 bytes so the file can be mapped
+// entries are written to a temporary file and renamed, so concurrent jobs never read half written entries
+class resultcache
+{
+  public:
+    explicit resultcache(const std::string & cache_directory);
+
+    [[nodiscard]] bool valid() const { return !directory.empty(); }
+
+    [[nodiscard]] static uint64_t inputhash(std::span<const uint8_t> input_image);
+
+    bool load(uint64_t input_hash, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params, pipeline::lab_frame & frame) const;
+    bool store(uint64_t input_hash, const pipeline::lab_frame & frame) const;
+
+    // process() of a full frame without image parts, the early stages are read from the cache when the entry exists
+    // and stored otherwise. cache_hit tells which one happened
+    bool process(std::span<const uint8_t> input_image, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params, pipeline::result & output, bool * cache_hit = nullptr, const pipeline::progress_callback & progress = nullptr) const;
+
+  private:
+    [[nodiscard]] std::string entrypath(uint64_t input_hash, uint32_t image_width, uint32_t image_height, const pipeline::parameters & params) const;
+
+    std::string directory;
+};
@@ -0,0 +1,71 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common/testcheck.h"
+#include "pipeline/pipeline.h"
+#include "pipeline/resultcache.h"
+
+namespace {
+  constexpr uint32_t image_width = 143;
+  constexpr uint32_t image_height = 89;
+
+  void check_cached(const resultcache & cache, const std::vector<uint8_t> & input, const pipeline::parameters & params, bool expect_hit, const std::string & name)
+  {
+    pipeline::result output;
+    bool hit = !expect_hit;
+    testcheck::check(cache.process(input, image_width, image_height, params, output, &hit), name + ": processed");
+    testcheck::check(hit == expect_hit, name + (expect_hit ? ": cache hit" : ": cache miss"));
+
+    pipeline::result expected;
+    pipeline::process(input, image_width, image_height, params, expected, false);
+    testcheck::check(testcheck::max_difference(output.color_corrected_image, expected.color_corrected_image) == 0, name + ": output matches process()");
+  }
+}
+
+int main()
+{
+  const auto directory = std::filesystem::temp_directory_path() / "uwie_resultcache_test";
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+
+  const resultcache cache (directory.string());
+  if (!testcheck::check(cache.valid(), "cache directory is created"))
+  {
+    return testcheck::result();
+  }
+
+  const auto input = testcheck::synthetic_frame(image_width, image_height);
+  for (const auto arithmetic : {pipeline::arithmetic_mode::floating_point, pipeline::arithmetic_mode::fixed_point})
+  {
+    const std::string name = (arithmetic == pipeline::arithmetic_mode::fixed_point) ? "fixed point" : "floating point";
+
+    pipeline::parameters params;
+    params.arithmetic = arithmetic;
+    check_cached(cache, input, params, false, name + " first run");
+    check_cached(cache, input, params, true, name + " second run");
+
+    // the late stages run from the cached entry with their own parameters
+    params.enhance_const *= 1.5f;
+    params.k_const *= 0.5f;
+    params.v_const *= 2.0f;
+    params.local_contrast_mode = pipeline::contrast_mode::interpolated;
+    check_cached(cache, input, params, true, name + " other late stage parameters");
+
+    // the early stage parameters are part of the key
+    params.sharp_const *= 2.0f;
+    check_cached(cache, input, params, false, name + " other sharp constant");
+  }
+
+  // fp16 shares the entries of fp32
+  pipeline::parameters params;
+  params.half_storage = true;
+  check_cached(cache, input, params, true, "fp16");
+
+  auto other_input = input;
+  other_input[(other_input.size() / 2) + 1] ^= 0x10;
+  check_cached(cache, other_input, params, false, "other input pixels");
+
+  std::filesystem::remove_all(directory, error);
+  return testcheck::result();
+}
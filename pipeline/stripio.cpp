@@ -0,0 +1,270 @@
+#include "stripio.h"
+
+#include <cctype>
+#include <filesystem>
+#include <limits>
+#include <sstream>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+
+  // next whitespace separated token of a ppm header, comments run to the end of the line
+  std::string header_token(std::istream & stream)
+  {
+    std::string token;
+    int c = stream.get();
+
+    while (c != EOF)
+    {
+      if (c == '#')
+      {
+        while ((c != EOF) && (c != '\n'))
+        {
+          c = stream.get();
+        }
+      }
+      else if (!std::isspace(c))
+      {
+        break;
+      }
+
+      c = stream.get();
+    }
+
+    // the single whitespace after the last token is consumed with it, the pixel data follows
+    while ((c != EOF) && !std::isspace(c))
+    {
+      token.push_back(static_cast<char>(c));
+      c = stream.get();
+    }
+
+    return token;
+  }
+
+  bool parse_size(const std::string & token, uint32_t & value)
+  {
+    try
+    {
+      const unsigned long parsed = std::stoul(token);
+      value = static_cast<uint32_t>(parsed);
+      return (parsed > 0) && (parsed <= std::numeric_limits<uint32_t>::max());
+    }
+    catch (const std::exception &)
+    {
+      return false;
+    }
+  }
+}
+
+bool stripreader::open(const std::string & path, uint32_t raw_width, uint32_t raw_height)
+{
+  file.close();
+  file.clear();
+  file.open(path, std::ios::binary);
+
+  if (!file)
+  {
+    spdlog::warn("unable to open image file: {}", path);
+    return false;
+  }
+
+  if ((raw_width > 0) && (raw_height > 0))
+  {
+    imageWidth = raw_width;
+    imageHeight = raw_height;
+    channels = 4;
+    dataOffset = 0;
+  }
+  else if (!readheader())
+  {
+    spdlog::warn("unsupported image file: {} (expected a binary 8-bit ppm or pam, or a raw size)", path);
+    return false;
+  }
+
+  // the file has to hold every row, a short file is reported here and not in the middle of the processing
+  const std::uintmax_t expected_size = static_cast<std::uintmax_t>(dataOffset) + (static_cast<std::uintmax_t>(imageWidth) * imageHeight * channels);
+  std::error_code error;
+  if (std::filesystem::file_size(path, error) < expected_size)
+  {
+    spdlog::warn("image file is too short for {}x{} pixels: {}", imageWidth, imageHeight, path);
+    return false;
+  }
+
+  return true;
+}
+
+bool stripreader::readheader()
+{
+  const std::string magic = header_token(file);
+
+  if (magic == "P6")
+  {
+    uint32_t maxval = 0;
+    if (!parse_size(header_token(file), imageWidth) || !parse_size(header_token(file), imageHeight) || !parse_size(header_token(file), maxval) || (maxval != 255))
+    {
+      return false;
+    }
+
+    channels = 3;
+  }
+  else if (magic == "P7")
+  {
+    uint32_t depth = 0;
+    uint32_t maxval = 0;
+    std::string line;
+
+    while (std::getline(file, line) && (line != "ENDHDR"))
+    {
+      std::istringstream fields(line);
+      std::string key;
+      std::string value;
+      fields >> key >> value;
+
+      if (key == "WIDTH")
+      {
+        parse_size(value, imageWidth);
+      }
+      else if (key == "HEIGHT")
+      {
+        parse_size(value, imageHeight);
+      }
+      else if (key == "DEPTH")
+      {
+        parse_size(value, depth);
+      }
+      else if (key == "MAXVAL")
+      {
+        parse_size(value, maxval);
+      }
+    }
+
+    if (!file || (imageWidth == 0) || (imageHeight == 0) || (maxval != 255) || ((depth != 3) && (depth != 4)))
+    {
+      return false;
+    }
+
+    channels = depth;
+  }
+  else
+  {
+    return false;
+  }
+
+  dataOffset = file.tellg();
+  return file.good();
+}
+
+bool stripreader::read(uint32_t first_row, uint32_t row_count, pipeline::frame_rows & rows)
+{
+  if ((first_row + row_count) > imageHeight)
+  {
+    return false;
+  }
+
+  const size_t row_bytes = static_cast<size_t>(imageWidth) * channels;
+  const size_t pixel_count = static_cast<size_t>(imageWidth) * row_count;
+
+  rows.first_row = first_row;
+  rows.row_count = row_count;
+  rows.pixels.resize(pixel_count * 4);
+
+  file.clear();
+  file.seekg(dataOffset + static_cast<std::streamoff>(first_row * row_bytes));
+  file.read(reinterpret_cast<char *>(rows.pixels.data()), static_cast<std::streamsize>(row_bytes * row_count));
+
+  if (!file)
+  {
+    return false;
+  }
+
+  // expand rgb in place from the back so no pixel is overwritten before it is moved
+  if (channels == 3)
+  {
+    for (size_t i=pixel_count; i>0; i--)
+    {
+      const size_t source = (i - 1) * 3;
+      const size_t target = (i - 1) * 4;
+      rows.pixels[target + 3] = 255;
+      rows.pixels[target + 2] = rows.pixels[source + 2];
+      rows.pixels[target + 1] = rows.pixels[source + 1];
+      rows.pixels[target + 0] = rows.pixels[source + 0];
+    }
+  }
+
+  return true;
+}
+
+bool stripwriter::open(const std::string & path, uint32_t image_width, uint32_t image_height)
+{
+  file.close();
+  file.clear();
+  file.open(path, std::ios::binary | std::ios::trunc);
+
+  if (!file)
+  {
+    spdlog::warn("unable to create image file: {}", path);
+    return false;
+  }
+
+  imageWidth = image_width;
+  imageHeight = image_height;
+  rowsWritten = 0;
+
+  const std::string extension = std::filesystem::path(path).extension().string();
+
+  if (extension == ".ppm")
+  {
+    channels = 3;
+    file << "P6\n" << imageWidth << " " << imageHeight << "\n255\n";
+  }
+  else if (extension == ".pam")
+  {
+    channels = 4;
+    file << "P7\nWIDTH " << imageWidth << "\nHEIGHT " << imageHeight << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+  }
+  else
+  {
+    channels = 4;
+  }
+
+  return file.good();
+}
+
+bool stripwriter::write(const uint8_t * rgba_rows, uint32_t row_count)
+{
+  if ((rowsWritten + row_count) > imageHeight)
+  {
+    return false;
+  }
+
+  const size_t pixel_count = static_cast<size_t>(imageWidth) * row_count;
+
+  if (channels == 4)
+  {
+    file.write(reinterpret_cast<const char *>(rgba_rows), static_cast<std::streamsize>(pixel_count * 4));
+  }
+  else
+  {
+    std::vector<uint8_t> rgb_rows (pixel_count * 3);
+    for (size_t i=0; i<pixel_count; i++)
+    {
+      rgb_rows[(i * 3) + 0] = rgba_rows[(i * 4) + 0];
+      rgb_rows[(i * 3) + 1] = rgba_rows[(i * 4) + 1];
+      rgb_rows[(i * 3) + 2] = rgba_rows[(i * 4) + 2];
+    }
+
+    file.write(reinterpret_cast<const char *>(rgb_rows.data()), static_cast<std::streamsize>(rgb_rows.size()));
+  }
+
+  rowsWritten += row_count;
+  return file.good();
+}
+
+bool stripwriter::close()
+{
+  const bool complete = (rowsWritten == imageHeight);
+  file.close();
+
+  return complete && !file.fail();
+}
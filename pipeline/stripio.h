@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+// rows of an image file that does not fit in memory. binary ppm (P6) and pam (P7, RGB or RGB_ALPHA) are read with
+// their header, anything else is raw rgba rows of the given size. all files are 8 bits per channel
+class stripreader
+{
+  public:
+    bool open(const std::string & path, uint32_t raw_width = 0, uint32_t raw_height = 0);
+
+    // rows are returned as rgba, alpha is 255 for files without it
+    bool read(uint32_t first_row, uint32_t row_count, pipeline::frame_rows & rows);
+
+    [[nodiscard]] uint32_t width() const { return imageWidth; }
+    [[nodiscard]] uint32_t height() const { return imageHeight; }
+
+  private:
+    bool readheader();
+
+    std::ifstream file;
+    std::streamoff dataOffset = 0;
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    uint32_t channels = 4;
+};
+
+// rows are appended in order, the format is picked by the extension: .ppm (rgb), .pam (rgba) or raw rgba
+class stripwriter
+{
+  public:
+    bool open(const std::string & path, uint32_t image_width, uint32_t image_height);
+    bool write(const uint8_t * rgba_rows, uint32_t row_count);
+    bool close();
+
+  private:
+    std::ofstream file;
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    uint32_t rowsWritten = 0;
+    uint32_t channels = 4;
+};
@@ -0,0 +1,144 @@
+#include "strips.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+
+  // peak memory per pixel of the area process_strip composes, measured on the full frame with the rgba input and
+  // output included. the peak is in the compose stage so half storage does not lower it
+  constexpr size_t float_bytes_per_pixel = 120;
+  constexpr size_t fixed_point_bytes_per_pixel = 80;
+
+  constexpr uint32_t strip_passes = 3;
+
+  // the three passes share the progress range equally
+  bool report_strip(const pipeline::progress_callback & progress, uint32_t pass, uint32_t rows_done, uint32_t image_height)
+  {
+    const float pass_progress = static_cast<float>(rows_done) / static_cast<float>(image_height);
+    return !progress || progress((static_cast<float>(pass) + pass_progress) / static_cast<float>(strip_passes));
+  }
+
+  bool read_rows(stripreader & reader, const pipeline::region & rows_region, pipeline::frame_rows & rows)
+  {
+    if (!reader.read(rows_region.y, rows_region.height, rows))
+    {
+      spdlog::warn("unable to read rows {} to {}", rows_region.y, rows_region.y + rows_region.height);
+      return false;
+    }
+
+    return true;
+  }
+}
+
+namespace pipeline {
+
+  size_t processing_memory(uint32_t image_width, uint32_t image_height, const parameters & params)
+  {
+    const size_t bytes_per_pixel = (params.arithmetic == arithmetic_mode::fixed_point) ? fixed_point_bytes_per_pixel : float_bytes_per_pixel;
+    return bytes_per_pixel * image_width * image_height;
+  }
+
+  uint32_t strip_height(uint32_t image_width, uint32_t image_height, const parameters & params, size_t memory_budget)
+  {
+    const uint32_t local_block_size = std::max(params.local_block_size, 1u);
+    const size_t budget_rows = std::max<size_t>(memory_budget / processing_memory(std::max(image_width, 1u), 1, params), 1);
+
+    // halo of a strip in the middle of the frame, the strips at the edges have less
+    const uint32_t middle_row = ((image_height / 2) / local_block_size) * local_block_size;
+    const uint32_t middle_height = std::min(local_block_size, image_height - middle_row);
+    const region middle_rows = strip_input_rows({0, middle_row, image_width, middle_height}, image_width, image_height, params);
+    const size_t halo_rows = middle_rows.height - middle_height;
+
+    const size_t blocks = (budget_rows > halo_rows) ? std::max<size_t>((budget_rows - halo_rows) / local_block_size, 1) : 1;
+    return static_cast<uint32_t>(std::min<size_t>(blocks * local_block_size, image_height));
+  }
+
+  bool process_strips(stripreader & reader, stripwriter & writer, const parameters & params, size_t memory_budget, const region & roi, const progress_callback & progress)
+  {
+    const uint32_t image_width = reader.width();
+    const uint32_t image_height = reader.height();
+    const uint32_t rows_per_strip = strip_height(image_width, image_height, params, memory_budget);
+
+    const region output_region = roi.empty() ? region{0, 0, image_width, image_height} : roi;
+    if (((output_region.x + output_region.width) > image_width) || ((output_region.y + output_region.height) > image_height))
+    {
+      spdlog::warn("region {},{} {}x{} is outside of the {}x{} image", output_region.x, output_region.y, output_region.width, output_region.height, image_width, image_height);
+      return false;
+    }
+
+    spdlog::info("processing {}x{} in strips of {} rows", image_width, image_height, rows_per_strip);
+
+    frame_rows rows;
+
+    // pass 1: color histogram for the redefine plan and the attenuation channel
+
+    frame_statistics stats;
+    {
+      color_histogram histogram;
+      for (uint32_t y=0; y<image_height; y+=rows_per_strip)
+      {
+        const region strip = {0, y, image_width, std::min(rows_per_strip, image_height - y)};
+        if (!read_rows(reader, strip, rows))
+        {
+          return false;
+        }
+
+        histogram.add(rows.pixels.data(), static_cast<size_t>(image_width) * strip.height);
+
+        if (!report_strip(progress, 0, y + strip.height, image_height))
+        {
+          return false;
+        }
+      }
+
+      stats = begin_frame_statistics(histogram, image_width, image_height, params);
+    }
+
+    // pass 2: cie-lab statistics of the composed strips
+
+    colormodel::cielab_statistics cielab_stats;
+    for (uint32_t y=0; y<image_height; y+=rows_per_strip)
+    {
+      const region strip = {0, y, image_width, std::min(rows_per_strip, image_height - y)};
+      if (!read_rows(reader, strip_statistics_rows(strip, image_width, image_height), rows) || !add_strip_statistics(rows, strip, stats, params, cielab_stats))
+      {
+        return false;
+      }
+
+      if (!report_strip(progress, 1, y + strip.height, image_height))
+      {
+        return false;
+      }
+    }
+
+    end_frame_statistics(cielab_stats, stats);
+
+    // pass 3: every strip of the output region with its halo, written as soon as it is done
+
+    const uint32_t output_end = output_region.y + output_region.height;
+    for (uint32_t y=output_region.y; y<output_end; y+=rows_per_strip)
+    {
+      const region strip = {output_region.x, y, output_region.width, std::min(rows_per_strip, output_end - y)};
+      result output;
+      if (!read_rows(reader, strip_input_rows(strip, image_width, image_height, params), rows) || !process_strip(rows, stats, params, strip, output))
+      {
+        return false;
+      }
+
+      if (!writer.write(output.color_corrected_image.data(), strip.height))
+      {
+        spdlog::warn("unable to write rows {} to {}", y, y + strip.height);
+        return false;
+      }
+
+      if (!report_strip(progress, 2, y + strip.height - output_region.y, output_region.height))
+      {
+        return false;
+      }
+    }
+
+    return writer.close();
+  }
+}
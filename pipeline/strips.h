@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "pipeline.h"
+#include "stripio.h"
+
+namespace pipeline {
+
+  // peak memory in bytes of processing a frame of this size, used to fit strips and concurrent images in a budget
+  size_t processing_memory(uint32_t image_width, uint32_t image_height, const parameters & params);
+
+  // rows per strip so that processing one strip (with its halo) stays within the memory budget in bytes. the
+  // strips are whole blocks of the local contrast stage
+  uint32_t strip_height(uint32_t image_width, uint32_t image_height, const parameters & params, size_t memory_budget);
+
+  // full frame processing of an image that is read and written in strips: one pass over the strips for the color
+  // histogram, one for the cie-lab statistics and one for the output. the output is the same as process() apart
+  // from the order in which the statistics are summed. with a roi (inside the frame) the statistics still come from
+  // the full frame, the last pass only reads the rows of the roi and the writer gets the roi, as from process_region
+  bool process_strips(stripreader & reader, stripwriter & writer, const parameters & params, size_t memory_budget, const region & roi = {}, const progress_callback & progress = nullptr);
+}
@@ -0,0 +1,96 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common/testcheck.h"
+#include "pipeline/pipeline.h"
+#include "pipeline/stripio.h"
+#include "pipeline/strips.h"
+
+namespace {
+  constexpr uint32_t image_width = 317;
+  constexpr uint32_t image_height = 211;
+  constexpr size_t memory_budget = 200000; // a few blocks of rows per strip
+}
+
+int main()
+{
+  const auto directory = std::filesystem::temp_directory_path() / "uwie_strips_test";
+  std::filesystem::create_directories(directory);
+  const std::string input_path = (directory / "input.pam").string();
+  const std::string output_path = (directory / "output.pam").string();
+
+  const auto input = testcheck::synthetic_frame(image_width, image_height);
+  {
+    stripwriter writer;
+    testcheck::check(writer.open(input_path, image_width, image_height) && writer.write(input.data(), image_height) && writer.close(), "input image is written");
+  }
+
+  for (const auto arithmetic : {pipeline::arithmetic_mode::floating_point, pipeline::arithmetic_mode::fixed_point})
+  {
+    for (const auto mode : {pipeline::contrast_mode::block, pipeline::contrast_mode::interpolated, pipeline::contrast_mode::sliding_window})
+    {
+      pipeline::parameters params;
+      params.arithmetic = arithmetic;
+      params.local_contrast_mode = mode;
+      const std::string name = std::string((arithmetic == pipeline::arithmetic_mode::fixed_point) ? "fixed point" : "floating point") + ", contrast mode " + std::to_string(static_cast<int>(mode));
+
+      testcheck::check(pipeline::strip_height(image_width, image_height, params, memory_budget) < image_height, name + ": the budget splits the frame into strips");
+
+      stripreader reader;
+      stripwriter writer;
+      const bool processed = reader.open(input_path) && writer.open(output_path, image_width, image_height) && pipeline::process_strips(reader, writer, params, memory_budget);
+      if (!testcheck::check(processed, name + ": strips are processed"))
+      {
+        continue;
+      }
+
+      stripreader output_reader;
+      pipeline::frame_rows rows;
+      testcheck::check(output_reader.open(output_path) && output_reader.read(0, image_height, rows), name + ": output image is read");
+
+      pipeline::result expected;
+      pipeline::process(input, image_width, image_height, params, expected, false);
+      testcheck::check(testcheck::max_difference(rows.pixels, expected.color_corrected_image) == 0, name + ": strip output matches process()");
+    }
+  }
+
+  // a roi only writes its own rows and columns, with the statistics of the full frame
+  for (const auto arithmetic : {pipeline::arithmetic_mode::floating_point, pipeline::arithmetic_mode::fixed_point})
+  {
+    pipeline::parameters params;
+    params.arithmetic = arithmetic;
+    params.local_contrast_mode = pipeline::contrast_mode::sliding_window;
+    const std::string name = (arithmetic == pipeline::arithmetic_mode::fixed_point) ? "fixed point roi" : "floating point roi";
+    const pipeline::region roi = {37, 61, 150, 123};
+
+    stripreader reader;
+    stripwriter writer;
+    const bool processed = reader.open(input_path) && writer.open(output_path, roi.width, roi.height) && pipeline::process_strips(reader, writer, params, memory_budget, roi);
+    if (!testcheck::check(processed, name + ": strips are processed"))
+    {
+      continue;
+    }
+
+    stripreader output_reader;
+    pipeline::frame_rows rows;
+    testcheck::check(output_reader.open(output_path) && (output_reader.width() == roi.width) && output_reader.read(0, roi.height, rows), name + ": output image has the size of the roi");
+
+    pipeline::frame_statistics stats;
+    pipeline::result expected;
+    pipeline::compute_frame_statistics(input, image_width, image_height, params, stats);
+    pipeline::process_region(input, image_width, image_height, stats, params, roi, expected, false);
+    testcheck::check(testcheck::max_difference(rows.pixels, expected.color_corrected_image) == 0, name + ": strip output matches process_region()");
+  }
+
+  {
+    stripreader reader;
+    stripwriter writer;
+    const bool processed = reader.open(input_path) && writer.open(output_path, 10, 10) && pipeline::process_strips(reader, writer, {}, memory_budget, {image_width - 5, 0, 10, 10});
+    testcheck::check(!processed, "a roi outside of the frame is rejected");
+  }
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+  return testcheck::result();
+}